@@ -0,0 +1,110 @@
+//
+// Created by AICDG on 2017/10/29.
+//
+
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+
+#include <Bullet/BulletCollision/CollisionShapes/btBoxShape.h>
+#include <Bullet/BulletCollision/CollisionShapes/btCapsuleShape.h>
+#include <Bullet/BulletCollision/CollisionShapes/btConeShape.h>
+#include <Bullet/BulletCollision/CollisionShapes/btCylinderShape.h>
+#include <Bullet/BulletCollision/CollisionShapes/btSphereShape.h>
+
+#include "CollisionShapeCache.h"
+
+unsigned CollisionShapeCache::ShapeKey::ToHash() const
+{
+    // Hash the bit patterns, equal sizes are bitwise equal
+    const unsigned* sizeBits = reinterpret_cast<const unsigned*>(size_.Data());
+    unsigned hash = (unsigned)type_;
+    for (unsigned i = 0; i < 3; ++i)
+        hash = hash * 31 + sizeBits[i];
+    return hash;
+}
+
+CollisionShapeCache::CollisionShapeCache(Context* context) :
+    Object(context),
+    numReferences_(0),
+    numCreated_(0)
+{
+}
+
+CollisionShapeCache::~CollisionShapeCache()
+{
+    for (HashMap<ShapeKey, CachedShape>::Iterator i = shapes_.Begin(); i != shapes_.End(); ++i)
+        delete i->second_.shape_;
+}
+
+btCollisionShape* CollisionShapeCache::AcquireShape(ShapeType type, const Vector3& size)
+{
+    const ShapeKey key(type, size);
+    HashMap<ShapeKey, CachedShape>::Iterator i = shapes_.Find(key);
+    if (i == shapes_.End())
+    {
+        CachedShape cached;
+        cached.shape_ = CreateShape(type, size);
+        cached.refCount_ = 0;
+        if (!cached.shape_)
+            return 0;
+        i = shapes_.Insert(MakePair(key, cached));
+        ++numCreated_;
+    }
+
+    ++i->second_.refCount_;
+    ++numReferences_;
+    return i->second_.shape_;
+}
+
+void CollisionShapeCache::ReleaseShape(ShapeType type, const Vector3& size)
+{
+    HashMap<ShapeKey, CachedShape>::Iterator i = shapes_.Find(ShapeKey(type, size));
+    if (i == shapes_.End())
+        return;
+
+    --numReferences_;
+    if (--i->second_.refCount_ == 0)
+    {
+        delete i->second_.shape_;
+        shapes_.Erase(i);
+    }
+}
+
+void CollisionShapeCache::GetStatistics(PODVector<CollisionShapeStats>& dest) const
+{
+    dest.Clear();
+    for (HashMap<ShapeKey, CachedShape>::ConstIterator i = shapes_.Begin(); i != shapes_.End(); ++i)
+    {
+        CollisionShapeStats stats;
+        stats.type_ = i->first_.type_;
+        stats.size_ = i->first_.size_;
+        stats.refCount_ = i->second_.refCount_;
+        dest.Push(stats);
+    }
+}
+
+btCollisionShape* CollisionShapeCache::CreateShape(ShapeType type, const Vector3& size) const
+{
+    // Same dimensions as CollisionShape uses, with the node scale already in the size
+    switch (type)
+    {
+    case SHAPE_BOX:
+        return new btBoxShape(ToBtVector3(size * 0.5f));
+
+    case SHAPE_SPHERE:
+        return new btSphereShape(size.x_ * 0.5f);
+
+    case SHAPE_CYLINDER:
+        return new btCylinderShape(btVector3(size.x_ * 0.5f, size.y_ * 0.5f, size.x_ * 0.5f));
+
+    case SHAPE_CAPSULE:
+        return new btCapsuleShape(size.x_ * 0.5f, Max(size.y_ - size.x_, 0.0f));
+
+    case SHAPE_CONE:
+        return new btConeShape(size.x_ * 0.5f, size.y_);
+
+    default:
+        URHO3D_LOGERROR("Only primitive collision shapes can be shared");
+        return 0;
+    }
+}
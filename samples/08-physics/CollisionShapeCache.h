@@ -0,0 +1,96 @@
+//
+// Created by AICDG on 2017/10/29.
+//
+
+#ifndef URHO3DSAMPLES_COLLISIONSHAPECACHE_H
+#define URHO3DSAMPLES_COLLISIONSHAPECACHE_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Physics/CollisionShape.h>
+
+class btCollisionShape;
+
+using namespace Urho3D;
+
+/// Primitive shape usage statistics.
+struct CollisionShapeStats
+{
+    /// Shape type.
+    ShapeType type_;
+    /// Size with the node scale applied.
+    Vector3 size_;
+    /// Number of users.
+    unsigned refCount_;
+};
+
+/// Cache of primitive Bullet collision shapes, shared by all bodies with the same shape type and scaled size. Shapes are
+/// reference counted and destroyed when their last user releases them. The offset of a shape is not part of the key, it is
+/// applied by each body when adding the shared shape. Register as a subsystem, so that the shapes outlive the scenes.
+class CollisionShapeCache : public Object
+{
+    URHO3D_OBJECT(CollisionShapeCache, Object);
+
+public:
+    /// Construct.
+    CollisionShapeCache(Context* context);
+    /// Destruct. Destroy the remaining shapes.
+    virtual ~CollisionShapeCache();
+
+    /// Return a shared shape and add a reference to it, create it if not cached. Return null for non-primitive shape types.
+    btCollisionShape* AcquireShape(ShapeType type, const Vector3& size);
+    /// Remove a reference to a shared shape, destroy it when it has no users left.
+    void ReleaseShape(ShapeType type, const Vector3& size);
+
+    /// Return number of distinct shapes.
+    unsigned GetNumShapes() const { return shapes_.Size(); }
+    /// Return number of shape users.
+    unsigned GetNumReferences() const { return numReferences_; }
+    /// Return number of shapes created since construction.
+    unsigned GetNumCreated() const { return numCreated_; }
+    /// Return usage statistics of all shapes.
+    void GetStatistics(PODVector<CollisionShapeStats>& dest) const;
+
+private:
+    /// Shape cache key.
+    struct ShapeKey
+    {
+        /// Construct.
+        ShapeKey(ShapeType type, const Vector3& size) :
+            type_(type),
+            size_(size)
+        {
+        }
+
+        /// Test for equality.
+        bool operator ==(const ShapeKey& rhs) const { return type_ == rhs.type_ && size_ == rhs.size_; }
+        /// Return hash value for HashMap.
+        unsigned ToHash() const;
+
+        /// Shape type.
+        ShapeType type_;
+        /// Size with the node scale applied.
+        Vector3 size_;
+    };
+
+    /// Cached shape.
+    struct CachedShape
+    {
+        /// Bullet shape.
+        btCollisionShape* shape_;
+        /// Number of users.
+        unsigned refCount_;
+    };
+
+    /// Create a Bullet shape.
+    btCollisionShape* CreateShape(ShapeType type, const Vector3& size) const;
+
+    /// Shapes by key.
+    HashMap<ShapeKey, CachedShape> shapes_;
+    /// Number of shape users.
+    unsigned numReferences_;
+    /// Number of shapes created.
+    unsigned numCreated_;
+};
+
+#endif //URHO3DSAMPLES_COLLISIONSHAPECACHE_H
@@ -0,0 +1,183 @@
+//
+// Created by AICDG on 2017/10/29.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+
+#include <Bullet/BulletCollision/CollisionShapes/btCompoundShape.h>
+
+#include "CollisionShapeCache.h"
+#include "SharedCollisionShape.h"
+
+/// Shape type names, in ShapeType order. Only the primitive types can be shared.
+static const char* sharedShapeTypeNames[] =
+{
+    "Box",
+    "Sphere",
+    "StaticPlane",
+    "Cylinder",
+    "Capsule",
+    "Cone",
+    0
+};
+
+SharedCollisionShape::SharedCollisionShape(Context* context) :
+    Component(context),
+    shape_(0),
+    shapeType_(SHAPE_BOX),
+    size_(Vector3::ONE),
+    position_(Vector3::ZERO),
+    rotation_(Quaternion::IDENTITY),
+    cachedType_(SHAPE_BOX),
+    cachedSize_(Vector3::ZERO),
+    cachedWorldScale_(Vector3::ONE)
+{
+}
+
+SharedCollisionShape::~SharedCollisionShape()
+{
+    ReleaseShape();
+}
+
+void SharedCollisionShape::RegisterObject(Context* context)
+{
+    context->RegisterFactory<SharedCollisionShape>();
+
+    URHO3D_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+    URHO3D_ENUM_ATTRIBUTE("Shape Type", shapeType_, sharedShapeTypeNames, SHAPE_BOX, AM_DEFAULT);
+    URHO3D_ATTRIBUTE("Size", Vector3, size_, Vector3::ONE, AM_DEFAULT);
+    URHO3D_ATTRIBUTE("Offset Position", Vector3, position_, Vector3::ZERO, AM_DEFAULT);
+    URHO3D_ATTRIBUTE("Offset Rotation", Quaternion, rotation_, Quaternion::IDENTITY, AM_DEFAULT);
+}
+
+void SharedCollisionShape::ApplyAttributes()
+{
+    UpdateShape();
+}
+
+void SharedCollisionShape::OnSetEnabled()
+{
+    // Also called when the node is enabled or disabled, eg. by the projectile pool. The rigid body leaves the world with the
+    // node, so the shape is kept until this component itself is disabled
+    if (IsEnabled() == (shape_ != 0))
+        return;
+
+    UpdateShape();
+}
+
+void SharedCollisionShape::SetBox(const Vector3& size, const Vector3& position, const Quaternion& rotation)
+{
+    SetShape(SHAPE_BOX, size, position, rotation);
+}
+
+void SharedCollisionShape::SetSphere(float diameter, const Vector3& position, const Quaternion& rotation)
+{
+    SetShape(SHAPE_SPHERE, Vector3(diameter, diameter, diameter), position, rotation);
+}
+
+void SharedCollisionShape::SetCylinder(float diameter, float height, const Vector3& position, const Quaternion& rotation)
+{
+    SetShape(SHAPE_CYLINDER, Vector3(diameter, height, diameter), position, rotation);
+}
+
+void SharedCollisionShape::SetCapsule(float diameter, float height, const Vector3& position, const Quaternion& rotation)
+{
+    SetShape(SHAPE_CAPSULE, Vector3(diameter, height, diameter), position, rotation);
+}
+
+void SharedCollisionShape::SetCone(float diameter, float height, const Vector3& position, const Quaternion& rotation)
+{
+    SetShape(SHAPE_CONE, Vector3(diameter, height, diameter), position, rotation);
+}
+
+void SharedCollisionShape::OnNodeSet(Node* node)
+{
+    if (node)
+    {
+        rigidBody_ = node->GetComponent<RigidBody>();
+        if (!rigidBody_)
+            URHO3D_LOGWARNING("SharedCollisionShape needs a RigidBody created before it in the node");
+        node->AddListener(this);
+        UpdateShape();
+    }
+    else
+    {
+        ReleaseShape();
+        rigidBody_.Reset();
+    }
+}
+
+void SharedCollisionShape::OnMarkedDirty(Node* node)
+{
+    // The node moves every physics step, only a scale change needs another shape
+    if (shape_ && node->GetWorldScale() != cachedWorldScale_)
+        UpdateShape();
+}
+
+void SharedCollisionShape::SetShape(ShapeType type, const Vector3& size, const Vector3& position, const Quaternion& rotation)
+{
+    shapeType_ = type;
+    size_ = size;
+    position_ = position;
+    rotation_ = rotation;
+    UpdateShape();
+    MarkNetworkUpdate();
+}
+
+void SharedCollisionShape::UpdateShape()
+{
+    ReleaseShape();
+    if (!rigidBody_ || !node_ || !IsEnabled())
+        return;
+
+    CollisionShapeCache* cache = GetSubsystem<CollisionShapeCache>();
+    if (!cache)
+    {
+        URHO3D_LOGERROR("SharedCollisionShape needs the CollisionShapeCache subsystem");
+        return;
+    }
+
+    // The node scale is baked into the shared shape, as a shared shape can not be scaled per body
+    cachedType_ = shapeType_;
+    cachedWorldScale_ = node_->GetWorldScale();
+    cachedSize_ = size_ * cachedWorldScale_;
+    shape_ = cache->AcquireShape(cachedType_, cachedSize_);
+    if (!shape_)
+        return;
+
+    btTransform offset;
+    offset.setOrigin(ToBtVector3(cachedWorldScale_ * position_));
+    offset.setRotation(ToBtQuaternion(rotation_));
+    rigidBody_->GetCompoundShape()->addChildShape(offset, shape_);
+    rigidBody_->UpdateMass();
+}
+
+void SharedCollisionShape::ReleaseShape()
+{
+    if (!shape_)
+        return;
+
+    // Other shapes of the body may use the same shared shape, so remove only one child
+    if (rigidBody_)
+    {
+        btCompoundShape* compound = rigidBody_->GetCompoundShape();
+        for (int i = compound->getNumChildShapes() - 1; i >= 0; --i)
+        {
+            if (compound->getChildShape(i) == shape_)
+            {
+                compound->removeChildShapeByIndex(i);
+                break;
+            }
+        }
+        rigidBody_->UpdateMass();
+    }
+
+    CollisionShapeCache* cache = GetSubsystem<CollisionShapeCache>();
+    if (cache)
+        cache->ReleaseShape(cachedType_, cachedSize_);
+    shape_ = 0;
+}
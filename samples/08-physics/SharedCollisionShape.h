@@ -0,0 +1,101 @@
+//
+// Created by AICDG on 2017/10/29.
+//
+
+#ifndef URHO3DSAMPLES_SHAREDCOLLISIONSHAPE_H
+#define URHO3DSAMPLES_SHAREDCOLLISIONSHAPE_H
+
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Scene/Component.h>
+
+class btCollisionShape;
+
+namespace Urho3D
+{
+
+class RigidBody;
+
+}
+
+using namespace Urho3D;
+
+/// Primitive collision shape whose Bullet shape is shared through the CollisionShapeCache subsystem with all other shapes of
+/// the same type and scaled size, instead of each component owning its own like CollisionShape. The shared shape is added to
+/// the compound shape of the node's RigidBody, which must be created before this component.
+class SharedCollisionShape : public Component
+{
+    URHO3D_OBJECT(SharedCollisionShape, Component);
+
+public:
+    /// Construct.
+    SharedCollisionShape(Context* context);
+    /// Destruct. Release the shared shape.
+    virtual ~SharedCollisionShape();
+    /// Register object factory and attributes.
+    static void RegisterObject(Context* context);
+
+    /// Apply attribute changes that can not be applied immediately.
+    virtual void ApplyAttributes();
+    /// Handle enabled/disabled state change. Only the component's own state counts, so that disabling the node keeps the shape.
+    virtual void OnSetEnabled();
+
+    /// Set as a box.
+    void SetBox(const Vector3& size, const Vector3& position = Vector3::ZERO, const Quaternion& rotation = Quaternion::IDENTITY);
+    /// Set as a sphere.
+    void SetSphere(float diameter, const Vector3& position = Vector3::ZERO, const Quaternion& rotation = Quaternion::IDENTITY);
+    /// Set as a cylinder.
+    void SetCylinder(float diameter, float height, const Vector3& position = Vector3::ZERO,
+        const Quaternion& rotation = Quaternion::IDENTITY);
+    /// Set as a capsule.
+    void SetCapsule(float diameter, float height, const Vector3& position = Vector3::ZERO,
+        const Quaternion& rotation = Quaternion::IDENTITY);
+    /// Set as a cone.
+    void SetCone(float diameter, float height, const Vector3& position = Vector3::ZERO,
+        const Quaternion& rotation = Quaternion::IDENTITY);
+
+    /// Return shape type.
+    ShapeType GetShapeType() const { return shapeType_; }
+    /// Return shape size.
+    const Vector3& GetSize() const { return size_; }
+    /// Return offset position.
+    const Vector3& GetPosition() const { return position_; }
+    /// Return offset rotation.
+    const Quaternion& GetRotation() const { return rotation_; }
+    /// Return shared Bullet shape.
+    btCollisionShape* GetCollisionShape() const { return shape_; }
+
+protected:
+    /// Handle node being assigned.
+    virtual void OnNodeSet(Node* node);
+    /// Handle node transform being dirtied.
+    virtual void OnMarkedDirty(Node* node);
+
+private:
+    /// Set the shape and acquire the shared Bullet shape.
+    void SetShape(ShapeType type, const Vector3& size, const Vector3& position, const Quaternion& rotation);
+    /// Acquire the shared Bullet shape for the current settings and node scale, and add it to the rigid body.
+    void UpdateShape();
+    /// Remove the shared Bullet shape from the rigid body and release it.
+    void ReleaseShape();
+
+    /// Rigid body of the node.
+    WeakPtr<RigidBody> rigidBody_;
+    /// Shared Bullet shape, owned by the cache.
+    btCollisionShape* shape_;
+    /// Shape type.
+    ShapeType shapeType_;
+    /// Shape size.
+    Vector3 size_;
+    /// Offset position.
+    Vector3 position_;
+    /// Offset rotation.
+    Quaternion rotation_;
+    /// Type the shared shape was acquired with.
+    ShapeType cachedType_;
+    /// Scaled size the shared shape was acquired with.
+    Vector3 cachedSize_;
+    /// Node world scale the shared shape was acquired with.
+    Vector3 cachedWorldScale_;
+};
+
+#endif //URHO3DSAMPLES_SHAREDCOLLISIONSHAPE_H
@@ -28,9 +28,15 @@
 #include <Urho3D/UI/Text.h>
 #include <Urho3D/UI/UI.h>
 
-
+#include "CollisionShapeCache.h"
+#include "ProjectilePool.h"
+#include "SharedCollisionShape.h"
 
 using namespace Urho3D;
+
+/// Number of projectiles in flight before the oldest ones are recycled.
+static const unsigned MAX_PROJECTILES = 256;
+
 class MyApp : public Application
 {
 public:
@@ -38,6 +44,11 @@ public:
             : Application(context)
             , drawDebug_(false)
     {
+        // Register an object factory for the projectile pool component
+        ProjectilePool::RegisterObject(context);
+        // Register the shared collision shape component and the cache subsystem that owns the shapes it shares
+        context->RegisterSubsystem(new CollisionShapeCache(context));
+        SharedCollisionShape::RegisterObject(context);
     }
     virtual void Setup()
     {
@@ -147,18 +158,21 @@ public:
                     boxObject->SetMaterial(cache->GetResource<Material>("Materials/StoneEnvMapSmall.xml"));
                     boxObject->SetCastShadows(true);
 
-                    // Create RigidBody and CollisionShape components like above. Give the RigidBody mass to make it movable
+                    // Create RigidBody and collision shape components like above. Give the RigidBody mass to make it movable
                     // and also adjust friction. The actual mass is not important; only the mass ratios between colliding
-                    // objects are significant
+                    // objects are significant. All boxes are the same, so they share one Bullet box shape
                     RigidBody* body = boxNode->CreateComponent<RigidBody>();
                     body->SetMass(1.0f);
                     body->SetFriction(0.75f);
-                    CollisionShape* shape = boxNode->CreateComponent<CollisionShape>();
+                    SharedCollisionShape* shape = boxNode->CreateComponent<SharedCollisionShape>();
                     shape->SetBox(Vector3::ONE);
                 }
             }
         }
 
+        // Create the pool of the projectiles shot with the mouse
+        CreateProjectilePool();
+
         // Create the camera. Set far clip to match the fog. Note: now we actually create the camera node outside the scene, because
         // we want it to be unaffected by scene load / save
         cameraNode_ = new Node(context_);
@@ -252,6 +266,8 @@ public:
         {
             File loadFile(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/Physics.xml", FILE_READ);
             scene_->LoadXML(loadFile);
+            // The projectiles are not saved with the scene, create the pool again
+            CreateProjectilePool();
         }
 
         // Toggle debug geometry with space
@@ -291,32 +307,46 @@ public:
             GetSubsystem<Renderer>()->DrawDebugGeometry(false);
     }
 
-    void SpawnObject()
+    void CreateProjectilePool()
     {
         ResourceCache* cache = GetSubsystem<ResourceCache>();
 
-        // Create a smaller box at camera position
-        Node* boxNode = scene_->CreateChild("SmallBox");
-        boxNode->SetPosition(cameraNode_->GetPosition());
-        boxNode->SetRotation(cameraNode_->GetRotation());
+        // Create the projectile pool to its own node, which is not saved with the scene. Projectiles leaving the floor area are
+        // returned to the pool
+        Node* poolNode = scene_->CreateChild("Projectiles");
+        poolNode->SetTemporary(true);
+        projectilePool_ = poolNode->CreateComponent<ProjectilePool>();
+        projectilePool_->SetBounds(BoundingBox(Vector3(-500.0f, -50.0f, -500.0f), Vector3(500.0f, 500.0f, 500.0f)));
+
+        // Create a smaller box as the prototype of the projectiles, use a smaller mass also. The pool clones it once for all
+        // projectiles, so shooting reuses the nodes and physics bodies instead of creating new ones
+        Node* boxNode = poolNode->CreateChild("SmallBox");
         boxNode->SetScale(0.25f);
         StaticModel* boxObject = boxNode->CreateComponent<StaticModel>();
         boxObject->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
         boxObject->SetMaterial(cache->GetResource<Material>("Materials/StoneEnvMapSmall.xml"));
         boxObject->SetCastShadows(true);
 
-        // Create physics components, use a smaller mass also
         RigidBody* body = boxNode->CreateComponent<RigidBody>();
         body->SetMass(0.25f);
         body->SetFriction(0.75f);
-        CollisionShape* shape = boxNode->CreateComponent<CollisionShape>();
+        SharedCollisionShape* shape = boxNode->CreateComponent<SharedCollisionShape>();
         shape->SetBox(Vector3::ONE);
 
+        projectilePool_->Allocate(boxNode, MAX_PROJECTILES);
+    }
+
+    void SpawnObject()
+    {
+        if (!projectilePool_)
+            return;
+
         const float OBJECT_VELOCITY = 30.0f;
 
-        // Set initial velocity for the RigidBody based on camera forward vector. Add also a slight up component
-        // to overcome gravity better
-        body->SetLinearVelocity(cameraNode_->GetRotation() * Vector3(0.0f, 0.25f, 1.0f) * OBJECT_VELOCITY);
+        // Take a box from the pool at camera position. Set initial velocity for the RigidBody based on camera forward vector.
+        // Add also a slight up component to overcome gravity better
+        projectilePool_->Spawn(cameraNode_->GetPosition(), cameraNode_->GetRotation(),
+            cameraNode_->GetRotation() * Vector3(0.0f, 0.25f, 1.0f) * OBJECT_VELOCITY);
     }
 
 
@@ -332,5 +362,7 @@ private:
 
     /// Flag for drawing debug geometry.
     bool drawDebug_;
+    /// Pool of the projectiles shot with the mouse.
+    WeakPtr<ProjectilePool> projectilePool_;
 };
 URHO3D_DEFINE_APPLICATION_MAIN(MyApp)
\ No newline at end of file
@@ -28,8 +28,13 @@
 #include <Urho3D/UI/UI.h>
 
 #include "CreateRagdoll.h"
+#include "ProjectilePool.h"
 
 using namespace Urho3D;
+
+/// Number of projectiles in flight before the oldest ones are recycled.
+static const unsigned MAX_PROJECTILES = 256;
+
 class MyApp : public Application
 {
 public:
@@ -39,6 +44,8 @@ public:
     {
         // Register an object factory for our custom CreateRagdoll component so that we can create them to scene nodes
         context->RegisterFactory<CreateRagdoll>();
+        // Register an object factory for the projectile pool component
+        ProjectilePool::RegisterObject(context);
     }
     virtual void Setup()
     {
@@ -159,6 +166,9 @@ public:
             }
         }
 
+        // Create the pool of the projectiles shot with the mouse
+        CreateProjectilePool();
+
         // Create the camera. Limit far clip distance to match the fog. Note: now we actually create the camera node outside
         // the scene, because we want it to be unaffected by scene load / save
         cameraNode_ = new Node(context_);
@@ -252,6 +262,8 @@ public:
         {
             File loadFile(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/Physics.xml", FILE_READ);
             scene_->LoadXML(loadFile);
+            // The projectiles are not saved with the scene, create the pool again
+            CreateProjectilePool();
         }
 
         // Toggle debug geometry with space
@@ -291,30 +303,46 @@ public:
             GetSubsystem<Renderer>()->DrawDebugGeometry(false);
     }
 
-    void SpawnObject()
+    void CreateProjectilePool()
     {
         ResourceCache* cache = GetSubsystem<ResourceCache>();
 
-        Node* boxNode = scene_->CreateChild("Sphere");
-        boxNode->SetPosition(cameraNode_->GetPosition());
-        boxNode->SetRotation(cameraNode_->GetRotation());
-        boxNode->SetScale(0.25f);
-        StaticModel* boxObject = boxNode->CreateComponent<StaticModel>();
-        boxObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-        boxObject->SetMaterial(cache->GetResource<Material>("Materials/StoneSmall.xml"));
-        boxObject->SetCastShadows(true);
-
-        RigidBody* body = boxNode->CreateComponent<RigidBody>();
+        // Create the projectile pool to its own node, which is not saved with the scene. Projectiles leaving the floor area are
+        // returned to the pool
+        Node* poolNode = scene_->CreateChild("Projectiles");
+        poolNode->SetTemporary(true);
+        projectilePool_ = poolNode->CreateComponent<ProjectilePool>();
+        projectilePool_->SetBounds(BoundingBox(Vector3(-250.0f, -50.0f, -250.0f), Vector3(250.0f, 250.0f, 250.0f)));
+
+        // Create a sphere as the prototype of the projectiles. The pool clones it once for all projectiles, so shooting reuses
+        // the nodes and physics bodies instead of creating new ones
+        Node* sphereNode = poolNode->CreateChild("Sphere");
+        sphereNode->SetScale(0.25f);
+        StaticModel* sphereObject = sphereNode->CreateComponent<StaticModel>();
+        sphereObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
+        sphereObject->SetMaterial(cache->GetResource<Material>("Materials/StoneSmall.xml"));
+        sphereObject->SetCastShadows(true);
+
+        RigidBody* body = sphereNode->CreateComponent<RigidBody>();
         body->SetMass(1.0f);
         body->SetRollingFriction(0.15f);
-        CollisionShape* shape = boxNode->CreateComponent<CollisionShape>();
+        CollisionShape* shape = sphereNode->CreateComponent<CollisionShape>();
         shape->SetSphere(1.0f);
 
+        projectilePool_->Allocate(sphereNode, MAX_PROJECTILES);
+    }
+
+    void SpawnObject()
+    {
+        if (!projectilePool_)
+            return;
+
         const float OBJECT_VELOCITY = 10.0f;
 
-        // Set initial velocity for the RigidBody based on camera forward vector. Add also a slight up component
-        // to overcome gravity better
-        body->SetLinearVelocity(cameraNode_->GetRotation() * Vector3(0.0f, 0.25f, 1.0f) * OBJECT_VELOCITY);
+        // Take a sphere from the pool at camera position. Set initial velocity for the RigidBody based on camera forward vector.
+        // Add also a slight up component to overcome gravity better
+        projectilePool_->Spawn(cameraNode_->GetPosition(), cameraNode_->GetRotation(),
+            cameraNode_->GetRotation() * Vector3(0.0f, 0.25f, 1.0f) * OBJECT_VELOCITY);
     }
 
 
@@ -330,5 +358,7 @@ private:
 
     /// Flag for drawing debug geometry.
     bool drawDebug_;
+    /// Pool of the projectiles shot with the mouse.
+    WeakPtr<ProjectilePool> projectilePool_;
 };
 URHO3D_DEFINE_APPLICATION_MAIN(MyApp)
\ No newline at end of file
@@ -0,0 +1,180 @@
+//
+// Created by AICDG on 2017/10/11.
+//
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "NavigationRebuildQueue.h"
+#include "PathCache.h"
+#include "PathQueryService.h"
+
+/// Tile ordering for deterministic rebuilds: by row, then by column.
+static bool CompareTiles(const IntVector2& lhs, const IntVector2& rhs)
+{
+    return lhs.y_ != rhs.y_ ? lhs.y_ < rhs.y_ : lhs.x_ < rhs.x_;
+}
+
+NavigationRebuildQueue::NavigationRebuildQueue(Context* context) :
+    Component(context),
+    timeBudget_(0.0f)
+{
+}
+
+void NavigationRebuildQueue::RegisterObject(Context* context)
+{
+    context->RegisterFactory<NavigationRebuildQueue>();
+
+    URHO3D_ACCESSOR_ATTRIBUTE("Time Budget", GetTimeBudget, SetTimeBudget, float, 0.0f, AM_DEFAULT);
+}
+
+void NavigationRebuildQueue::QueueRebuild(const BoundingBox& worldBox)
+{
+    NavigationMesh* navMesh = GetNavigationMesh();
+    if (!navMesh)
+        return;
+
+    const IntVector2 numTiles = navMesh->GetNumTiles();
+    const IntVector2 beginTile = VectorMax(IntVector2::ZERO, navMesh->GetTileIndex(worldBox.min_));
+    const IntVector2 endTile = VectorMin(navMesh->GetTileIndex(worldBox.max_), numTiles - IntVector2::ONE);
+
+    for (int z = beginTile.y_; z <= endTile.y_; ++z)
+        for (int x = beginTile.x_; x <= endTile.x_; ++x)
+            dirtyTiles_.Insert(IntVector2(x, z));
+}
+
+bool NavigationRebuildQueue::Flush(float budgetMs)
+{
+    NavigationMesh* navMesh = GetNavigationMesh();
+    if (!navMesh || dirtyTiles_.Empty())
+        return dirtyTiles_.Empty();
+
+    // Path queries use the navigation mesh on a worker thread, let them finish first
+    if (PathQueryService* pathQueries = GetScene()->GetComponent<PathQueryService>())
+        pathQueries->WaitForCompletion();
+
+    PODVector<IntVector2> tiles;
+    for (HashSet<IntVector2>::ConstIterator i = dirtyTiles_.Begin(); i != dirtyTiles_.End(); ++i)
+        tiles.Push(*i);
+    Sort(tiles.Begin(), tiles.End(), CompareTiles);
+
+    // Rebuild horizontal runs of dirty tiles with one Build() call each, as every call collects the scene geometry anew.
+    // Build through a bounding box, so that the area rebuilt event reaches path caches and other listeners. Shrink the box a
+    // little so that it does not touch the neighbouring tiles
+    const Matrix3x4& worldTransform = navMesh->GetNode()->GetWorldTransform();
+    const Vector3 shrink(0.01f, 0.0f, 0.01f);
+    const long long budgetUSec = (long long)(budgetMs * 1000.0f);
+    HiresTimer timer;
+
+    unsigned i = 0;
+    while (i < tiles.Size())
+    {
+        unsigned runEnd = i + 1;
+        while (runEnd < tiles.Size() && tiles[runEnd].y_ == tiles[i].y_ && tiles[runEnd].x_ == tiles[runEnd - 1].x_ + 1)
+            ++runEnd;
+
+        BoundingBox runBox = navMesh->GetTileBoundingBox(tiles[i]);
+        runBox.Merge(navMesh->GetTileBoundingBox(tiles[runEnd - 1]));
+        runBox.min_ += shrink;
+        runBox.max_ -= shrink;
+        navMesh->Build(runBox.Transformed(worldTransform));
+
+        for (unsigned j = i; j < runEnd; ++j)
+        {
+            dirtyTiles_.Erase(tiles[j]);
+            rebuiltTiles_.Insert(tiles[j]);
+        }
+        i = runEnd;
+
+        if (budgetUSec > 0 && timer.GetUSec(false) >= budgetUSec)
+            break;
+    }
+
+    if (!dirtyTiles_.Empty())
+        return false;
+
+    SendFlushedEvent();
+    return true;
+}
+
+void NavigationRebuildQueue::Clear()
+{
+    dirtyTiles_.Clear();
+    rebuiltTiles_.Clear();
+}
+
+void NavigationRebuildQueue::WatchPath(unsigned requester, const PODVector<Vector3>& path)
+{
+    NavigationMesh* navMesh = GetNavigationMesh();
+    if (!navMesh || path.Empty())
+    {
+        UnwatchPath(requester);
+        return;
+    }
+
+    PathCache::GetPathTiles(path, navMesh, watchedPaths_[requester]);
+}
+
+void NavigationRebuildQueue::UnwatchPath(unsigned requester)
+{
+    watchedPaths_.Erase(requester);
+}
+
+void NavigationRebuildQueue::SetTimeBudget(float budgetMs)
+{
+    timeBudget_ = Max(budgetMs, 0.0f);
+}
+
+void NavigationRebuildQueue::OnSceneSet(Scene* scene)
+{
+    if (scene)
+        SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(NavigationRebuildQueue, HandleUpdate));
+    else
+        UnsubscribeFromEvent(E_UPDATE);
+}
+
+void NavigationRebuildQueue::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    Flush(timeBudget_);
+}
+
+void NavigationRebuildQueue::SendFlushedEvent()
+{
+    VariantVector tiles;
+    VariantVector requesters;
+
+    for (HashSet<IntVector2>::ConstIterator i = rebuiltTiles_.Begin(); i != rebuiltTiles_.End(); ++i)
+        tiles.Push(*i);
+
+    for (HashMap<unsigned, PODVector<IntVector2> >::ConstIterator i = watchedPaths_.Begin(); i != watchedPaths_.End(); ++i)
+    {
+        const PODVector<IntVector2>& pathTiles = i->second_;
+        for (unsigned j = 0; j < pathTiles.Size(); ++j)
+        {
+            if (rebuiltTiles_.Contains(pathTiles[j]))
+            {
+                requesters.Push(i->first_);
+                break;
+            }
+        }
+    }
+
+    rebuiltTiles_.Clear();
+
+    using namespace RebuildQueueFlushed;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_TILES] = tiles;
+    eventData[P_REQUESTERS] = requesters;
+    SendEvent(E_REBUILDQUEUEFLUSHED, eventData);
+}
+
+NavigationMesh* NavigationRebuildQueue::GetNavigationMesh() const
+{
+    Scene* scene = GetScene();
+    return scene ? scene->GetComponent<NavigationMesh>() : 0;
+}
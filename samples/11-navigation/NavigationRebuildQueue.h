@@ -0,0 +1,81 @@
+//
+// Created by AICDG on 2017/10/11.
+//
+
+#ifndef URHO3DSAMPLES_NAVIGATIONREBUILDQUEUE_H
+#define URHO3DSAMPLES_NAVIGATIONREBUILDQUEUE_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Scene/Component.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+}
+
+using namespace Urho3D;
+
+/// Navigation rebuild queue flushed: all dirty tiles have been rebuilt.
+URHO3D_EVENT(E_REBUILDQUEUEFLUSHED, RebuildQueueFlushed)
+{
+    URHO3D_PARAM(P_TILES, Tiles);                  // VariantVector of IntVector2, rebuilt tiles
+    URHO3D_PARAM(P_REQUESTERS, Requesters);        // VariantVector of unsigned, requesters whose watched path needs re-planning
+}
+
+/// Deferred navigation mesh rebuild queue. Merges dirty areas into a set of dirty tiles and rebuilds them once per frame,
+/// optionally under a time budget, so that a burst of edits rebuilds each tile once.
+class NavigationRebuildQueue : public Component
+{
+    URHO3D_OBJECT(NavigationRebuildQueue, Component);
+
+public:
+    /// Construct.
+    NavigationRebuildQueue(Context* context);
+    /// Register object factory and attributes.
+    static void RegisterObject(Context* context);
+
+    /// Mark the tiles overlapping a world space bounding box dirty.
+    void QueueRebuild(const BoundingBox& worldBox);
+    /// Rebuild dirty tiles now. With a zero budget rebuild all of them. Return true when no dirty tiles remain.
+    bool Flush(float budgetMs = 0.0f);
+    /// Forget the dirty tiles, eg. after a full rebuild.
+    void Clear();
+    /// Watch a path for re-planning. The requester is reported when a tile the path crosses is rebuilt.
+    void WatchPath(unsigned requester, const PODVector<Vector3>& path);
+    /// Stop watching the path of a requester.
+    void UnwatchPath(unsigned requester);
+    /// Set per-frame rebuild time budget in milliseconds. Zero flushes all dirty tiles each frame.
+    void SetTimeBudget(float budgetMs);
+
+    /// Return per-frame rebuild time budget in milliseconds.
+    float GetTimeBudget() const { return timeBudget_; }
+    /// Return number of dirty tiles.
+    unsigned GetNumDirtyTiles() const { return dirtyTiles_.Size(); }
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Handle the frame update. Flush under the time budget.
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+    /// Send the flush notification with the rebuilt tiles and the paths needing re-planning.
+    void SendFlushedEvent();
+    /// Return the navigation mesh.
+    NavigationMesh* GetNavigationMesh() const;
+
+    /// Dirty tiles.
+    HashSet<IntVector2> dirtyTiles_;
+    /// Tiles rebuilt since the last flush notification.
+    HashSet<IntVector2> rebuiltTiles_;
+    /// Tiles crossed by the watched paths, by requester.
+    HashMap<unsigned, PODVector<IntVector2> > watchedPaths_;
+    /// Per-frame rebuild time budget in milliseconds.
+    float timeBudget_;
+};
+
+#endif //URHO3DSAMPLES_NAVIGATIONREBUILDQUEUE_H
@@ -0,0 +1,85 @@
+//
+// Created by AICDG on 2017/10/13.
+//
+
+#ifndef URHO3DSAMPLES_NAVIGATIONTILEARCHIVE_H
+#define URHO3DSAMPLES_NAVIGATIONTILEARCHIVE_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Math/Vector2.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+}
+
+using namespace Urho3D;
+
+/// Memory-mapped on-disk archive of navigation mesh tiles. The archive is written from a fully built navigation mesh, and tiles
+/// are read straight from the mapping when streamed in, so only the touched pages of the file become resident.
+class NavigationTileArchive
+{
+public:
+    /// Construct.
+    NavigationTileArchive();
+    /// Destruct. Unmap the file.
+    ~NavigationTileArchive();
+
+    /// Write all tiles of a navigation mesh to an archive file. The file is only replaced once the archive is complete. Return
+    /// true on success.
+    static bool Write(NavigationMesh* navMesh, const String& fileName);
+
+    /// Map an archive file and read its tile index. Return true on success.
+    bool Open(const String& fileName);
+    /// Unmap the archive file.
+    void Close();
+    /// Return pointer to a tile's data inside the mapping, or null if the tile is not in the archive.
+    const unsigned char* GetTileData(const IntVector2& tile, unsigned& size) const;
+    /// Copy a tile's data to a buffer. Return false if the tile is not in the archive. Safe to call from worker threads.
+    bool GetTile(const IntVector2& tile, PODVector<unsigned char>& dest) const;
+    /// Add a tile from the archive to the navigation mesh.
+    bool AddTile(NavigationMesh* navMesh, const IntVector2& tile);
+
+    /// Return whether an archive is mapped.
+    bool IsOpen() const { return data_ != 0; }
+    /// Return whether a tile is in the archive.
+    bool HasTile(const IntVector2& tile) const { return index_.Contains(tile); }
+    /// Return number of tiles in the archive.
+    unsigned GetNumTiles() const { return index_.Size(); }
+    /// Return number of tiles in the navigation mesh the archive was written from.
+    const IntVector2& GetNumMeshTiles() const { return numMeshTiles_; }
+    /// Return size of the mapped file in bytes.
+    unsigned GetMappedSize() const { return size_; }
+
+private:
+    /// Location of a tile in the archive.
+    struct TileEntry
+    {
+        /// Offset from the start of the file.
+        unsigned offset_;
+        /// Size in bytes.
+        unsigned size_;
+    };
+
+    /// Tile index.
+    HashMap<IntVector2, TileEntry> index_;
+    /// Buffer for handing the tile data to the navigation mesh.
+    PODVector<unsigned char> buffer_;
+    /// Number of tiles in the navigation mesh the archive was written from.
+    IntVector2 numMeshTiles_;
+    /// Mapped file data.
+    const unsigned char* data_;
+    /// Mapped file size.
+    unsigned size_;
+#ifdef _WIN32
+    /// File handle.
+    void* fileHandle_;
+    /// File mapping handle.
+    void* mappingHandle_;
+#endif
+};
+
+#endif //URHO3DSAMPLES_NAVIGATIONTILEARCHIVE_H
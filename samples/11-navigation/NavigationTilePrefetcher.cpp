@@ -0,0 +1,200 @@
+//
+// Created by AICDG on 2017/10/14.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+
+#include "NavigationTileArchive.h"
+#include "NavigationTilePrefetcher.h"
+#include "NavigationTileStore.h"
+
+/// Work item priority of the tile decoding. Below the path query batches, which the main thread may be waiting on.
+static const unsigned TILE_PREFETCH_PRIORITY = 0;
+/// Frames a decoded tile is kept after it was last predicted to be needed.
+static const unsigned STALE_TILE_FRAMES = 120;
+/// Maximum lookahead distance in tiles, which keeps a teleport from predicting a long trail of tiles.
+static const float MAX_LOOKAHEAD_TILES = 8.0f;
+
+NavigationTilePrefetcher::NavigationTilePrefetcher(Context* context) :
+    Object(context),
+    archive_(0),
+    store_(0),
+    lastFocus_(Vector3::ZERO),
+    velocity_(Vector3::ZERO),
+    hasLastFocus_(false),
+    lookahead_(2.0f),
+    streamingDistance_(2),
+    maxTilesPerFrame_(2),
+    maxDecodedTiles_(64),
+    tilesAttached_(0),
+    frameNumber_(0)
+{
+}
+
+NavigationTilePrefetcher::~NavigationTilePrefetcher()
+{
+    Reset();
+}
+
+void NavigationTilePrefetcher::SetTileSources(const NavigationTileArchive* archive, const NavigationTileStore* store)
+{
+    Reset();
+    archive_ = archive;
+    store_ = store;
+}
+
+void NavigationTilePrefetcher::Prefetch(NavigationMesh* navMesh, const Vector3& focus, const PODVector<Vector3>& corridor,
+    float timeStep)
+{
+    ++frameNumber_;
+    tilesAttached_ = 0;
+
+    // Estimate the velocity from the focus movement, smoothed so that a single jerky frame does not swing the prediction
+    if (hasLastFocus_ && timeStep > 0.0f)
+        velocity_ = velocity_.Lerp((focus - lastFocus_) / timeStep, 0.25f);
+    lastFocus_ = focus;
+    hasLastFocus_ = true;
+
+    const float tileWorldSize = navMesh->GetTileSize() * navMesh->GetCellSize();
+    const float sampleSpacing = tileWorldSize * 0.5f;
+    const float lookaheadDistance = Clamp(velocity_.Length() * lookahead_, tileWorldSize, tileWorldSize * MAX_LOOKAHEAD_TILES);
+
+    // Extrapolate along the velocity. Samples half a tile apart do not skip over any tile
+    const Vector3 direction = Vector3(velocity_.x_, 0.0f, velocity_.z_).Normalized();
+    if (direction != Vector3::ZERO)
+    {
+        for (float distance = sampleSpacing; distance <= lookaheadDistance; distance += sampleSpacing)
+            RequestWindow(navMesh, focus + direction * distance);
+    }
+
+    // Walk the path corridor up to the same distance, which covers turns the extrapolation would miss
+    Vector3 position = focus;
+    float remaining = lookaheadDistance;
+    for (unsigned i = 0; i < corridor.Size() && remaining > 0.0f; ++i)
+    {
+        const Vector3 segment = corridor[i] - position;
+        const float length = Min(segment.Length(), remaining);
+        for (float distance = sampleSpacing; distance <= length; distance += sampleSpacing)
+            RequestWindow(navMesh, position + segment.Normalized() * distance);
+        position = corridor[i];
+        remaining -= length;
+    }
+
+    EvictStaleTiles();
+}
+
+void NavigationTilePrefetcher::Request(const IntVector2& tile)
+{
+    HashMap<IntVector2, SharedPtr<PrefetchedTile> >::Iterator i = tiles_.Find(tile);
+    if (i != tiles_.End())
+    {
+        i->second_->lastWanted_ = frameNumber_;
+        return;
+    }
+    if (!HasSourceTile(tile))
+        return;
+
+    SharedPtr<PrefetchedTile> prefetched(new PrefetchedTile());
+    prefetched->tile_ = tile;
+    prefetched->valid_ = false;
+    prefetched->lastWanted_ = frameNumber_;
+
+    // Not a pooled item, the completion is polled on later frames
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    SharedPtr<WorkItem> item(new WorkItem());
+    item->priority_ = TILE_PREFETCH_PRIORITY;
+    item->workFunction_ = DecodeTile;
+    item->start_ = this;
+    item->aux_ = prefetched.Get();
+    prefetched->workItem_ = item;
+    tiles_[tile] = prefetched;
+    queue->AddWorkItem(item);
+}
+
+bool NavigationTilePrefetcher::TakeTile(const IntVector2& tile, PODVector<unsigned char>& dest)
+{
+    HashMap<IntVector2, SharedPtr<PrefetchedTile> >::Iterator i = tiles_.Find(tile);
+    if (i == tiles_.End())
+    {
+        Request(tile);
+        return false;
+    }
+
+    PrefetchedTile* prefetched = i->second_;
+    prefetched->lastWanted_ = frameNumber_;
+    if (!CanAttach() || !prefetched->workItem_->completed_)
+        return false;
+
+    const bool valid = prefetched->valid_;
+    if (valid)
+    {
+        dest.Swap(prefetched->data_);
+        ++tilesAttached_;
+    }
+    tiles_.Erase(i);
+    return valid;
+}
+
+void NavigationTilePrefetcher::Reset()
+{
+    // The work items point to the decoded tiles, so they must be finished or removed before the tiles are dropped
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    for (HashMap<IntVector2, SharedPtr<PrefetchedTile> >::Iterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+    {
+        if (!i->second_->workItem_->completed_ && !queue->RemoveWorkItem(i->second_->workItem_))
+            queue->Complete(TILE_PREFETCH_PRIORITY);
+    }
+
+    tiles_.Clear();
+    velocity_ = Vector3::ZERO;
+    hasLastFocus_ = false;
+    tilesAttached_ = 0;
+}
+
+void NavigationTilePrefetcher::RequestWindow(NavigationMesh* navMesh, const Vector3& position)
+{
+    const IntVector2 centerTile = navMesh->GetTileIndex(position);
+    const IntVector2 numTiles = navMesh->GetNumTiles();
+    const IntVector2 beginTile = VectorMax(IntVector2::ZERO, centerTile - IntVector2::ONE * streamingDistance_);
+    const IntVector2 endTile = VectorMin(centerTile + IntVector2::ONE * streamingDistance_, numTiles - IntVector2::ONE);
+
+    for (int z = beginTile.y_; z <= endTile.y_; ++z)
+        for (int x = beginTile.x_; x <= endTile.x_; ++x)
+        {
+            const IntVector2 tileIdx(x, z);
+            if (!navMesh->HasTile(tileIdx) && (tiles_.Contains(tileIdx) || tiles_.Size() < maxDecodedTiles_))
+                Request(tileIdx);
+        }
+}
+
+bool NavigationTilePrefetcher::HasSourceTile(const IntVector2& tile) const
+{
+    if (archive_ && archive_->IsOpen())
+        return archive_->HasTile(tile);
+    return store_ && store_->HasTile(tile);
+}
+
+void NavigationTilePrefetcher::EvictStaleTiles()
+{
+    for (HashMap<IntVector2, SharedPtr<PrefetchedTile> >::Iterator i = tiles_.Begin(); i != tiles_.End();)
+    {
+        PrefetchedTile* prefetched = i->second_;
+        if (prefetched->workItem_->completed_ && frameNumber_ - prefetched->lastWanted_ > STALE_TILE_FRAMES)
+            i = tiles_.Erase(i);
+        else
+            ++i;
+    }
+}
+
+void NavigationTilePrefetcher::DecodeTile(const WorkItem* item, unsigned threadIndex)
+{
+    const NavigationTilePrefetcher* prefetcher = static_cast<const NavigationTilePrefetcher*>(item->start_);
+    PrefetchedTile* prefetched = static_cast<PrefetchedTile*>(item->aux_);
+
+    // The tile sources are only read here. They are not changed while decoding is in flight, see SetTileSources()
+    if (prefetcher->archive_ && prefetcher->archive_->IsOpen())
+        prefetched->valid_ = prefetcher->archive_->GetTile(prefetched->tile_, prefetched->data_);
+    else
+        prefetched->valid_ = prefetcher->store_ && prefetcher->store_->GetTile(prefetched->tile_, prefetched->data_);
+}
@@ -0,0 +1,122 @@
+//
+// Created by AICDG on 2017/10/14.
+//
+
+#ifndef URHO3DSAMPLES_NAVIGATIONTILEPREFETCHER_H
+#define URHO3DSAMPLES_NAVIGATIONTILEPREFETCHER_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+}
+
+class NavigationTileArchive;
+class NavigationTileStore;
+
+using namespace Urho3D;
+
+/// Tile decoded ahead of time by the prefetcher.
+struct PrefetchedTile : public RefCounted
+{
+    /// Tile index.
+    IntVector2 tile_;
+    /// Decoded tile data, ready for NavigationMesh::AddTile().
+    PODVector<unsigned char> data_;
+    /// Decode work item.
+    SharedPtr<WorkItem> workItem_;
+    /// Whether decoding succeeded.
+    bool valid_;
+    /// Last frame the tile was predicted to be needed.
+    unsigned lastWanted_;
+};
+
+/// Velocity-predictive navigation mesh tile prefetcher. Extrapolates the streaming focus along its velocity and path corridor,
+/// decodes the tiles it will need soon on worker threads, and hands them out under a per-frame attach budget.
+class NavigationTilePrefetcher : public Object
+{
+    URHO3D_OBJECT(NavigationTilePrefetcher, Object);
+
+public:
+    /// Construct.
+    NavigationTilePrefetcher(Context* context);
+    /// Destruct. Wait for the decode work.
+    virtual ~NavigationTilePrefetcher();
+
+    /// Set the tile sources. The archive is used when open, otherwise the store. Resets the prefetcher.
+    void SetTileSources(const NavigationTileArchive* archive, const NavigationTileStore* store);
+    /// Predict the tiles needed soon from the focus movement and corridor and queue them for decoding. Call once per frame.
+    void Prefetch(NavigationMesh* navMesh, const Vector3& focus, const PODVector<Vector3>& corridor, float timeStep);
+    /// Queue a tile for decoding.
+    void Request(const IntVector2& tile);
+    /// Take a decoded tile for attaching, counted against the frame's budget. Return false and queue the tile if it is not
+    /// decoded yet, or if the budget is used up.
+    bool TakeTile(const IntVector2& tile, PODVector<unsigned char>& dest);
+    /// Wait for the decode work and drop the decoded tiles.
+    void Reset();
+
+    /// Set how far ahead the focus movement is extrapolated, in seconds.
+    void SetLookahead(float seconds) { lookahead_ = Max(seconds, 0.0f); }
+    /// Set the streaming distance in tiles around each predicted position.
+    void SetStreamingDistance(int distance) { streamingDistance_ = Max(distance, 0); }
+    /// Set maximum number of tiles attached per frame.
+    void SetMaxTilesPerFrame(unsigned maxTiles) { maxTilesPerFrame_ = maxTiles; }
+    /// Set maximum number of decoded tiles kept waiting to be attached.
+    void SetMaxDecodedTiles(unsigned maxTiles) { maxDecodedTiles_ = maxTiles; }
+
+    /// Return lookahead in seconds.
+    float GetLookahead() const { return lookahead_; }
+    /// Return streaming distance in tiles.
+    int GetStreamingDistance() const { return streamingDistance_; }
+    /// Return maximum number of tiles attached per frame.
+    unsigned GetMaxTilesPerFrame() const { return maxTilesPerFrame_; }
+    /// Return whether the frame's attach budget allows another tile.
+    bool CanAttach() const { return tilesAttached_ < maxTilesPerFrame_; }
+    /// Return estimated focus velocity.
+    const Vector3& GetVelocity() const { return velocity_; }
+    /// Return number of tiles decoded or being decoded.
+    unsigned GetNumPrefetchedTiles() const { return tiles_.Size(); }
+
+private:
+    /// Queue the streaming window around a position.
+    void RequestWindow(NavigationMesh* navMesh, const Vector3& position);
+    /// Return whether a tile is in the tile sources.
+    bool HasSourceTile(const IntVector2& tile) const;
+    /// Drop decoded tiles that have not been predicted for a while.
+    void EvictStaleTiles();
+    /// Worker function: decode a tile.
+    static void DecodeTile(const WorkItem* item, unsigned threadIndex);
+
+    /// Memory-mapped tile archive.
+    const NavigationTileArchive* archive_;
+    /// Compressed tile store.
+    const NavigationTileStore* store_;
+    /// Decoded and in-flight tiles.
+    HashMap<IntVector2, SharedPtr<PrefetchedTile> > tiles_;
+    /// Focus position on the previous frame.
+    Vector3 lastFocus_;
+    /// Estimated focus velocity.
+    Vector3 velocity_;
+    /// Whether the previous focus position is known.
+    bool hasLastFocus_;
+    /// Lookahead in seconds.
+    float lookahead_;
+    /// Streaming distance in tiles.
+    int streamingDistance_;
+    /// Maximum tiles attached per frame.
+    unsigned maxTilesPerFrame_;
+    /// Maximum decoded tiles kept.
+    unsigned maxDecodedTiles_;
+    /// Tiles attached this frame.
+    unsigned tilesAttached_;
+    /// Frame counter.
+    unsigned frameNumber_;
+};
+
+#endif //URHO3DSAMPLES_NAVIGATIONTILEPREFETCHER_H
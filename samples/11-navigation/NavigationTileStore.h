@@ -0,0 +1,79 @@
+//
+// Created by AICDG on 2017/10/12.
+//
+
+#ifndef URHO3DSAMPLES_NAVIGATIONTILESTORE_H
+#define URHO3DSAMPLES_NAVIGATIONTILESTORE_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Math/Vector2.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+}
+
+using namespace Urho3D;
+
+/// Compressed in-memory store of navigation mesh tiles for streaming. Tiles are LZ4 compressed into one contiguous arena and
+/// decompressed when added to the navigation mesh.
+class NavigationTileStore
+{
+public:
+    /// Construct.
+    NavigationTileStore();
+
+    /// Compress and store all tiles of a navigation mesh, replacing the previous contents.
+    void Save(NavigationMesh* navMesh);
+    /// Decompress a tile to a buffer. Return false if the tile is not stored. Safe to call from worker threads.
+    bool GetTile(const IntVector2& tile, PODVector<unsigned char>& dest) const;
+    /// Decompress a tile and add it to the navigation mesh.
+    bool AddTile(NavigationMesh* navMesh, const IntVector2& tile);
+    /// Add a tile that has already been decompressed, e.g. on a worker thread, to the navigation mesh.
+    bool AddTile(NavigationMesh* navMesh, const IntVector2& tile, const PODVector<unsigned char>& tileData);
+    /// Remove a tile from the navigation mesh. The compressed data stays in the store.
+    void RemoveTile(NavigationMesh* navMesh, const IntVector2& tile);
+    /// Remove all tiles and data.
+    void Clear();
+
+    /// Return whether a tile is stored.
+    bool HasTile(const IntVector2& tile) const { return index_.Contains(tile); }
+    /// Return number of stored tiles.
+    unsigned GetNumTiles() const { return index_.Size(); }
+    /// Return total compressed size of the stored tiles in bytes.
+    unsigned GetCompressedSize() const { return arena_.Size(); }
+    /// Return total uncompressed size of the stored tiles in bytes.
+    unsigned GetUncompressedSize() const { return uncompressedSize_; }
+    /// Return uncompressed size of the tiles currently added to the navigation mesh in bytes.
+    unsigned GetResidentSize() const { return residentSize_; }
+
+private:
+    /// Location of a compressed tile in the arena.
+    struct TileEntry
+    {
+        /// Offset in the arena.
+        unsigned offset_;
+        /// Compressed size.
+        unsigned compressedSize_;
+        /// Uncompressed size.
+        unsigned size_;
+    };
+
+    /// Compressed tile data of all tiles.
+    PODVector<unsigned char> arena_;
+    /// Tile index.
+    HashMap<IntVector2, TileEntry> index_;
+    /// Tiles currently added to the navigation mesh.
+    HashSet<IntVector2> residentTiles_;
+    /// Decompression buffer.
+    PODVector<unsigned char> buffer_;
+    /// Total uncompressed size.
+    unsigned uncompressedSize_;
+    /// Uncompressed size of the resident tiles.
+    unsigned residentSize_;
+};
+
+#endif //URHO3DSAMPLES_NAVIGATIONTILESTORE_H
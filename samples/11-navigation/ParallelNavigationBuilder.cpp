@@ -0,0 +1,475 @@
+//
+// Created by AICDG on 2017/10/15.
+//
+
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Graphics/Terrain.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/VectorBuffer.h>
+#include <Urho3D/Navigation/NavArea.h>
+#include <Urho3D/Navigation/Navigable.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+#include <Urho3D/Navigation/OffMeshConnection.h>
+#include <Urho3D/Scene/Node.h>
+#ifdef URHO3D_PHYSICS
+#include <Urho3D/Physics/CollisionShape.h>
+#endif
+
+#include <Detour/DetourAlloc.h>
+#include <Detour/DetourNavMeshBuilder.h>
+#include <Recast/Recast.h>
+
+#include "ParallelNavigationBuilder.h"
+
+/// Work item priority of the tile builds. Above the path queries and tile decoding, so that waiting for the build does not
+/// wait for them.
+static const unsigned TILE_BUILD_PRIORITY = 2;
+
+/// Navigation mesh build parameters, read on the main thread before the tiles are built.
+struct TileBuildSettings
+{
+    float cellSize_;
+    float cellHeight_;
+    float agentHeight_;
+    float agentRadius_;
+    float agentMaxClimb_;
+    float agentMaxSlope_;
+    float regionMinSize_;
+    float regionMergeSize_;
+    float edgeMaxLength_;
+    float edgeMaxError_;
+    float detailSampleDistance_;
+    float detailSampleMaxError_;
+    int tileSize_;
+    bool watershed_;
+};
+
+/// Build job of one tile.
+struct TileBuildJob
+{
+    /// Build parameters.
+    const TileBuildSettings* settings_;
+    /// Tile index.
+    IntVector2 tile_;
+    /// Tile bounding box in navigation mesh space.
+    BoundingBox boundingBox_;
+    /// Detour tile data, empty if the tile has no walkable area.
+    PODVector<unsigned char> data_;
+    /// Build time in milliseconds.
+    float time_;
+    /// Number of polygons.
+    unsigned numPolys_;
+};
+
+/// Recast intermediate data of one tile, freed when the tile is done.
+struct TileBuildData
+{
+    TileBuildData() :
+        ctx_(false),
+        heightField_(0),
+        compactHeightField_(0),
+        contourSet_(0),
+        polyMesh_(0),
+        polyMeshDetail_(0)
+    {
+    }
+
+    ~TileBuildData()
+    {
+        rcFreeHeightField(heightField_);
+        rcFreeCompactHeightfield(compactHeightField_);
+        rcFreeContourSet(contourSet_);
+        rcFreePolyMesh(polyMesh_);
+        rcFreePolyMeshDetail(polyMeshDetail_);
+    }
+
+    /// Recast context, one per tile so that the workers share nothing.
+    rcContext ctx_;
+    /// Triangle vertices overlapping the tile.
+    PODVector<Vector3> vertices_;
+    /// Triangle indices overlapping the tile.
+    PODVector<int> indices_;
+    rcHeightfield* heightField_;
+    rcCompactHeightfield* compactHeightField_;
+    rcContourSet* contourSet_;
+    rcPolyMesh* polyMesh_;
+    rcPolyMeshDetail* polyMeshDetail_;
+};
+
+ParallelNavigationBuilder::ParallelNavigationBuilder(Context* context) :
+    Object(context),
+    unsupportedInput_(false),
+    buildTime_(0.0f),
+    totalTileTime_(0.0f)
+{
+}
+
+bool ParallelNavigationBuilder::Build(NavigationMesh* navMesh)
+{
+    HiresTimer buildTimer;
+    tileStats_.Clear();
+    buildTime_ = 0.0f;
+    totalTileTime_ = 0.0f;
+
+    CollectGeometry(navMesh);
+    if (unsupportedInput_)
+    {
+        vertices_.Clear();
+        indices_.Clear();
+        chunks_.Clear();
+        URHO3D_LOGINFO("Navigation areas, off-mesh connections, terrains or collision shapes found, parallel navigation mesh "
+            "build not used");
+        return false;
+    }
+    if (chunks_.Empty())
+    {
+        URHO3D_LOGWARNING("No navigable geometry for the parallel navigation mesh build");
+        return false;
+    }
+
+    // Same bounds as NavigationMesh::Build(): the collected geometry expanded by the padding
+    BoundingBox bounds;
+    for (unsigned i = 0; i < chunks_.Size(); ++i)
+        bounds.Merge(chunks_[i].boundingBox_);
+    bounds.min_ -= navMesh->GetPadding();
+    bounds.max_ += navMesh->GetPadding();
+
+    // Grid size as Recast calculates it
+    const float cellSize = navMesh->GetCellSize();
+    const int tileSize = navMesh->GetTileSize();
+    const int gridWidth = (int)((bounds.max_.x_ - bounds.min_.x_) / cellSize + 0.5f);
+    const int gridHeight = (int)((bounds.max_.z_ - bounds.min_.z_) / cellSize + 0.5f);
+    const int maxTiles = ((gridWidth + tileSize - 1) / tileSize) * ((gridHeight + tileSize - 1) / tileSize);
+    if (!navMesh->Allocate(bounds.Transformed(navMesh->GetNode()->GetWorldTransform()), (unsigned)maxTiles))
+        return false;
+
+    TileBuildSettings settings;
+    settings.cellSize_ = cellSize;
+    settings.cellHeight_ = navMesh->GetCellHeight();
+    settings.agentHeight_ = navMesh->GetAgentHeight();
+    settings.agentRadius_ = navMesh->GetAgentRadius();
+    settings.agentMaxClimb_ = navMesh->GetAgentMaxClimb();
+    settings.agentMaxSlope_ = navMesh->GetAgentMaxSlope();
+    settings.regionMinSize_ = navMesh->GetRegionMinSize();
+    settings.regionMergeSize_ = navMesh->GetRegionMergeSize();
+    settings.edgeMaxLength_ = navMesh->GetEdgeMaxLength();
+    settings.edgeMaxError_ = navMesh->GetEdgeMaxError();
+    settings.detailSampleDistance_ = navMesh->GetDetailSampleDistance();
+    settings.detailSampleMaxError_ = navMesh->GetDetailSampleMaxError();
+    settings.tileSize_ = tileSize;
+    settings.watershed_ = navMesh->GetPartitionType() == NAVMESH_PARTITION_WATERSHED;
+
+    // One work item per tile, the workers pick them up as they become free
+    const IntVector2 numTiles = navMesh->GetNumTiles();
+    Vector<TileBuildJob> jobs;
+    jobs.Resize((unsigned)(numTiles.x_ * numTiles.y_));
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    for (int z = 0; z < numTiles.y_; ++z)
+        for (int x = 0; x < numTiles.x_; ++x)
+        {
+            TileBuildJob& job = jobs[z * numTiles.x_ + x];
+            job.settings_ = &settings;
+            job.tile_ = IntVector2(x, z);
+            job.boundingBox_ = navMesh->GetTileBoundingBox(job.tile_);
+            job.time_ = 0.0f;
+            job.numPolys_ = 0;
+
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->priority_ = TILE_BUILD_PRIORITY;
+            item->workFunction_ = BuildTile;
+            item->start_ = &job;
+            item->aux_ = this;
+            queue->AddWorkItem(item);
+        }
+    queue->Complete(TILE_BUILD_PRIORITY);
+
+    // Add the finished tiles on the main thread
+    VectorBuffer tileData;
+    unsigned numBuiltTiles = 0;
+    const TileBuildJob* slowestJob = &jobs.Front();
+    for (unsigned i = 0; i < jobs.Size(); ++i)
+    {
+        const TileBuildJob& job = jobs[i];
+        TileBuildStats stats;
+        stats.tile_ = job.tile_;
+        stats.time_ = job.time_;
+        stats.numPolys_ = job.numPolys_;
+        tileStats_.Push(stats);
+        totalTileTime_ += job.time_;
+        if (job.time_ > slowestJob->time_)
+            slowestJob = &job;
+
+        if (job.data_.Empty())
+            continue;
+
+        // Same layout as NavigationMesh::GetTileData(): tile index, tile reference (assigned again when added), data size and
+        // the Detour tile data
+        tileData.Clear();
+        tileData.WriteInt(job.tile_.x_);
+        tileData.WriteInt(job.tile_.y_);
+        tileData.WriteUInt(0);
+        tileData.WriteUInt(job.data_.Size());
+        tileData.Write(&job.data_[0], job.data_.Size());
+        if (navMesh->AddTile(tileData.GetBuffer()))
+            ++numBuiltTiles;
+    }
+
+    vertices_.Clear();
+    indices_.Clear();
+    chunks_.Clear();
+
+    buildTime_ = buildTimer.GetUSec(false) / 1000.0f;
+    URHO3D_LOGINFOF("Built %u navigation tiles on %u threads in %.2f ms (%.2f ms of tile work, slowest tile %d,%d %.2f ms)",
+        numBuiltTiles, queue->GetNumThreads() + 1, buildTime_, totalTileTime_, slowestJob->tile_.x_, slowestJob->tile_.y_,
+        slowestJob->time_);
+    return true;
+}
+
+void ParallelNavigationBuilder::CollectGeometry(NavigationMesh* navMesh)
+{
+    vertices_.Clear();
+    indices_.Clear();
+    chunks_.Clear();
+
+    // The tile builds only rasterize triangles, so area marking and off-mesh connections would be silently lost
+    PODVector<NavArea*> areas;
+    PODVector<OffMeshConnection*> connections;
+    navMesh->GetNode()->GetComponents<NavArea>(areas, true);
+    navMesh->GetNode()->GetComponents<OffMeshConnection>(connections, true);
+    unsupportedInput_ = !areas.Empty() || !connections.Empty();
+
+    // Like NavigationMesh, take the Navigable components from the navigation mesh node and its children
+    PODVector<Navigable*> navigables;
+    navMesh->GetNode()->GetComponents<Navigable>(navigables, true);
+    for (unsigned i = 0; i < navigables.Size(); ++i)
+    {
+        if (navigables[i]->IsEnabledEffective())
+            CollectGeometry(navMesh, navigables[i]->GetNode(), navigables[i]->IsRecursive());
+    }
+
+    processedNodes_.Clear();
+}
+
+void ParallelNavigationBuilder::CollectGeometry(NavigationMesh* navMesh, Node* node, bool recursive)
+{
+    if (processedNodes_.Contains(node))
+        return;
+    processedNodes_.Insert(node);
+
+    // NavigationMesh prefers the physics geometry of a node over its drawables, and also reads terrains. Neither is collected
+    // here, so such nodes would give a different mesh
+    if (node->GetComponent<Terrain>())
+        unsupportedInput_ = true;
+#ifdef URHO3D_PHYSICS
+    if (node->GetComponent<CollisionShape>())
+        unsupportedInput_ = true;
+#endif
+
+    const Matrix3x4 transform = navMesh->GetNode()->GetWorldTransform().Inverse() * node->GetWorldTransform();
+
+    // Exact type match, animated models are not part of the navigation mesh
+    PODVector<StaticModel*> models;
+    node->GetComponents<StaticModel>(models);
+    for (unsigned i = 0; i < models.Size(); ++i)
+    {
+        StaticModel* model = models[i];
+        if (!model->IsEnabledEffective())
+            continue;
+
+        for (unsigned j = 0; j < model->GetNumGeometries(); ++j)
+        {
+            Geometry* geometry = model->GetLodGeometry(j, model->GetOcclusionLodLevel());
+            if (!geometry || !geometry->GetIndexCount())
+                continue;
+
+            const unsigned char* vertexData;
+            const unsigned char* indexData;
+            unsigned vertexSize;
+            unsigned indexSize;
+            const PODVector<VertexElement>* elements;
+            geometry->GetRawData(vertexData, vertexSize, indexData, indexSize, elements);
+            if (!vertexData || !indexData || !elements ||
+                VertexBuffer::GetElementOffset(*elements, TYPE_VECTOR3, SEM_POSITION) != 0)
+                continue;
+
+            GeometryChunk chunk;
+            chunk.vertexStart_ = vertices_.Size();
+            chunk.vertexCount_ = geometry->GetVertexCount();
+            chunk.indexStart_ = indices_.Size();
+            chunk.indexCount_ = geometry->GetIndexCount();
+
+            const unsigned vertexStart = geometry->GetVertexStart();
+            for (unsigned k = vertexStart; k < vertexStart + chunk.vertexCount_; ++k)
+            {
+                const Vector3 vertex = transform * *reinterpret_cast<const Vector3*>(&vertexData[k * vertexSize]);
+                vertices_.Push(vertex);
+                chunk.boundingBox_.Merge(vertex);
+            }
+
+            // Indices relative to the chunk's first vertex
+            const unsigned indexStart = geometry->GetIndexStart();
+            for (unsigned k = indexStart; k < indexStart + chunk.indexCount_; ++k)
+            {
+                const unsigned index = indexSize == sizeof(unsigned short) ?
+                    reinterpret_cast<const unsigned short*>(indexData)[k] : reinterpret_cast<const unsigned*>(indexData)[k];
+                indices_.Push((int)(index - vertexStart));
+            }
+
+            chunks_.Push(chunk);
+        }
+    }
+
+    if (recursive)
+    {
+        const Vector<SharedPtr<Node> >& children = node->GetChildren();
+        for (unsigned i = 0; i < children.Size(); ++i)
+            CollectGeometry(navMesh, children[i], recursive);
+    }
+}
+
+void ParallelNavigationBuilder::BuildTile(const WorkItem* item, unsigned threadIndex)
+{
+    const ParallelNavigationBuilder* builder = static_cast<const ParallelNavigationBuilder*>(item->aux_);
+    TileBuildJob* job = static_cast<TileBuildJob*>(item->start_);
+    const TileBuildSettings& settings = *job->settings_;
+    HiresTimer tileTimer;
+
+    // Same configuration as NavigationMesh::BuildTile()
+    rcConfig cfg;
+    memset(&cfg, 0, sizeof cfg);
+    cfg.cs = settings.cellSize_;
+    cfg.ch = settings.cellHeight_;
+    cfg.walkableSlopeAngle = settings.agentMaxSlope_;
+    cfg.walkableHeight = (int)ceilf(settings.agentHeight_ / cfg.ch);
+    cfg.walkableClimb = (int)floorf(settings.agentMaxClimb_ / cfg.ch);
+    cfg.walkableRadius = (int)ceilf(settings.agentRadius_ / cfg.cs);
+    cfg.maxEdgeLen = (int)(settings.edgeMaxLength_ / cfg.cs);
+    cfg.maxSimplificationError = settings.edgeMaxError_;
+    cfg.minRegionArea = (int)sqrtf(settings.regionMinSize_);
+    cfg.mergeRegionArea = (int)sqrtf(settings.regionMergeSize_);
+    cfg.maxVertsPerPoly = 6;
+    cfg.tileSize = settings.tileSize_;
+    cfg.borderSize = cfg.walkableRadius + 3;
+    cfg.width = cfg.tileSize + cfg.borderSize * 2;
+    cfg.height = cfg.tileSize + cfg.borderSize * 2;
+    cfg.detailSampleDist = settings.detailSampleDistance_ < 0.9f ? 0.0f : cfg.cs * settings.detailSampleDistance_;
+    cfg.detailSampleMaxError = cfg.ch * settings.detailSampleMaxError_;
+
+    rcVcopy(cfg.bmin, &job->boundingBox_.min_.x_);
+    rcVcopy(cfg.bmax, &job->boundingBox_.max_.x_);
+    cfg.bmin[0] -= cfg.borderSize * cfg.cs;
+    cfg.bmin[2] -= cfg.borderSize * cfg.cs;
+    cfg.bmax[0] += cfg.borderSize * cfg.cs;
+    cfg.bmax[2] += cfg.borderSize * cfg.cs;
+    const BoundingBox expandedBox(Vector3(cfg.bmin), Vector3(cfg.bmax));
+
+    // Gather the geometry overlapping the tile and its border. The collected geometry is only read here
+    TileBuildData build;
+    for (unsigned i = 0; i < builder->chunks_.Size(); ++i)
+    {
+        const GeometryChunk& chunk = builder->chunks_[i];
+        if (expandedBox.IsInside(chunk.boundingBox_) == OUTSIDE)
+            continue;
+
+        const int vertexOffset = (int)build.vertices_.Size();
+        for (unsigned k = 0; k < chunk.vertexCount_; ++k)
+            build.vertices_.Push(builder->vertices_[chunk.vertexStart_ + k]);
+        for (unsigned k = 0; k < chunk.indexCount_; ++k)
+            build.indices_.Push(builder->indices_[chunk.indexStart_ + k] + vertexOffset);
+    }
+
+    if (!build.indices_.Empty())
+    {
+        const int numVertices = (int)build.vertices_.Size();
+        const int numTriangles = (int)build.indices_.Size() / 3;
+        PODVector<unsigned char> triAreas((unsigned)numTriangles);
+        memset(&triAreas[0], 0, triAreas.Size());
+
+        build.heightField_ = rcAllocHeightfield();
+        build.compactHeightField_ = rcAllocCompactHeightfield();
+        build.contourSet_ = rcAllocContourSet();
+        build.polyMesh_ = rcAllocPolyMesh();
+        build.polyMeshDetail_ = rcAllocPolyMeshDetail();
+
+        bool success = rcCreateHeightfield(&build.ctx_, *build.heightField_, cfg.width, cfg.height, cfg.bmin, cfg.bmax, cfg.cs,
+            cfg.ch);
+        if (success)
+        {
+            rcMarkWalkableTriangles(&build.ctx_, cfg.walkableSlopeAngle, &build.vertices_[0].x_, numVertices,
+                &build.indices_[0], numTriangles, &triAreas[0]);
+            rcRasterizeTriangles(&build.ctx_, &build.vertices_[0].x_, numVertices, &build.indices_[0], &triAreas[0],
+                numTriangles, *build.heightField_, cfg.walkableClimb);
+            rcFilterLowHangingWalkableObstacles(&build.ctx_, cfg.walkableClimb, *build.heightField_);
+            rcFilterWalkableLowHeightSpans(&build.ctx_, cfg.walkableHeight, *build.heightField_);
+            rcFilterLedgeSpans(&build.ctx_, cfg.walkableHeight, cfg.walkableClimb, *build.heightField_);
+
+            success = rcBuildCompactHeightfield(&build.ctx_, cfg.walkableHeight, cfg.walkableClimb, *build.heightField_,
+                *build.compactHeightField_) && rcErodeWalkableArea(&build.ctx_, cfg.walkableRadius, *build.compactHeightField_);
+        }
+        if (success)
+        {
+            if (settings.watershed_)
+                success = rcBuildDistanceField(&build.ctx_, *build.compactHeightField_) && rcBuildRegions(&build.ctx_,
+                    *build.compactHeightField_, cfg.borderSize, cfg.minRegionArea, cfg.mergeRegionArea);
+            else
+                success = rcBuildRegionsMonotone(&build.ctx_, *build.compactHeightField_, cfg.borderSize, cfg.minRegionArea,
+                    cfg.mergeRegionArea);
+        }
+        success = success &&
+            rcBuildContours(&build.ctx_, *build.compactHeightField_, cfg.maxSimplificationError, cfg.maxEdgeLen,
+                *build.contourSet_) &&
+            rcBuildPolyMesh(&build.ctx_, *build.contourSet_, cfg.maxVertsPerPoly, *build.polyMesh_) &&
+            rcBuildPolyMeshDetail(&build.ctx_, *build.polyMesh_, *build.compactHeightField_, cfg.detailSampleDist,
+                cfg.detailSampleMaxError, *build.polyMeshDetail_);
+
+        if (success && build.polyMesh_->npolys)
+        {
+            for (int i = 0; i < build.polyMesh_->npolys; ++i)
+            {
+                if (build.polyMesh_->areas[i] != RC_NULL_AREA)
+                    build.polyMesh_->flags[i] = 0x1;
+            }
+
+            dtNavMeshCreateParams params;
+            memset(&params, 0, sizeof params);
+            params.verts = build.polyMesh_->verts;
+            params.vertCount = build.polyMesh_->nverts;
+            params.polys = build.polyMesh_->polys;
+            params.polyAreas = build.polyMesh_->areas;
+            params.polyFlags = build.polyMesh_->flags;
+            params.polyCount = build.polyMesh_->npolys;
+            params.nvp = build.polyMesh_->nvp;
+            params.detailMeshes = build.polyMeshDetail_->meshes;
+            params.detailVerts = build.polyMeshDetail_->verts;
+            params.detailVertsCount = build.polyMeshDetail_->nverts;
+            params.detailTris = build.polyMeshDetail_->tris;
+            params.detailTriCount = build.polyMeshDetail_->ntris;
+            params.walkableHeight = settings.agentHeight_;
+            params.walkableRadius = settings.agentRadius_;
+            params.walkableClimb = settings.agentMaxClimb_;
+            params.tileX = job->tile_.x_;
+            params.tileY = job->tile_.y_;
+            rcVcopy(params.bmin, build.polyMesh_->bmin);
+            rcVcopy(params.bmax, build.polyMesh_->bmax);
+            params.cs = cfg.cs;
+            params.ch = cfg.ch;
+            params.buildBvTree = true;
+
+            unsigned char* navData = 0;
+            int navDataSize = 0;
+            if (dtCreateNavMeshData(&params, &navData, &navDataSize))
+            {
+                job->data_.Resize((unsigned)navDataSize);
+                memcpy(&job->data_[0], navData, (size_t)navDataSize);
+                job->numPolys_ = (unsigned)build.polyMesh_->npolys;
+                dtFree(navData);
+            }
+        }
+    }
+
+    job->time_ = tileTimer.GetUSec(false) / 1000.0f;
+}
@@ -0,0 +1,98 @@
+//
+// Created by AICDG on 2017/10/15.
+//
+
+#ifndef URHO3DSAMPLES_PARALLELNAVIGATIONBUILDER_H
+#define URHO3DSAMPLES_PARALLELNAVIGATIONBUILDER_H
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/BoundingBox.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+class Node;
+struct WorkItem;
+
+}
+
+using namespace Urho3D;
+
+/// Build statistics of one tile.
+struct TileBuildStats
+{
+    /// Tile index.
+    IntVector2 tile_;
+    /// Build time on the worker thread in milliseconds.
+    float time_;
+    /// Number of polygons in the tile.
+    unsigned numPolys_;
+};
+
+/// Builds all tiles of a navigation mesh on the work queue threads. The scene geometry is collected on the main thread, each
+/// tile is voxelized and turned into Detour tile data on a worker, and the finished tiles are added on the main thread. Only
+/// static model geometry is supported. When the navigation mesh has navigation areas or off-mesh connections, or its geometry
+/// has terrains or collision shapes, the build fails so that the caller falls back to NavigationMesh::Build().
+class ParallelNavigationBuilder : public Object
+{
+    URHO3D_OBJECT(ParallelNavigationBuilder, Object);
+
+public:
+    /// Construct.
+    ParallelNavigationBuilder(Context* context);
+
+    /// Rebuild the whole navigation mesh. Blocks until done, with the main thread helping the workers. Return true on success,
+    /// or false without touching the navigation mesh if its inputs are not supported.
+    bool Build(NavigationMesh* navMesh);
+
+    /// Return per-tile statistics of the last build.
+    const PODVector<TileBuildStats>& GetTileStats() const { return tileStats_; }
+    /// Return wall clock time of the last build in milliseconds.
+    float GetBuildTime() const { return buildTime_; }
+    /// Return summed worker time of the tiles of the last build in milliseconds.
+    float GetTotalTileTime() const { return totalTileTime_; }
+
+private:
+    /// Triangles of one drawable geometry in the collected triangle soup.
+    struct GeometryChunk
+    {
+        /// First vertex.
+        unsigned vertexStart_;
+        /// Number of vertices.
+        unsigned vertexCount_;
+        /// First index.
+        unsigned indexStart_;
+        /// Number of indices.
+        unsigned indexCount_;
+        /// Bounding box in navigation mesh space.
+        BoundingBox boundingBox_;
+    };
+
+    /// Collect the navigable static model geometry into the triangle soup, and check for inputs that are not supported.
+    void CollectGeometry(NavigationMesh* navMesh);
+    /// Collect the static models of a node and optionally its children.
+    void CollectGeometry(NavigationMesh* navMesh, Node* node, bool recursive);
+    /// Worker function: build one tile.
+    static void BuildTile(const WorkItem* item, unsigned threadIndex);
+
+    /// Vertices of the collected geometry in navigation mesh space.
+    PODVector<Vector3> vertices_;
+    /// Indices of the collected geometry.
+    PODVector<int> indices_;
+    /// Geometry chunks.
+    PODVector<GeometryChunk> chunks_;
+    /// Whether the last collected geometry had inputs that are not supported.
+    bool unsupportedInput_;
+    /// Nodes whose geometry has been collected.
+    HashSet<Node*> processedNodes_;
+    /// Per-tile statistics of the last build.
+    PODVector<TileBuildStats> tileStats_;
+    /// Wall clock time of the last build.
+    float buildTime_;
+    /// Summed worker time of the last build.
+    float totalTileTime_;
+};
+
+#endif //URHO3DSAMPLES_PARALLELNAVIGATIONBUILDER_H
@@ -0,0 +1,150 @@
+//
+// Created by AICDG on 2017/10/10.
+//
+
+#include <Detour/DetourNavMesh.h>
+
+#include "PathCache.h"
+
+static const unsigned DEFAULT_MAX_ENTRIES = 256;
+
+PathCache::PathCache() :
+    useCounter_(0),
+    maxEntries_(DEFAULT_MAX_ENTRIES),
+    numHits_(0),
+    numMisses_(0)
+{
+}
+
+bool PathCache::Lookup(const PathCacheKey& key, PODVector<dtPolyRef>& dest)
+{
+    MutexLock lock(mutex_);
+
+    HashMap<PathCacheKey, Entry>::Iterator i = entries_.Find(key);
+    if (i == entries_.End())
+    {
+        ++numMisses_;
+        return false;
+    }
+
+    ++numHits_;
+    Entry& entry = i->second_;
+    entry.lastUse_ = ++useCounter_;
+    dest = entry.corridor_;
+    return true;
+}
+
+void PathCache::Insert(const PathCacheKey& key, const PODVector<dtPolyRef>& corridor, const dtNavMesh* navMesh)
+{
+    if (corridor.Empty() || !maxEntries_)
+        return;
+
+    PODVector<IntVector2> tiles;
+    GetCorridorTiles(corridor, navMesh, tiles);
+
+    MutexLock lock(mutex_);
+
+    if (entries_.Size() >= maxEntries_ && !entries_.Contains(key))
+        EvictOldest();
+
+    Entry& entry = entries_[key];
+    entry.corridor_ = corridor;
+    entry.tiles_ = tiles;
+    entry.lastUse_ = ++useCounter_;
+}
+
+void PathCache::InvalidateTiles(const IntVector2& from, const IntVector2& to)
+{
+    MutexLock lock(mutex_);
+
+    for (HashMap<PathCacheKey, Entry>::Iterator i = entries_.Begin(); i != entries_.End();)
+    {
+        const PODVector<IntVector2>& tiles = i->second_.tiles_;
+        bool crosses = false;
+        for (unsigned j = 0; j < tiles.Size(); ++j)
+        {
+            const IntVector2& tile = tiles[j];
+            if (from.x_ <= tile.x_ && tile.x_ <= to.x_ && from.y_ <= tile.y_ && tile.y_ <= to.y_)
+            {
+                crosses = true;
+                break;
+            }
+        }
+
+        if (crosses)
+            i = entries_.Erase(i);
+        else
+            ++i;
+    }
+}
+
+void PathCache::Clear()
+{
+    MutexLock lock(mutex_);
+    entries_.Clear();
+}
+
+void PathCache::SetMaxEntries(unsigned maxEntries)
+{
+    MutexLock lock(mutex_);
+    maxEntries_ = maxEntries;
+    while (entries_.Size() > maxEntries_)
+        EvictOldest();
+}
+
+void PathCache::EvictOldest()
+{
+    if (entries_.Empty())
+        return;
+
+    HashMap<PathCacheKey, Entry>::Iterator oldest = entries_.Begin();
+    for (HashMap<PathCacheKey, Entry>::Iterator i = entries_.Begin(); i != entries_.End(); ++i)
+    {
+        if (i->second_.lastUse_ < oldest->second_.lastUse_)
+            oldest = i;
+    }
+    entries_.Erase(oldest);
+}
+
+unsigned PathCache::GetNumEntries() const
+{
+    MutexLock lock(mutex_);
+    return entries_.Size();
+}
+
+void PathCache::GetPathTiles(const PODVector<Vector3>& path, NavigationMesh* navMesh, PODVector<IntVector2>& dest)
+{
+    dest.Clear();
+
+    // Sample the segments at half tile intervals so that no tile is skipped
+    const float sampleDistance = 0.5f * navMesh->GetTileSize() * navMesh->GetCellSize();
+    for (unsigned i = 0; i < path.Size(); ++i)
+    {
+        const Vector3 segmentStart = path[i];
+        const Vector3 segmentEnd = i + 1 < path.Size() ? path[i + 1] : path[i];
+        const unsigned numSamples = (unsigned)((segmentEnd - segmentStart).Length() / sampleDistance) + 1;
+        for (unsigned j = 0; j < numSamples; ++j)
+        {
+            const IntVector2 tile = navMesh->GetTileIndex(segmentStart.Lerp(segmentEnd, (float)j / numSamples));
+            if (!dest.Contains(tile))
+                dest.Push(tile);
+        }
+    }
+}
+
+void PathCache::GetCorridorTiles(const PODVector<dtPolyRef>& corridor, const dtNavMesh* navMesh, PODVector<IntVector2>& dest)
+{
+    dest.Clear();
+
+    for (unsigned i = 0; i < corridor.Size(); ++i)
+    {
+        const dtMeshTile* tile = 0;
+        const dtPoly* poly = 0;
+        if (dtStatusFailed(navMesh->getTileAndPolyByRef(corridor[i], &tile, &poly)))
+            continue;
+
+        const IntVector2 tileIdx(tile->header->x, tile->header->y);
+        if (!dest.Contains(tileIdx))
+            dest.Push(tileIdx);
+    }
+}
@@ -0,0 +1,122 @@
+//
+// Created by AICDG on 2017/10/10.
+//
+
+#ifndef URHO3DSAMPLES_PATHCACHE_H
+#define URHO3DSAMPLES_PATHCACHE_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+
+using namespace Urho3D;
+
+/// Path cache key. Queries starting and ending on the same navigation mesh polygons with the same filter share one polygon
+/// corridor.
+struct PathCacheKey
+{
+    /// Construct undefined.
+    PathCacheKey() :
+        startRef_(0),
+        endRef_(0),
+        filter_(0)
+    {
+    }
+
+    /// Construct with polygons and filter.
+    PathCacheKey(dtPolyRef startRef, dtPolyRef endRef, const dtQueryFilter* filter) :
+        startRef_(startRef),
+        endRef_(endRef),
+        filter_(filter)
+    {
+    }
+
+    /// Test for equality with another key.
+    bool operator ==(const PathCacheKey& rhs) const
+    {
+        return startRef_ == rhs.startRef_ && endRef_ == rhs.endRef_ && filter_ == rhs.filter_;
+    }
+
+    /// Return hash value for HashMap.
+    unsigned ToHash() const
+    {
+        unsigned hash = (unsigned)startRef_;
+        hash = hash * 31 + (unsigned)endRef_;
+        hash = hash * 31 + (unsigned)(size_t)filter_;
+        return hash;
+    }
+
+    /// Start polygon.
+    dtPolyRef startRef_;
+    /// End polygon.
+    dtPolyRef endRef_;
+    /// Query filter.
+    const dtQueryFilter* filter_;
+};
+
+/// Cache of polygon corridors found by Detour path searches. The corridor between two polygons does not depend on the exact
+/// points inside them, so a hit only needs the straight path corners found again for the actual end points. Every entry
+/// remembers the navigation mesh tiles its corridor crosses, so that rebuilding, adding or removing a tile evicts only the
+/// corridors through it. Thread-safe: looked up from the path query worker.
+class PathCache
+{
+public:
+    /// Construct.
+    PathCache();
+
+    /// Look up a corridor. On hit, copy the corridor polygons to dest.
+    bool Lookup(const PathCacheKey& key, PODVector<dtPolyRef>& dest);
+    /// Store a complete corridor from the start to the end polygon of the key. Evict the least recently used entry if the cache
+    /// is full.
+    void Insert(const PathCacheKey& key, const PODVector<dtPolyRef>& corridor, const dtNavMesh* navMesh);
+    /// Evict the corridors crossing the tiles in the inclusive tile range.
+    void InvalidateTiles(const IntVector2& from, const IntVector2& to);
+    /// Evict all corridors.
+    void Clear();
+    /// Set maximum number of cached corridors. Evict the least recently used entries if there are more.
+    void SetMaxEntries(unsigned maxEntries);
+
+    /// Collect the navigation mesh tiles crossed by a path.
+    static void GetPathTiles(const PODVector<Vector3>& path, NavigationMesh* navMesh, PODVector<IntVector2>& dest);
+    /// Collect the navigation mesh tiles of the polygons in a corridor.
+    static void GetCorridorTiles(const PODVector<dtPolyRef>& corridor, const dtNavMesh* navMesh, PODVector<IntVector2>& dest);
+
+    /// Return maximum number of cached corridors.
+    unsigned GetMaxEntries() const { return maxEntries_; }
+    /// Return number of cached corridors.
+    unsigned GetNumEntries() const;
+    /// Return number of lookups answered from the cache.
+    unsigned GetNumHits() const { return numHits_; }
+    /// Return number of lookups not answered from the cache.
+    unsigned GetNumMisses() const { return numMisses_; }
+
+private:
+    /// Cached corridor.
+    struct Entry
+    {
+        /// Corridor polygons from the start to the end polygon.
+        PODVector<dtPolyRef> corridor_;
+        /// Tiles crossed by the corridor.
+        PODVector<IntVector2> tiles_;
+        /// Use stamp for least recently used eviction.
+        unsigned lastUse_;
+    };
+
+    /// Evict the least recently used entry. Called with the mutex locked.
+    void EvictOldest();
+
+    /// Cached corridors.
+    HashMap<PathCacheKey, Entry> entries_;
+    /// Mutex for accessing the entries.
+    mutable Mutex mutex_;
+    /// Use stamp counter.
+    unsigned useCounter_;
+    /// Maximum number of cached corridors.
+    unsigned maxEntries_;
+    /// Number of hits.
+    unsigned numHits_;
+    /// Number of misses.
+    unsigned numMisses_;
+};
+
+#endif //URHO3DSAMPLES_PATHCACHE_H
@@ -0,0 +1,173 @@
+//
+// Created by AICDG on 2017/10/18.
+//
+
+#include <Urho3D/Scene/Node.h>
+
+#include "PathFollowerSystem.h"
+
+/// Distance at which a waypoint counts as reached.
+static const float WAYPOINT_RADIUS = 0.1f;
+/// Waypoint buffer size below which passed waypoints are not compacted away.
+static const unsigned MIN_COMPACT_SIZE = 1024;
+
+PathFollowerSystem::PathFollowerSystem() :
+    numLiveWaypoints_(0)
+{
+}
+
+unsigned PathFollowerSystem::AddFollower(Node* node, float speed)
+{
+    nodes_.Push(WeakPtr<Node>(node));
+    positions_.Push(node->GetWorldPosition());
+    headings_.Push(node->GetWorldDirection());
+    speeds_.Push(speed);
+    pathCursors_.Push(waypoints_.Size());
+    pathEnds_.Push(waypoints_.Size());
+    moved_.Push(0);
+    return nodes_.Size() - 1;
+}
+
+void PathFollowerSystem::RemoveFollower(unsigned index)
+{
+    ClearPath(index);
+
+    // Move the last follower into the gap so that the arrays stay contiguous
+    const unsigned last = nodes_.Size() - 1;
+    nodes_[index] = nodes_[last];
+    positions_[index] = positions_[last];
+    headings_[index] = headings_[last];
+    speeds_[index] = speeds_[last];
+    pathCursors_[index] = pathCursors_[last];
+    pathEnds_[index] = pathEnds_[last];
+    moved_[index] = moved_[last];
+
+    nodes_.Pop();
+    positions_.Pop();
+    headings_.Pop();
+    speeds_.Pop();
+    pathCursors_.Pop();
+    pathEnds_.Pop();
+    moved_.Pop();
+}
+
+void PathFollowerSystem::Clear()
+{
+    nodes_.Clear();
+    positions_.Clear();
+    headings_.Clear();
+    speeds_.Clear();
+    pathCursors_.Clear();
+    pathEnds_.Clear();
+    moved_.Clear();
+    waypoints_.Clear();
+    numLiveWaypoints_ = 0;
+}
+
+void PathFollowerSystem::SetPath(unsigned index, const PODVector<Vector3>& path)
+{
+    ClearPath(index);
+
+    // The replaced path stays in the buffer as garbage until enough of it has piled up
+    if (waypoints_.Size() >= MIN_COMPACT_SIZE && waypoints_.Size() > 2 * numLiveWaypoints_)
+        CompactWaypoints();
+
+    pathCursors_[index] = waypoints_.Size();
+    waypoints_.Push(path);
+    pathEnds_[index] = waypoints_.Size();
+    numLiveWaypoints_ += path.Size();
+}
+
+void PathFollowerSystem::ClearPath(unsigned index)
+{
+    numLiveWaypoints_ -= pathEnds_[index] - pathCursors_[index];
+    pathCursors_[index] = pathEnds_[index];
+}
+
+void PathFollowerSystem::SetSpeed(unsigned index, float speed)
+{
+    speeds_[index] = speed;
+}
+
+void PathFollowerSystem::SyncFromNode(unsigned index)
+{
+    if (nodes_[index])
+    {
+        positions_[index] = nodes_[index]->GetWorldPosition();
+        headings_[index] = nodes_[index]->GetWorldDirection();
+    }
+}
+
+void PathFollowerSystem::Update(float timeStep)
+{
+    const unsigned numFollowers = nodes_.Size();
+    Vector3* positions = positions_.Buffer();
+    Vector3* headings = headings_.Buffer();
+    const float* speeds = speeds_.Buffer();
+    unsigned* pathCursors = pathCursors_.Buffer();
+    const unsigned* pathEnds = pathEnds_.Buffer();
+    unsigned char* moved = moved_.Buffer();
+    const Vector3* waypoints = waypoints_.Buffer();
+
+    // Advance all followers in one pass over the arrays. Reaching a waypoint only moves the cursor
+    unsigned numReached = 0;
+    for (unsigned i = 0; i < numFollowers; ++i)
+    {
+        moved[i] = 0;
+        if (pathCursors[i] >= pathEnds[i])
+            continue;
+
+        // Head toward the next waypoint and move. Check for not overshooting it
+        const Vector3 delta = waypoints[pathCursors[i]] - positions[i];
+        const float distance = delta.Length();
+        if (distance > M_EPSILON)
+        {
+            headings[i] = delta / distance;
+            positions[i] += headings[i] * Min(speeds[i] * timeStep, distance);
+            moved[i] = 1;
+        }
+
+        // Pass the waypoint if reached it
+        if (distance < WAYPOINT_RADIUS)
+        {
+            ++pathCursors[i];
+            ++numReached;
+        }
+    }
+    numLiveWaypoints_ -= numReached;
+
+    // Write the transforms back to the nodes of the moved followers
+    for (unsigned i = 0; i < numFollowers; ++i)
+    {
+        Node* node = nodes_[i];
+        if (!moved[i] || !node)
+            continue;
+
+        Quaternion rotation;
+        if (rotation.FromLookRotation(headings[i], Vector3::UP))
+            node->SetWorldTransform(positions[i], rotation);
+        else
+            node->SetWorldPosition(positions[i]);
+    }
+}
+
+void PathFollowerSystem::GetPath(unsigned index, PODVector<Vector3>& dest) const
+{
+    dest.Clear();
+    if (HasPath(index))
+        dest.Insert(dest.End(), waypoints_.Begin() + pathCursors_[index], waypoints_.Begin() + pathEnds_[index]);
+}
+
+void PathFollowerSystem::CompactWaypoints()
+{
+    PODVector<Vector3> waypoints;
+    waypoints.Reserve(numLiveWaypoints_);
+    for (unsigned i = 0; i < nodes_.Size(); ++i)
+    {
+        const unsigned cursor = waypoints.Size();
+        waypoints.Insert(waypoints.End(), waypoints_.Begin() + pathCursors_[i], waypoints_.Begin() + pathEnds_[i]);
+        pathCursors_[i] = cursor;
+        pathEnds_[i] = waypoints.Size();
+    }
+    waypoints_.Swap(waypoints);
+}
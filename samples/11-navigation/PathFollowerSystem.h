@@ -0,0 +1,86 @@
+//
+// Created by AICDG on 2017/10/18.
+//
+
+#ifndef URHO3DSAMPLES_PATHFOLLOWERSYSTEM_H
+#define URHO3DSAMPLES_PATHFOLLOWERSYSTEM_H
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+
+class Node;
+
+}
+
+using namespace Urho3D;
+
+/// Moves many scene nodes along precalculated paths. The paths of all followers are kept in one shared waypoint buffer with a
+/// cursor per follower, and positions, headings and speeds in one array each, so that all followers advance in a single pass
+/// over contiguous data. The transforms are written back to the nodes afterwards, once per moved follower.
+class PathFollowerSystem
+{
+public:
+    /// Construct.
+    PathFollowerSystem();
+
+    /// Add a follower for a node, starting from the node's position. Return the follower index.
+    unsigned AddFollower(Node* node, float speed);
+    /// Remove a follower. The last follower takes its index.
+    void RemoveFollower(unsigned index);
+    /// Remove all followers.
+    void Clear();
+
+    /// Set the path of a follower. The first waypoint is the next one to reach.
+    void SetPath(unsigned index, const PODVector<Vector3>& path);
+    /// Stop a follower.
+    void ClearPath(unsigned index);
+    /// Set the speed of a follower.
+    void SetSpeed(unsigned index, float speed);
+    /// Read the position of a follower back from its node, after the node has been moved directly.
+    void SyncFromNode(unsigned index);
+
+    /// Advance all followers along their paths and write the transforms of the moved ones to their nodes.
+    void Update(float timeStep);
+
+    /// Return number of followers.
+    unsigned GetNumFollowers() const { return nodes_.Size(); }
+    /// Return whether a follower has waypoints left.
+    bool HasPath(unsigned index) const { return pathCursors_[index] < pathEnds_[index]; }
+    /// Return number of waypoints a follower has left.
+    unsigned GetNumWaypoints(unsigned index) const { return pathEnds_[index] - pathCursors_[index]; }
+    /// Return the next waypoint of a follower, followed by the rest of its path. Valid until the paths are next changed.
+    const Vector3* GetWaypoints(unsigned index) const { return waypoints_.Buffer() + pathCursors_[index]; }
+    /// Copy the waypoints a follower has left.
+    void GetPath(unsigned index, PODVector<Vector3>& dest) const;
+    /// Return the position of a follower.
+    const Vector3& GetPosition(unsigned index) const { return positions_[index]; }
+
+private:
+    /// Copy the remaining paths to the front of the waypoint buffer, dropping the passed and replaced waypoints.
+    void CompactWaypoints();
+
+    /// Follower nodes.
+    Vector<WeakPtr<Node> > nodes_;
+    /// Follower positions.
+    PODVector<Vector3> positions_;
+    /// Follower headings as unit vectors.
+    PODVector<Vector3> headings_;
+    /// Follower speeds in units per second.
+    PODVector<float> speeds_;
+    /// Index of each follower's next waypoint in the waypoint buffer.
+    PODVector<unsigned> pathCursors_;
+    /// Index after each follower's last waypoint in the waypoint buffer.
+    PODVector<unsigned> pathEnds_;
+    /// Whether each follower moved in the current update.
+    PODVector<unsigned char> moved_;
+    /// Waypoints of all paths.
+    PODVector<Vector3> waypoints_;
+    /// Number of waypoints in the buffer that are still ahead of their follower.
+    unsigned numLiveWaypoints_;
+};
+
+#endif //URHO3DSAMPLES_PATHFOLLOWERSYSTEM_H
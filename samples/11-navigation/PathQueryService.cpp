@@ -0,0 +1,323 @@
+//
+// Created by AICDG on 2017/10/9.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Navigation/NavigationEvents.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include <Detour/DetourNavMeshQuery.h>
+
+#include "PathQueryService.h"
+
+/// Work item priority of path query batches. Kept low so that the renderer's work queue completion does not wait for them, but
+/// above background tile decoding so that waiting for a batch does not wait for the decoding.
+static const unsigned PATH_QUERY_PRIORITY = 1;
+static const unsigned DEFAULT_MAX_BATCH_SIZE = 64;
+/// Maximum number of polygons in a corridor, and of search nodes. Same as NavigationMesh uses for FindPath().
+static const int MAX_POLYS = 2048;
+
+/// Access to the Detour objects that NavigationMesh keeps protected. Only used to form member pointers, never instantiated.
+class NavigationMeshDetourAccess : public NavigationMesh
+{
+public:
+    /// Return the Detour navigation mesh.
+    static dtNavMesh* GetNavMesh(NavigationMesh* navMesh) { return navMesh->*&NavigationMeshDetourAccess::navMesh_; }
+    /// Return the default query filter.
+    static const dtQueryFilter* GetQueryFilter(NavigationMesh* navMesh)
+    {
+        return &*(navMesh->*&NavigationMeshDetourAccess::queryFilter_);
+    }
+};
+
+PathQueryService::PathQueryService(Context* context) :
+    Component(context),
+    defaultFilter_(0),
+    navMeshQuery_(0),
+    queryNavMesh_(0),
+    nextQueryID_(1),
+    maxBatchSize_(DEFAULT_MAX_BATCH_SIZE)
+{
+}
+
+PathQueryService::~PathQueryService()
+{
+    WaitForCompletion();
+    dtFreeNavMeshQuery(navMeshQuery_);
+}
+
+void PathQueryService::RegisterObject(Context* context)
+{
+    context->RegisterFactory<PathQueryService>();
+
+    URHO3D_ACCESSOR_ATTRIBUTE("Max Batch Size", GetMaxBatchSize, SetMaxBatchSize, unsigned, DEFAULT_MAX_BATCH_SIZE, AM_DEFAULT);
+}
+
+unsigned PathQueryService::SubmitQuery(unsigned requester, const Vector3& start, const Vector3& end, const Vector3& extents,
+    const dtQueryFilter* filter)
+{
+    // A newer query from the same requester makes the in-flight one obsolete
+    for (unsigned i = 0; i < inFlightQueries_.Size(); ++i)
+    {
+        if (inFlightQueries_[i].requester_ == requester)
+            inFlightQueries_[i].superseded_ = true;
+    }
+
+    PathQuery* query = 0;
+    for (unsigned i = 0; i < pendingQueries_.Size(); ++i)
+    {
+        if (pendingQueries_[i].requester_ == requester)
+        {
+            query = &pendingQueries_[i];
+            break;
+        }
+    }
+    if (!query)
+    {
+        pendingQueries_.Resize(pendingQueries_.Size() + 1);
+        query = &pendingQueries_.Back();
+    }
+
+    query->id_ = nextQueryID_++;
+    query->requester_ = requester;
+    query->start_ = start;
+    query->end_ = end;
+    query->extents_ = extents;
+    query->filter_ = filter;
+    query->path_.Clear();
+    query->superseded_ = false;
+
+    return query->id_;
+}
+
+void PathQueryService::CancelQuery(unsigned requester)
+{
+    for (unsigned i = 0; i < inFlightQueries_.Size(); ++i)
+    {
+        if (inFlightQueries_[i].requester_ == requester)
+            inFlightQueries_[i].superseded_ = true;
+    }
+
+    for (Vector<PathQuery>::Iterator i = pendingQueries_.Begin(); i != pendingQueries_.End();)
+    {
+        if (i->requester_ == requester)
+            i = pendingQueries_.Erase(i);
+        else
+            ++i;
+    }
+}
+
+void PathQueryService::WaitForCompletion()
+{
+    if (!workItem_ || workItem_->completed_)
+        return;
+
+    // Let the main thread help with the queued work until the batch is done
+    GetSubsystem<WorkQueue>()->Complete(PATH_QUERY_PRIORITY);
+}
+
+void PathQueryService::SetMaxBatchSize(unsigned size)
+{
+    maxBatchSize_ = Max(size, 1U);
+}
+
+void PathQueryService::OnSceneSet(Scene* scene)
+{
+    if (scene)
+    {
+        SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(PathQueryService, HandleUpdate));
+        SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(PathQueryService, HandlePostUpdate));
+        SubscribeToEvent(E_NAVIGATION_MESH_REBUILT, URHO3D_HANDLER(PathQueryService, HandleNavigationMeshRebuilt));
+        SubscribeToEvent(E_NAVIGATION_ALL_TILES_REMOVED, URHO3D_HANDLER(PathQueryService, HandleNavigationMeshRebuilt));
+        SubscribeToEvent(E_NAVIGATION_AREA_REBUILT, URHO3D_HANDLER(PathQueryService, HandleNavigationAreaRebuilt));
+        SubscribeToEvent(E_NAVIGATION_TILE_ADDED, URHO3D_HANDLER(PathQueryService, HandleNavigationTileChanged));
+        SubscribeToEvent(E_NAVIGATION_TILE_REMOVED, URHO3D_HANDLER(PathQueryService, HandleNavigationTileChanged));
+    }
+    else
+    {
+        WaitForCompletion();
+        UnsubscribeFromAllEvents();
+        pathCache_.Clear();
+    }
+}
+
+void PathQueryService::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // Do not block on an unfinished batch, it will be delivered on a later frame
+    if (workItem_ && workItem_->completed_ && !inFlightQueries_.Empty())
+        DeliverBatch();
+}
+
+void PathQueryService::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // Start the batch after the frame's update logic, so that the worker runs while the frame is rendered
+    if (inFlightQueries_.Empty() && !pendingQueries_.Empty())
+        StartBatch();
+}
+
+void PathQueryService::StartBatch()
+{
+    Scene* scene = GetScene();
+    NavigationMesh* navMesh = scene ? scene->GetComponent<NavigationMesh>() : 0;
+    dtNavMesh* detourNavMesh = navMesh ? NavigationMeshDetourAccess::GetNavMesh(navMesh) : 0;
+    if (!detourNavMesh)
+        return;
+
+    // A rebuild replaces the Detour navigation mesh, and the query must follow it
+    if (!navMeshQuery_)
+        navMeshQuery_ = dtAllocNavMeshQuery();
+    if (detourNavMesh != queryNavMesh_)
+    {
+        if (dtStatusFailed(navMeshQuery_->init(detourNavMesh, MAX_POLYS)))
+            return;
+        queryNavMesh_ = detourNavMesh;
+    }
+
+    unsigned batchSize = Min(pendingQueries_.Size(), maxBatchSize_);
+    for (unsigned i = 0; i < batchSize; ++i)
+        inFlightQueries_.Push(pendingQueries_[i]);
+    pendingQueries_.Erase(0, batchSize);
+    navMesh_ = navMesh;
+    navMeshTransform_ = navMesh->GetNode()->GetWorldTransform();
+    defaultFilter_ = NavigationMeshDetourAccess::GetQueryFilter(navMesh);
+
+    // Not taken from the work queue's pool: pooled items are reset when purged at the start of the next frame, and the
+    // completion of the batch is polled after that
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    workItem_ = new WorkItem();
+    workItem_->priority_ = PATH_QUERY_PRIORITY;
+    workItem_->workFunction_ = ProcessBatch;
+    workItem_->start_ = &inFlightQueries_.Front();
+    workItem_->end_ = &inFlightQueries_.Front() + inFlightQueries_.Size();
+    workItem_->aux_ = this;
+    queue->AddWorkItem(workItem_);
+}
+
+void PathQueryService::DeliverBatch()
+{
+    // Move the results out first, so that event handlers may submit new queries
+    Vector<PathQuery> finishedQueries;
+    finishedQueries.Swap(inFlightQueries_);
+    workItem_.Reset();
+
+    // Results computed against a navigation mesh that no longer exists are meaningless
+    if (!navMesh_)
+        return;
+
+    using namespace PathQueryCompleted;
+
+    for (unsigned i = 0; i < finishedQueries.Size(); ++i)
+    {
+        const PathQuery& query = finishedQueries[i];
+        if (query.superseded_)
+            continue;
+
+        VariantMap& eventData = GetEventDataMap();
+        eventData[P_REQUESTER] = query.requester_;
+        eventData[P_QUERYID] = query.id_;
+        eventData[P_ENDPOS] = query.end_;
+        eventData[P_PATH] = (void*)&query.path_;
+        SendEvent(E_PATHQUERYCOMPLETED, eventData);
+    }
+}
+
+void PathQueryService::HandleNavigationMeshRebuilt(StringHash eventType, VariantMap& eventData)
+{
+    if (IsOwnNavigationMesh(eventData))
+    {
+        pathCache_.Clear();
+        queryNavMesh_ = 0;
+    }
+}
+
+void PathQueryService::HandleNavigationAreaRebuilt(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NavigationAreaRebuilt;
+
+    if (!IsOwnNavigationMesh(eventData))
+        return;
+
+    NavigationMesh* navMesh = static_cast<NavigationMesh*>(eventData[P_MESH].GetPtr());
+    pathCache_.InvalidateTiles(navMesh->GetTileIndex(eventData[P_BOUNDSMIN].GetVector3()),
+        navMesh->GetTileIndex(eventData[P_BOUNDSMAX].GetVector3()));
+}
+
+void PathQueryService::HandleNavigationTileChanged(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NavigationTileAdded;
+
+    if (!IsOwnNavigationMesh(eventData))
+        return;
+
+    const IntVector2 tile = eventData[P_TILE].GetIntVector2();
+    pathCache_.InvalidateTiles(tile, tile);
+}
+
+bool PathQueryService::IsOwnNavigationMesh(VariantMap& eventData) const
+{
+    using namespace NavigationMeshRebuilt;
+
+    Scene* scene = GetScene();
+    return scene && eventData[P_MESH].GetPtr() == scene->GetComponent<NavigationMesh>();
+}
+
+void PathQueryService::ProcessBatch(const WorkItem* item, unsigned threadIndex)
+{
+    // The service's Detour query is only used by one worker at a time, so a batch is processed serially while the main thread
+    // keeps running
+    PathQueryService* service = static_cast<PathQueryService*>(item->aux_);
+    dtNavMeshQuery* navMeshQuery = service->navMeshQuery_;
+    const Matrix3x4& transform = service->navMeshTransform_;
+    const Matrix3x4 inverse = transform.Inverse();
+    PathQuery* start = reinterpret_cast<PathQuery*>(item->start_);
+    PathQuery* end = reinterpret_cast<PathQuery*>(item->end_);
+
+    PODVector<dtPolyRef> corridor;
+    PODVector<Vector3> corners(MAX_POLYS);
+
+    for (PathQuery* query = start; query != end; ++query)
+    {
+        query->path_.Clear();
+
+        const dtQueryFilter* filter = query->filter_ ? query->filter_ : service->defaultFilter_;
+        const Vector3 localStart = inverse * query->start_;
+        const Vector3 localEnd = inverse * query->end_;
+        dtPolyRef startRef = 0;
+        dtPolyRef endRef = 0;
+        Vector3 startPos;
+        Vector3 endPos;
+        navMeshQuery->findNearestPoly(&localStart.x_, &query->extents_.x_, filter, &startRef, &startPos.x_);
+        navMeshQuery->findNearestPoly(&localEnd.x_, &query->extents_.x_, filter, &endRef, &endPos.x_);
+        if (!startRef || !endRef)
+            continue;
+
+        // Agents travelling between the same polygons share the corridor, only the corners differ with the end points
+        const PathCacheKey key(startRef, endRef, query->filter_);
+        if (!service->pathCache_.Lookup(key, corridor))
+        {
+            corridor.Resize(MAX_POLYS);
+            int numPolys = 0;
+            const dtStatus status = navMeshQuery->findPath(startRef, endRef, &startPos.x_, &endPos.x_, filter, &corridor[0],
+                &numPolys, MAX_POLYS);
+            corridor.Resize((unsigned)numPolys);
+            if (dtStatusFailed(status) || corridor.Empty())
+                continue;
+
+            // A partial corridor stops short of the end polygon, so it does not answer later queries to the same polygon
+            if (!dtStatusDetail(status, DT_PARTIAL_RESULT))
+                service->pathCache_.Insert(key, corridor, service->queryNavMesh_);
+        }
+
+        // Detour clamps the end point onto the last corridor polygon, so a partial path ends where it can actually be reached
+        int numCorners = 0;
+        navMeshQuery->findStraightPath(&startPos.x_, &endPos.x_, &corridor[0], (int)corridor.Size(), &corners[0].x_, 0, 0,
+            &numCorners, MAX_POLYS);
+        for (int i = 0; i < numCorners; ++i)
+            query->path_.Push(transform * corners[i]);
+
+        if (query->path_.Size())
+            query->end_ = query->path_.Back();
+    }
+}
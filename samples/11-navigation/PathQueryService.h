@@ -0,0 +1,127 @@
+//
+// Created by AICDG on 2017/10/9.
+//
+
+#ifndef URHO3DSAMPLES_PATHQUERYSERVICE_H
+#define URHO3DSAMPLES_PATHQUERYSERVICE_H
+
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Scene/Component.h>
+
+#include "PathCache.h"
+
+using namespace Urho3D;
+
+/// Path query finished on a worker thread. Sent by PathQueryService on the frame update following the completion.
+URHO3D_EVENT(E_PATHQUERYCOMPLETED, PathQueryCompleted)
+{
+    URHO3D_PARAM(P_REQUESTER, Requester);          // unsigned
+    URHO3D_PARAM(P_QUERYID, QueryID);              // unsigned
+    URHO3D_PARAM(P_ENDPOS, EndPos);                // Vector3, end position snapped to the navigation mesh
+    URHO3D_PARAM(P_PATH, Path);                    // void pointer to const PODVector<Vector3>, valid during the event only
+}
+
+/// Queued path query.
+struct PathQuery
+{
+    /// Query ID.
+    unsigned id_;
+    /// Requester ID, eg. a node ID. At most one query per requester is kept, newer queries supersede older ones.
+    unsigned requester_;
+    /// Start position.
+    Vector3 start_;
+    /// End position. Snapped to the navigation mesh by the worker.
+    Vector3 end_;
+    /// Search extents for the nearest navigation mesh point.
+    Vector3 extents_;
+    /// Detour query filter, or null for the navigation mesh default.
+    const dtQueryFilter* filter_;
+    /// Result path.
+    PODVector<Vector3> path_;
+    /// Superseded or cancelled flag. Superseded queries are not delivered. Only the main thread reads or writes it, also while the
+    /// query is in flight.
+    bool superseded_;
+};
+
+/// Asynchronous path query service. Runs Detour path queries on a worker thread and delivers the results on the main thread.
+class PathQueryService : public Component
+{
+    URHO3D_OBJECT(PathQueryService, Component);
+
+public:
+    /// Construct.
+    PathQueryService(Context* context);
+    /// Destruct. Wait for the in-flight batch.
+    virtual ~PathQueryService();
+    /// Register object factory and attributes.
+    static void RegisterObject(Context* context);
+
+    /// Submit a path query. Replaces the pending query of the same requester and discards its in-flight result. Return query ID.
+    unsigned SubmitQuery(unsigned requester, const Vector3& start, const Vector3& end, const Vector3& extents = Vector3::ONE,
+        const dtQueryFilter* filter = 0);
+    /// Cancel the pending and in-flight queries of a requester.
+    void CancelQuery(unsigned requester);
+    /// Block until the in-flight batch is finished. Must be called before modifying or querying the navigation mesh on the main thread.
+    void WaitForCompletion();
+    /// Set maximum number of queries handed to the worker in one batch.
+    void SetMaxBatchSize(unsigned size);
+
+    /// Return maximum number of queries in one batch.
+    unsigned GetMaxBatchSize() const { return maxBatchSize_; }
+    /// Return number of queries waiting for a worker.
+    unsigned GetNumPendingQueries() const { return pendingQueries_.Size(); }
+    /// Return whether a batch is being processed by the worker.
+    bool IsBusy() const { return workItem_ && !inFlightQueries_.Empty(); }
+    /// Return the path cache.
+    PathCache& GetPathCache() { return pathCache_; }
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Handle the frame update. Deliver the finished batch.
+    void HandleUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle the frame post-update. Hand the pending queries to the worker.
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Start a new batch from the pending queries.
+    void StartBatch();
+    /// Send completion events for the finished batch.
+    void DeliverBatch();
+    /// Handle a full navigation mesh rebuild or all tiles being removed. Evict all cached paths.
+    void HandleNavigationMeshRebuilt(StringHash eventType, VariantMap& eventData);
+    /// Handle a partial navigation mesh rebuild. Evict the cached paths crossing the rebuilt area.
+    void HandleNavigationAreaRebuilt(StringHash eventType, VariantMap& eventData);
+    /// Handle a navigation mesh tile being added or removed. Evict the cached paths crossing the tile.
+    void HandleNavigationTileChanged(StringHash eventType, VariantMap& eventData);
+    /// Return whether the navigation event concerns this scene's navigation mesh.
+    bool IsOwnNavigationMesh(VariantMap& eventData) const;
+    /// Worker function: run the queries of a batch.
+    static void ProcessBatch(const WorkItem* item, unsigned threadIndex);
+
+    /// Queries waiting for a worker.
+    Vector<PathQuery> pendingQueries_;
+    /// Queries being processed by the worker. Until the work item completes the main thread only sets their superseded flags,
+    /// which the worker never reads, and does not add or remove queries.
+    Vector<PathQuery> inFlightQueries_;
+    /// Work item of the in-flight batch.
+    SharedPtr<WorkItem> workItem_;
+    /// Navigation mesh used by the in-flight batch.
+    WeakPtr<NavigationMesh> navMesh_;
+    /// World transform of the navigation mesh used by the in-flight batch.
+    Matrix3x4 navMeshTransform_;
+    /// Default query filter of the navigation mesh used by the in-flight batch.
+    const dtQueryFilter* defaultFilter_;
+    /// Detour query owned by the worker, so that it does not share the navigation mesh's query with the main thread.
+    dtNavMeshQuery* navMeshQuery_;
+    /// Detour navigation mesh the query was initialized for.
+    dtNavMesh* queryNavMesh_;
+    /// Cache of calculated paths, shared by all requesters.
+    PathCache pathCache_;
+    /// Next query ID.
+    unsigned nextQueryID_;
+    /// Maximum number of queries in one batch.
+    unsigned maxBatchSize_;
+};
+
+#endif //URHO3DSAMPLES_PATHQUERYSERVICE_H
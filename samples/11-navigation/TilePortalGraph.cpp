@@ -0,0 +1,425 @@
+//
+// Created by AICDG on 2017/10/16.
+//
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+#include <Urho3D/Scene/Node.h>
+
+#include <Detour/DetourCommon.h>
+#include <Detour/DetourNavMesh.h>
+
+#include "TilePortalGraph.h"
+
+/// Size of the prefix NavigationMesh::GetTileData() writes before the Detour tile data: tile index, tile reference and size.
+static const unsigned TILE_DATA_PREFIX_SIZE = 4 * sizeof(unsigned);
+/// Gap along a border below which adjacent portal edges are merged into one portal.
+static const float PORTAL_MERGE_TOLERANCE = 0.01f;
+/// Tile offsets of the neighbors across the border sides 0, 2, 4 and 6.
+static const IntVector2 SIDE_OFFSETS[] = { IntVector2(1, 0), IntVector2(0, 1), IntVector2(-1, 0), IntVector2(0, -1) };
+
+/// Portal edge of one polygon, before merging.
+struct PortalEdge
+{
+    /// Start along the border.
+    float min_;
+    /// End along the border.
+    float max_;
+    /// Position across the border.
+    float border_;
+    /// Average height.
+    float height_;
+    /// Connected polygon component.
+    unsigned component_;
+    /// Border side.
+    unsigned char side_;
+};
+
+/// Portal of a tile in the route search.
+struct PortalKey
+{
+    PortalKey() :
+        index_(0)
+    {
+    }
+
+    PortalKey(const IntVector2& tile, unsigned index) :
+        tile_(tile),
+        index_(index)
+    {
+    }
+
+    /// Test for equality.
+    bool operator ==(const PortalKey& rhs) const { return tile_ == rhs.tile_ && index_ == rhs.index_; }
+    /// Return hash value for HashMap.
+    unsigned ToHash() const { return tile_.ToHash() * 31 + index_; }
+
+    /// Tile index.
+    IntVector2 tile_;
+    /// Portal index in the tile.
+    unsigned index_;
+};
+
+/// Route search state of a portal.
+struct SearchNode
+{
+    /// Cost from the start.
+    float cost_;
+    /// Cost from the start plus the straight line distance to the end.
+    float estimate_;
+    /// Previous portal on the route.
+    PortalKey parent_;
+    /// Whether the portal follows another portal, rather than the start.
+    bool hasParent_;
+    /// Whether the portal has been expanded.
+    bool closed_;
+};
+
+static bool ComparePortalEdges(const PortalEdge& lhs, const PortalEdge& rhs)
+{
+    if (lhs.side_ != rhs.side_)
+        return lhs.side_ < rhs.side_;
+    if (lhs.component_ != rhs.component_)
+        return lhs.component_ < rhs.component_;
+    return lhs.min_ < rhs.min_;
+}
+
+static unsigned FindRoot(PODVector<unsigned>& parents, unsigned index)
+{
+    while (parents[index] != index)
+    {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+static void RelaxPortal(HashMap<PortalKey, SearchNode>& nodes, PODVector<PortalKey>& open, const PortalKey& key,
+    const PortalKey* parent, float cost, const Vector3& position, const Vector3& end)
+{
+    HashMap<PortalKey, SearchNode>::Iterator i = nodes.Find(key);
+    if (i != nodes.End() && (i->second_.closed_ || i->second_.cost_ <= cost))
+        return;
+    if (i == nodes.End())
+    {
+        i = nodes.Insert(MakePair(key, SearchNode()));
+        i->second_.closed_ = false;
+        open.Push(key);
+    }
+
+    SearchNode& node = i->second_;
+    node.cost_ = cost;
+    node.estimate_ = cost + (end - position).Length();
+    node.hasParent_ = parent != 0;
+    if (parent)
+        node.parent_ = *parent;
+}
+
+TilePortalGraph::TilePortalGraph() :
+    origin_(Vector3::ZERO),
+    tileEdgeLength_(0.0f),
+    portalHeightTolerance_(0.0f)
+{
+}
+
+void TilePortalGraph::Build(NavigationMesh* navMesh)
+{
+    Clear();
+
+    transform_ = navMesh->GetNode()->GetWorldTransform();
+    inverseTransform_ = transform_.Inverse();
+    origin_ = navMesh->GetBoundingBox().min_;
+    tileEdgeLength_ = navMesh->GetTileSize() * navMesh->GetCellSize();
+    portalHeightTolerance_ = navMesh->GetAgentHeight();
+
+    const IntVector2 numTiles = navMesh->GetNumTiles();
+    for (int z = 0; z < numTiles.y_; ++z)
+        for (int x = 0; x < numTiles.x_; ++x)
+        {
+            const IntVector2 tileIdx(x, z);
+            UpdateTile(tileIdx, navMesh->GetTileData(tileIdx));
+        }
+}
+
+void TilePortalGraph::UpdateTiles(NavigationMesh* navMesh, const PODVector<IntVector2>& tiles)
+{
+    for (unsigned i = 0; i < tiles.Size(); ++i)
+        UpdateTile(tiles[i], navMesh->GetTileData(tiles[i]));
+}
+
+void TilePortalGraph::UpdateTile(const IntVector2& tile, const PODVector<unsigned char>& tileData)
+{
+    tiles_.Erase(tile);
+
+    const unsigned headerSize = (unsigned)dtAlign4(sizeof(dtMeshHeader));
+    if (tileData.Size() < TILE_DATA_PREFIX_SIZE + headerSize)
+        return;
+    const unsigned char* data = &tileData[TILE_DATA_PREFIX_SIZE];
+    const dtMeshHeader* header = reinterpret_cast<const dtMeshHeader*>(data);
+    if (header->magic != DT_NAVMESH_MAGIC || header->version != DT_NAVMESH_VERSION || !header->polyCount)
+        return;
+
+    // Vertices and polygons follow the header, as laid out by dtCreateNavMeshData()
+    const unsigned vertsSize = (unsigned)dtAlign4(sizeof(float) * 3 * header->vertCount);
+    const unsigned polysSize = (unsigned)dtAlign4(sizeof(dtPoly) * header->polyCount);
+    if (tileData.Size() < TILE_DATA_PREFIX_SIZE + headerSize + vertsSize + polysSize)
+        return;
+    const float* verts = reinterpret_cast<const float*>(data + headerSize);
+    const dtPoly* polys = reinterpret_cast<const dtPoly*>(data + headerSize + vertsSize);
+    const unsigned numPolys = (unsigned)header->polyCount;
+
+    // Group the polygons connected inside the tile. Portals of the same group are reachable from each other
+    PODVector<unsigned> parents;
+    parents.Resize(numPolys);
+    for (unsigned i = 0; i < numPolys; ++i)
+        parents[i] = i;
+    for (unsigned i = 0; i < numPolys; ++i)
+    {
+        const dtPoly& poly = polys[i];
+        if (poly.getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+            continue;
+        for (unsigned j = 0; j < poly.vertCount; ++j)
+        {
+            const unsigned short nei = poly.neis[j];
+            if (nei && !(nei & DT_EXT_LINK) && nei - 1U < numPolys)
+                parents[FindRoot(parents, i)] = FindRoot(parents, nei - 1U);
+        }
+    }
+
+    TilePortals& tilePortals = tiles_[tile];
+    tilePortals.polyCenters_.Resize(numPolys);
+    tilePortals.polyComponents_.Resize(numPolys);
+
+    // Collect the polygon edges on the tile borders
+    PODVector<PortalEdge> edges;
+    for (unsigned i = 0; i < numPolys; ++i)
+    {
+        const dtPoly& poly = polys[i];
+        const unsigned component = FindRoot(parents, i);
+        tilePortals.polyComponents_[i] = component;
+
+        Vector3 center = Vector3::ZERO;
+        for (unsigned j = 0; j < poly.vertCount; ++j)
+            center += Vector3(&verts[poly.verts[j] * 3]);
+        tilePortals.polyCenters_[i] = poly.vertCount ? center / (float)poly.vertCount : center;
+
+        if (poly.getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+            continue;
+        for (unsigned j = 0; j < poly.vertCount; ++j)
+        {
+            const unsigned short nei = poly.neis[j];
+            if (!(nei & DT_EXT_LINK))
+                continue;
+
+            // Borders on the X sides run along Z and vice versa
+            const unsigned char side = (unsigned char)(nei & 0xff);
+            const unsigned along = side == 0 || side == 4 ? 2 : 0;
+            const float* va = &verts[poly.verts[j] * 3];
+            const float* vb = &verts[poly.verts[(j + 1) % poly.vertCount] * 3];
+
+            PortalEdge edge;
+            edge.min_ = Min(va[along], vb[along]);
+            edge.max_ = Max(va[along], vb[along]);
+            edge.border_ = va[2 - along];
+            edge.height_ = (va[1] + vb[1]) * 0.5f;
+            edge.component_ = component;
+            edge.side_ = side;
+            edges.Push(edge);
+        }
+    }
+
+    // Merge the adjacent edges of one side and component into portals
+    Sort(edges.Begin(), edges.End(), ComparePortalEdges);
+    for (unsigned i = 0; i < edges.Size();)
+    {
+        PortalEdge merged = edges[i];
+        float heightSum = merged.height_;
+        unsigned j = i + 1;
+        for (; j < edges.Size(); ++j)
+        {
+            const PortalEdge& edge = edges[j];
+            if (edge.side_ != merged.side_ || edge.component_ != merged.component_ ||
+                edge.min_ > merged.max_ + PORTAL_MERGE_TOLERANCE)
+                break;
+            merged.max_ = Max(merged.max_, edge.max_);
+            heightSum += edge.height_;
+        }
+
+        TilePortal portal;
+        const float middle = (merged.min_ + merged.max_) * 0.5f;
+        const float height = heightSum / (float)(j - i);
+        if (merged.side_ == 0 || merged.side_ == 4)
+            portal.position_ = Vector3(merged.border_, height, middle);
+        else
+            portal.position_ = Vector3(middle, height, merged.border_);
+        portal.min_ = merged.min_;
+        portal.max_ = merged.max_;
+        portal.component_ = merged.component_;
+        portal.side_ = merged.side_;
+        tilePortals.portals_.Push(portal);
+
+        i = j;
+    }
+}
+
+void TilePortalGraph::Clear()
+{
+    tiles_.Clear();
+}
+
+bool TilePortalGraph::FindRoute(const Vector3& start, const Vector3& end, PODVector<Vector3>& dest) const
+{
+    dest.Clear();
+    if (tileEdgeLength_ <= 0.0f)
+        return false;
+
+    const Vector3 localStart = inverseTransform_ * start;
+    const Vector3 localEnd = inverseTransform_ * end;
+    const IntVector2 startTile = GetTileIndex(start);
+    const IntVector2 endTile = GetTileIndex(end);
+    unsigned startComponent;
+    unsigned endComponent;
+    if (!GetComponent(startTile, localStart, startComponent) || !GetComponent(endTile, localEnd, endComponent))
+        return false;
+
+    if (startTile == endTile && startComponent == endComponent)
+    {
+        dest.Push(end);
+        return true;
+    }
+
+    // A* over the portals. The start and end connect to the portals of their own polygon group in their tiles
+    HashMap<PortalKey, SearchNode> nodes;
+    PODVector<PortalKey> open;
+    const PODVector<TilePortal>& startPortals = tiles_.Find(startTile)->second_.portals_;
+    for (unsigned i = 0; i < startPortals.Size(); ++i)
+    {
+        if (startPortals[i].component_ == startComponent)
+            RelaxPortal(nodes, open, PortalKey(startTile, i), 0, (startPortals[i].position_ - localStart).Length(),
+                startPortals[i].position_, localEnd);
+    }
+
+    float bestCost = M_INFINITY;
+    PortalKey bestKey;
+    bool found = false;
+    while (!open.Empty())
+    {
+        // Take the open portal with the lowest estimate. The coarse graph is small, so a linear scan will do
+        unsigned bestOpen = 0;
+        for (unsigned i = 1; i < open.Size(); ++i)
+        {
+            if (nodes[open[i]].estimate_ < nodes[open[bestOpen]].estimate_)
+                bestOpen = i;
+        }
+        const PortalKey key = open[bestOpen];
+        open.EraseSwap(bestOpen);
+
+        SearchNode& node = nodes[key];
+        if (node.estimate_ >= bestCost)
+            break;
+        node.closed_ = true;
+        const float cost = node.cost_;
+
+        const TilePortals& tilePortals = tiles_.Find(key.tile_)->second_;
+        const TilePortal& portal = tilePortals.portals_[key.index_];
+        if (key.tile_ == endTile && portal.component_ == endComponent)
+        {
+            const float endCost = cost + (localEnd - portal.position_).Length();
+            if (endCost < bestCost)
+            {
+                bestCost = endCost;
+                bestKey = key;
+                found = true;
+            }
+        }
+
+        // Other portals of the same polygon group in the tile
+        for (unsigned i = 0; i < tilePortals.portals_.Size(); ++i)
+        {
+            const TilePortal& other = tilePortals.portals_[i];
+            if (i != key.index_ && other.component_ == portal.component_)
+                RelaxPortal(nodes, open, PortalKey(key.tile_, i), &key, cost + (other.position_ - portal.position_).Length(),
+                    other.position_, localEnd);
+        }
+
+        // Overlapping portals on the opposite side of the border in the neighbor tile
+        const IntVector2 neighborTile = key.tile_ + SIDE_OFFSETS[(portal.side_ / 2) & 3];
+        HashMap<IntVector2, TilePortals>::ConstIterator neighbor = tiles_.Find(neighborTile);
+        if (neighbor == tiles_.End())
+            continue;
+        const unsigned char oppositeSide = (unsigned char)((portal.side_ + 4) & 7);
+        const PODVector<TilePortal>& neighborPortals = neighbor->second_.portals_;
+        for (unsigned i = 0; i < neighborPortals.Size(); ++i)
+        {
+            const TilePortal& other = neighborPortals[i];
+            if (other.side_ == oppositeSide && other.min_ <= portal.max_ + PORTAL_MERGE_TOLERANCE &&
+                other.max_ >= portal.min_ - PORTAL_MERGE_TOLERANCE &&
+                Abs(other.position_.y_ - portal.position_.y_) <= portalHeightTolerance_)
+                RelaxPortal(nodes, open, PortalKey(neighborTile, i), &key,
+                    cost + (other.position_ - portal.position_).Length(), other.position_, localEnd);
+        }
+    }
+
+    if (!found)
+        return false;
+
+    // Walk back from the last portal. The two portals of a border crossing nearly coincide, keep only one of them
+    PODVector<Vector3> route;
+    PortalKey key = bestKey;
+    for (;;)
+    {
+        const Vector3 position = tiles_.Find(key.tile_)->second_.portals_[key.index_].position_;
+        if (route.Empty() || (route.Back() - position).Length() > tileEdgeLength_ * 0.1f)
+            route.Push(position);
+        const SearchNode& node = nodes[key];
+        if (!node.hasParent_)
+            break;
+        key = node.parent_;
+    }
+
+    for (unsigned i = route.Size(); i-- > 0;)
+        dest.Push(transform_ * route[i]);
+    dest.Push(end);
+    return true;
+}
+
+IntVector2 TilePortalGraph::GetTileIndex(const Vector3& position) const
+{
+    if (tileEdgeLength_ <= 0.0f)
+        return IntVector2::ZERO;
+
+    const Vector3 localPosition = inverseTransform_ * position;
+    return IntVector2((int)floorf((localPosition.x_ - origin_.x_) / tileEdgeLength_),
+        (int)floorf((localPosition.z_ - origin_.z_) / tileEdgeLength_));
+}
+
+unsigned TilePortalGraph::GetNumPortals() const
+{
+    unsigned numPortals = 0;
+    for (HashMap<IntVector2, TilePortals>::ConstIterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+        numPortals += i->second_.portals_.Size();
+    return numPortals;
+}
+
+bool TilePortalGraph::GetComponent(const IntVector2& tile, const Vector3& position, unsigned& component) const
+{
+    HashMap<IntVector2, TilePortals>::ConstIterator i = tiles_.Find(tile);
+    if (i == tiles_.End() || i->second_.polyCenters_.Empty())
+        return false;
+
+    const PODVector<Vector3>& centers = i->second_.polyCenters_;
+    unsigned nearest = 0;
+    float nearestDistance = M_INFINITY;
+    for (unsigned j = 0; j < centers.Size(); ++j)
+    {
+        const float distance = (centers[j] - position).LengthSquared();
+        if (distance < nearestDistance)
+        {
+            nearest = j;
+            nearestDistance = distance;
+        }
+    }
+
+    component = i->second_.polyComponents_[nearest];
+    return true;
+}
@@ -0,0 +1,93 @@
+//
+// Created by AICDG on 2017/10/16.
+//
+
+#ifndef URHO3DSAMPLES_TILEPORTALGRAPH_H
+#define URHO3DSAMPLES_TILEPORTALGRAPH_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Math/Matrix3x4.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+}
+
+using namespace Urho3D;
+
+/// Abstract graph of the portals between navigation mesh tiles, for planning long routes coarsely. The portals are extracted
+/// per tile from the Detour tile data, so the graph stays complete when the navigation mesh is streamed and only a few tiles
+/// are loaded.
+class TilePortalGraph
+{
+public:
+    /// Construct.
+    TilePortalGraph();
+
+    /// Extract the portals of all tiles of a fully built navigation mesh, replacing the previous contents.
+    void Build(NavigationMesh* navMesh);
+    /// Extract the portals of rebuilt tiles again.
+    void UpdateTiles(NavigationMesh* navMesh, const PODVector<IntVector2>& tiles);
+    /// Extract the portals of a tile from its data as returned by NavigationMesh::GetTileData(). Empty data removes the tile.
+    void UpdateTile(const IntVector2& tile, const PODVector<unsigned char>& tileData);
+    /// Remove all tiles.
+    void Clear();
+
+    /// Find a coarse route through the tile portals. Return the portal waypoints followed by the end position, or false if the
+    /// end is not reachable through the graph.
+    bool FindRoute(const Vector3& start, const Vector3& end, PODVector<Vector3>& dest) const;
+    /// Return the tile index of a world position.
+    IntVector2 GetTileIndex(const Vector3& position) const;
+
+    /// Return number of tiles with walkable area.
+    unsigned GetNumTiles() const { return tiles_.Size(); }
+    /// Return total number of portals.
+    unsigned GetNumPortals() const;
+
+private:
+    /// Walkable opening on a tile border.
+    struct TilePortal
+    {
+        /// Center position in navigation mesh space.
+        Vector3 position_;
+        /// Start of the opening along the border.
+        float min_;
+        /// End of the opening along the border.
+        float max_;
+        /// Connected polygon component of the tile the portal belongs to.
+        unsigned component_;
+        /// Border side: 0 = +X, 2 = +Z, 4 = -X, 6 = -Z, as in Detour.
+        unsigned char side_;
+    };
+
+    /// Portals and polygon connectivity of one tile.
+    struct TilePortals
+    {
+        /// Portals on the tile borders.
+        PODVector<TilePortal> portals_;
+        /// Polygon centers in navigation mesh space.
+        PODVector<Vector3> polyCenters_;
+        /// Connected component of each polygon.
+        PODVector<unsigned> polyComponents_;
+    };
+
+    /// Return the connected component of the polygon nearest to a position in navigation mesh space.
+    bool GetComponent(const IntVector2& tile, const Vector3& position, unsigned& component) const;
+
+    /// Tiles with walkable area.
+    HashMap<IntVector2, TilePortals> tiles_;
+    /// Navigation mesh world transform.
+    Matrix3x4 transform_;
+    /// Inverse of the navigation mesh world transform.
+    Matrix3x4 inverseTransform_;
+    /// Navigation mesh bounding box minimum in navigation mesh space.
+    Vector3 origin_;
+    /// Tile edge length.
+    float tileEdgeLength_;
+    /// Height difference allowed between portals connected across a border.
+    float portalHeightTolerance_;
+};
+
+#endif //URHO3DSAMPLES_TILEPORTALGRAPH_H
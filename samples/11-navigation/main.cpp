@@ -4,6 +4,15 @@
 
 #include <Urho3D/Urho3DAll.h>
 
+#include "NavigationRebuildQueue.h"
+#include "NavigationTileArchive.h"
+#include "NavigationTilePrefetcher.h"
+#include "NavigationTileStore.h"
+#include "ParallelNavigationBuilder.h"
+#include "PathFollowerSystem.h"
+#include "PathQueryService.h"
+#include "TilePortalGraph.h"
+
 using namespace Urho3D;
 class MyApp : public Application
 {
@@ -11,7 +20,22 @@ public:
     MyApp(Context* context)
             : Application(context)
             , drawDebug_(false)
+            , jackFollower_(0)
+            , useStreaming_(false)
+            , streamingDistance_(2)
+            , refineDistance_(3)
+            , routeLegPending_(false)
     {
+        // Register factory for the asynchronous path query service so it can be created via CreateComponent
+        PathQueryService::RegisterObject(context);
+        // Register factory for the deferred navigation mesh rebuild queue
+        NavigationRebuildQueue::RegisterObject(context);
+
+        // Create the tile prefetcher, which decodes the tiles Jack is heading to ahead of the streaming window
+        tilePrefetcher_ = new NavigationTilePrefetcher(context);
+        tilePrefetcher_->SetStreamingDistance(streamingDistance_);
+        // Create the parallel navigation mesh builder, which builds the tiles on the work queue threads
+        navigationBuilder_ = new ParallelNavigationBuilder(context);
     }
     virtual void Setup()
     {
@@ -114,6 +138,8 @@ public:
         modelObject->SetModel(cache->GetResource<Model>("Models/Kachujin/Kachujin.mdl"));
         modelObject->SetMaterial(cache->GetResource<Material>("Models/Kachujin/Materials/Kachujin.xml"));
         modelObject->SetCastShadows(true);
+        // Let the path follower system move Jack along the calculated paths
+        jackFollower_ = pathFollowers_.AddFollower(jackNode_, 5.0f);
 
         // Create an AnimationState for a walk animation. Its time position will need to be manually updated to advance the
         // animation, The alternative would be to use an AnimationController component which updates the animation automatically,
@@ -142,8 +168,20 @@ public:
         navMesh->SetPadding(Vector3(0.0f, 10.0f, 0.0f));
         // Now build the navigation geometry. This will take some time. Note that the navigation mesh will prefer to use
         // physics geometry from the scene nodes, as it often is simpler, but if it can not find any (like in this example)
-        // it will use renderable geometry instead
-        navMesh->Build();
+        // it will use renderable geometry instead. The tiles are built in parallel on the work queue threads; fall back to the
+        // serial build if that fails
+        if (!navigationBuilder_->Build(navMesh))
+            navMesh->Build();
+        // Extract the portals between the tiles for planning long routes. The portal graph covers the whole navigation mesh
+        // also when only a few tiles are streamed in
+        portalGraph_.Build(navMesh);
+
+        // Create a PathQueryService component to the scene root. Path queries are run on a worker thread through it, so
+        // that a long query does not stall the frame
+        scene_->CreateComponent<PathQueryService>();
+        // Create a NavigationRebuildQueue component to the scene root. Obstacle edits mark tiles dirty through it, and the
+        // dirty tiles are rebuilt once per frame, so that a burst of edits rebuilds each tile only once
+        scene_->CreateComponent<NavigationRebuildQueue>();
 
         // Create the camera. Limit far clip distance to match the fog
         cameraNode_ = scene_->CreateChild("Camera");
@@ -265,8 +303,12 @@ public:
         // Move the camera, scale movement with time step
         MoveCamera(timeStep);
 
-        // Make Jack follow the Detour path
-        FollowPath(timeStep);
+        // Make Jack, and any other followers, follow their Detour paths
+        pathFollowers_.Update(timeStep);
+
+        // Calculate the path for the next leg of a long route when Jack is about to finish the current one
+        if (!route_.Empty() && !routeLegPending_ && pathFollowers_.GetNumWaypoints(jackFollower_) <= 1)
+            AdvanceRoute();
 
         // Update streaming
         Input* input = GetSubsystem<Input>();
@@ -276,10 +318,10 @@ public:
             ToggleStreaming(useStreaming_);
         }
         if (useStreaming_) {
-            UpdateStreaming();
+            UpdateStreaming(timeStep);
         }
 
-        if (currentPath_.Size()) {
+        if (pathFollowers_.HasPath(jackFollower_)) {
             UpdateSkeletalAnimation(timeStep);
         } else {
             UpdateSkeletalAnimation(0);
@@ -297,6 +339,14 @@ public:
         // done with defining the draw calls for the viewports (but before actually executing them.) We will request debug geometry
         // rendering during that event
         SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(MyApp, HandlePostRenderUpdate));
+
+        // Subscribe HandlePathQueryCompleted() function for receiving the paths calculated on the worker thread
+        SubscribeToEvent(scene_->GetComponent<PathQueryService>(), E_PATHQUERYCOMPLETED,
+            URHO3D_HANDLER(MyApp, HandlePathQueryCompleted));
+
+        // Subscribe HandleRebuildQueueFlushed() function for re-planning the path after the navigation mesh has been rebuilt
+        SubscribeToEvent(scene_->GetComponent<NavigationRebuildQueue>(), E_REBUILDQUEUEFLUSHED,
+            URHO3D_HANDLER(MyApp, HandleRebuildQueueFlushed));
     }
 
     void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
@@ -307,21 +357,33 @@ public:
         if (drawDebug_)
             GetSubsystem<Renderer>()->DrawDebugGeometry(false);
 
-        if (currentPath_.Size())
+        if (pathFollowers_.HasPath(jackFollower_))
         {
-            // Visualize the current calculated path
+            // Visualize the rest of the current calculated path
+            const Vector3* path = pathFollowers_.GetWaypoints(jackFollower_);
+            const unsigned numWaypoints = pathFollowers_.GetNumWaypoints(jackFollower_);
             DebugRenderer* debug = scene_->GetComponent<DebugRenderer>();
             debug->AddBoundingBox(BoundingBox(endPos_ - Vector3(0.1f, 0.1f, 0.1f), endPos_ + Vector3(0.1f, 0.1f, 0.1f)),
                                   Color(1.0f, 1.0f, 1.0f));
 
             // Draw the path with a small upward bias so that it does not clip into the surfaces
             Vector3 bias(0.0f, 0.05f, 0.0f);
-            debug->AddLine(jackNode_->GetPosition() + bias, currentPath_[0] + bias, Color(1.0f, 1.0f, 1.0f));
+            debug->AddLine(jackNode_->GetPosition() + bias, path[0] + bias, Color(1.0f, 1.0f, 1.0f));
 
-            if (currentPath_.Size() > 1)
+            for (unsigned i = 0; i + 1 < numWaypoints; ++i)
+                debug->AddLine(path[i] + bias, path[i + 1] + bias, Color(1.0f, 1.0f, 1.0f));
+        }
+
+        if (route_.Size())
+        {
+            // Visualize the rest of the coarse route through the tile portals
+            DebugRenderer* debug = scene_->GetComponent<DebugRenderer>();
+            Vector3 bias(0.0f, 0.05f, 0.0f);
+            Vector3 start = pathFollowers_.HasPath(jackFollower_) ? endPos_ : jackNode_->GetPosition();
+            for (unsigned i = 0; i < route_.Size(); ++i)
             {
-                for (unsigned i = 0; i < currentPath_.Size() - 1; ++i)
-                    debug->AddLine(currentPath_[i] + bias, currentPath_[i + 1] + bias, Color(1.0f, 1.0f, 1.0f));
+                debug->AddLine(start + bias, route_[i] + bias, Color(0.5f, 0.5f, 1.0f));
+                start = route_[i];
             }
         }
     }
@@ -334,24 +396,73 @@ public:
 
         if (Raycast(250.0f, hitPos, hitDrawable))
         {
-            Vector3 pathPos = navMesh->FindNearestPoint(hitPos, Vector3(1.0f, 1.0f, 1.0f));
+            PathQueryService* pathQueries = scene_->GetComponent<PathQueryService>();
 
             if (GetSubsystem<Input>()->GetQualifierDown(QUAL_SHIFT))
             {
-                // Teleport
-                currentPath_.Clear();
+                // Teleport. A path still being calculated is obsolete now. The navigation mesh must not be queried from the
+                // main thread while the worker is using it
+                pathQueries->CancelQuery(jackNode_->GetID());
+                pathQueries->WaitForCompletion();
+                Vector3 pathPos = navMesh->FindNearestPoint(hitPos, Vector3(1.0f, 1.0f, 1.0f));
+
+                pathFollowers_.ClearPath(jackFollower_);
+                route_.Clear();
+                scene_->GetComponent<NavigationRebuildQueue>()->UnwatchPath(jackNode_->GetID());
                 jackNode_->LookAt(Vector3(pathPos.x_, jackNode_->GetPosition().y_, pathPos.z_), Vector3::UP);
                 jackNode_->SetPosition(pathPos);
+                pathFollowers_.SyncFromNode(jackFollower_);
             }
             else
             {
-                // Calculate path from Jack's current position to the end point
-                endPos_ = pathPos;
-                navMesh->FindPath(currentPath_, jackNode_->GetPosition(), endPos_);
+                // Plan a route longer than the refine distance coarsely through the tile portals, and calculate the detailed
+                // path only for its next few tiles, see AdvanceRoute(). This also reaches end points on tiles that are not
+                // streamed in
+                route_.Clear();
+                const IntVector2 jackTile = portalGraph_.GetTileIndex(jackNode_->GetPosition());
+                const IntVector2 endTile = portalGraph_.GetTileIndex(hitPos);
+                if (Max(Abs(endTile.x_ - jackTile.x_), Abs(endTile.y_ - jackTile.y_)) > GetRefineDistance() &&
+                    portalGraph_.FindRoute(jackNode_->GetPosition(), hitPos, route_))
+                    AdvanceRoute();
+                else
+                {
+                    // Calculate path from Jack's current position to the end point on the worker thread. The worker also
+                    // snaps the end point to the navigation mesh. Clicking again before the result arrives replaces the query
+                    routeLegPending_ = false;
+                    pathQueries->SubmitQuery(jackNode_->GetID(), jackNode_->GetPosition(), hitPos);
+                }
             }
         }
     }
 
+    void AdvanceRoute()
+    {
+        // Calculate the detailed path to the farthest route waypoint within the refine distance. With streaming the waypoint
+        // must also be on a loaded tile
+        NavigationMesh* navMesh = scene_->GetComponent<NavigationMesh>();
+        const IntVector2 jackTile = portalGraph_.GetTileIndex(jackNode_->GetPosition());
+        const int refineDistance = GetRefineDistance();
+        unsigned next = 0;
+        for (unsigned i = 1; i < route_.Size(); ++i)
+        {
+            const IntVector2 tile = portalGraph_.GetTileIndex(route_[i]);
+            if (Max(Abs(tile.x_ - jackTile.x_), Abs(tile.y_ - jackTile.y_)) > refineDistance || !navMesh->HasTile(tile))
+                break;
+            next = i;
+        }
+
+        const Vector3 target = route_[next];
+        route_.Erase(0, next + 1);
+        routeLegPending_ = true;
+        scene_->GetComponent<PathQueryService>()->SubmitQuery(jackNode_->GetID(), jackNode_->GetPosition(), target);
+    }
+
+    int GetRefineDistance() const
+    {
+        // Refine no further than the streamed tiles reach
+        return useStreaming_ ? Min(refineDistance_, streamingDistance_) : refineDistance_;
+    }
+
     void AddOrRemoveObject()
     {
         // Raycast and check if we hit a mushroom node. If yes, remove it, if no, create a new one
@@ -376,11 +487,9 @@ public:
                 updateBox = newNode->GetComponent<StaticModel>()->GetWorldBoundingBox();
             }
 
-            // Rebuild part of the navigation mesh, then recalculate path if applicable
-            NavigationMesh* navMesh = scene_->GetComponent<NavigationMesh>();
-            navMesh->Build(updateBox);
-            if (currentPath_.Size())
-                navMesh->FindPath(currentPath_, jackNode_->GetPosition(), endPos_);
+            // Queue the part of the navigation mesh for rebuild. The path is recalculated once the rebuild queue has been
+            // flushed, if it crosses the rebuilt tiles
+            scene_->GetComponent<NavigationRebuildQueue>()->QueueRebuild(updateBox);
         }
     }
 
@@ -428,42 +537,31 @@ public:
         return false;
     }
 
-    void FollowPath(float timeStep)
-    {
-        if (currentPath_.Size())
-        {
-            Vector3 nextWaypoint = currentPath_[0]; // NB: currentPath[0] is the next waypoint in order
-
-            // Rotate Jack toward next waypoint to reach and move. Check for not overshooting the target
-            float move = 5.0f * timeStep;
-            float distance = (jackNode_->GetPosition() - nextWaypoint).Length();
-            if (move > distance)
-                move = distance;
-
-            jackNode_->LookAt(nextWaypoint, Vector3::UP);
-            jackNode_->Translate(Vector3::FORWARD * move);
-
-            // Remove waypoint if reached it
-            if (distance < 0.1f)
-                currentPath_.Erase(0);
-        }
-    }
-
     void ToggleStreaming(bool enabled)
     {
+        scene_->GetComponent<PathQueryService>()->WaitForCompletion();
+        NavigationRebuildQueue* rebuildQueue = scene_->GetComponent<NavigationRebuildQueue>();
         NavigationMesh* navMesh = scene_->GetComponent<NavigationMesh>();
         if (enabled)
         {
+            // Apply the pending edits before the tiles are saved for streaming
+            rebuildQueue->Flush();
             int maxTiles = (2 * streamingDistance_ + 1) * (2 * streamingDistance_ + 1);
             BoundingBox boundingBox = navMesh->GetBoundingBox();
             SaveNavigationData();
             navMesh->Allocate(boundingBox, maxTiles);
         }
         else
-            navMesh->Build();
+        {
+            tilePrefetcher_->Reset();
+            rebuildQueue->Clear();
+            if (!navigationBuilder_->Build(navMesh))
+                navMesh->Build();
+            portalGraph_.Build(navMesh);
+        }
     }
 
-    void UpdateStreaming()
+    void UpdateStreaming(float timeStep)
     {
         // Center the navigation mesh at the jack
         NavigationMesh* navMesh = scene_->GetComponent<NavigationMesh>();
@@ -472,6 +570,13 @@ public:
         const IntVector2 beginTile = VectorMax(IntVector2::ZERO, jackTile - IntVector2::ONE * streamingDistance_);
         const IntVector2 endTile = VectorMin(jackTile + IntVector2::ONE * streamingDistance_, numTiles - IntVector2::ONE);
 
+        // Tiles are not added or removed while the worker is running path queries
+        PathQueryService* pathQueries = scene_->GetComponent<PathQueryService>();
+
+        // Decode the tiles ahead of Jack's movement and path on worker threads, before they enter the streaming window
+        pathFollowers_.GetPath(jackFollower_, pathBuffer_);
+        tilePrefetcher_->Prefetch(navMesh, jackNode_->GetWorldPosition(), pathBuffer_, timeStep);
+
         // Remove tiles
         for (HashSet<IntVector2>::Iterator i = addedTiles_.Begin(); i != addedTiles_.End();)
         {
@@ -480,36 +585,89 @@ public:
                 ++i;
             else
             {
-                navMesh->RemoveTile(tileIdx);
+                pathQueries->WaitForCompletion();
+                tileStore_.RemoveTile(navMesh, tileIdx);
                 i = addedTiles_.Erase(i);
             }
         }
 
-        // Add tiles
-        for (int z = beginTile.y_; z <= endTile.y_; ++z)
-            for (int x = beginTile.x_; x <= endTile.x_; ++x)
-            {
-                const IntVector2 tileIdx(x, z);
-                if (!navMesh->HasTile(tileIdx) && tileData_.Contains(tileIdx))
+        // Add tiles nearest to Jack first. The tile under Jack is added right away, the others once the prefetcher has decoded
+        // them and within its per-frame budget, so crossing a tile border does not add a whole row of tiles in one frame
+        for (int ring = 0; ring <= streamingDistance_; ++ring)
+            for (int z = beginTile.y_; z <= endTile.y_; ++z)
+                for (int x = beginTile.x_; x <= endTile.x_; ++x)
                 {
+                    const IntVector2 tileIdx(x, z);
+                    if (Max(Abs(x - jackTile.x_), Abs(z - jackTile.y_)) != ring || navMesh->HasTile(tileIdx) ||
+                        !(tileArchive_.HasTile(tileIdx) || tileStore_.HasTile(tileIdx)))
+                        continue;
+
+                    const bool decoded = tilePrefetcher_->TakeTile(tileIdx, tileBuffer_);
+                    if (!decoded && tileIdx != jackTile)
+                        continue;
+
+                    pathQueries->WaitForCompletion();
                     addedTiles_.Insert(tileIdx);
-                    navMesh->AddTile(tileData_[tileIdx]);
+                    // Only one of the tile sources is filled, see SaveNavigationData()
+                    if (tileArchive_.IsOpen() && decoded)
+                        navMesh->AddTile(tileBuffer_);
+                    else if (tileArchive_.IsOpen())
+                        tileArchive_.AddTile(navMesh, tileIdx);
+                    else if (decoded)
+                        tileStore_.AddTile(navMesh, tileIdx, tileBuffer_);
+                    else
+                        tileStore_.AddTile(navMesh, tileIdx);
                 }
-            }
     }
 
     void SaveNavigationData()
     {
         NavigationMesh* navMesh = scene_->GetComponent<NavigationMesh>();
-        tileData_.Clear();
+        // Stop decoding from the old tile sources before they are replaced
+        tilePrefetcher_->Reset();
         addedTiles_.Clear();
-        const IntVector2 numTiles = navMesh->GetNumTiles();
-        for (int z = 0; z < numTiles.y_; ++z)
-            for (int x = 0; x <= numTiles.x_; ++x)
-            {
-                const IntVector2 tileIdx = IntVector2(x, z);
-                tileData_[tileIdx] = navMesh->GetTileData(tileIdx);
-            }
+        tileArchive_.Close();
+        tileStore_.Clear();
+
+        // Write the fully built navigation mesh to a tile archive and stream the tiles from its memory mapping, so that only
+        // the pages of the tiles in the streaming window are read. If the archive can not be written, keep the tiles
+        // compressed in memory instead
+        const String archiveName = GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/Navigation.tiles";
+        if (!NavigationTileArchive::Write(navMesh, archiveName) || !tileArchive_.Open(archiveName))
+            tileStore_.Save(navMesh);
+        tilePrefetcher_->SetTileSources(&tileArchive_, &tileStore_);
+    }
+
+    void HandlePathQueryCompleted(StringHash eventType, VariantMap& eventData)
+    {
+        using namespace PathQueryCompleted;
+
+        if (eventData[P_REQUESTER].GetUInt() != jackNode_->GetID())
+            return;
+
+        // Take the path calculated on the worker thread into use
+        routeLegPending_ = false;
+        endPos_ = eventData[P_ENDPOS].GetVector3();
+        const PODVector<Vector3>& path = *static_cast<const PODVector<Vector3>*>(eventData[P_PATH].GetVoidPtr());
+        pathFollowers_.SetPath(jackFollower_, path);
+        scene_->GetComponent<NavigationRebuildQueue>()->WatchPath(jackNode_->GetID(), path);
+    }
+
+    void HandleRebuildQueueFlushed(StringHash eventType, VariantMap& eventData)
+    {
+        using namespace RebuildQueueFlushed;
+
+        // Extract the portals of the rebuilt tiles again
+        const VariantVector& tiles = eventData[P_TILES].GetVariantVector();
+        PODVector<IntVector2> rebuiltTiles;
+        for (unsigned i = 0; i < tiles.Size(); ++i)
+            rebuiltTiles.Push(tiles[i].GetIntVector2());
+        portalGraph_.UpdateTiles(scene_->GetComponent<NavigationMesh>(), rebuiltTiles);
+
+        // Recalculate the path if the rebuilt tiles are on it
+        const VariantVector& requesters = eventData[P_REQUESTERS].GetVariantVector();
+        if (pathFollowers_.HasPath(jackFollower_) && requesters.Contains(Variant(jackNode_->GetID())))
+            scene_->GetComponent<PathQueryService>()->SubmitQuery(jackNode_->GetID(), jackNode_->GetPosition(), endPos_);
     }
 
     void UpdateSkeletalAnimation(float timeStep) {
@@ -537,8 +695,12 @@ private:
     /// Flag for drawing debug geometry.
     bool drawDebug_;
 
-    /// Last calculated path.
-    PODVector<Vector3> currentPath_;
+    /// Path followers.
+    PathFollowerSystem pathFollowers_;
+    /// Jack's path follower index.
+    unsigned jackFollower_;
+    /// Buffer for copying the rest of Jack's path.
+    PODVector<Vector3> pathBuffer_;
     /// Path end position.
     Vector3 endPos_;
     /// Jack scene node.
@@ -547,9 +709,25 @@ private:
     bool useStreaming_;
     /// Streaming distance.
     int streamingDistance_;
-    /// Tile data.
-    HashMap<IntVector2, PODVector<unsigned char> > tileData_;
+    /// Memory-mapped tile archive.
+    NavigationTileArchive tileArchive_;
+    /// Compressed tile data, used when the tile archive is not available.
+    NavigationTileStore tileStore_;
     /// Added tiles.
     HashSet<IntVector2> addedTiles_;
+    /// Tile prefetcher.
+    SharedPtr<NavigationTilePrefetcher> tilePrefetcher_;
+    /// Buffer for the tiles taken from the prefetcher.
+    PODVector<unsigned char> tileBuffer_;
+    /// Parallel navigation mesh builder.
+    SharedPtr<ParallelNavigationBuilder> navigationBuilder_;
+    /// Portal graph between the navigation mesh tiles.
+    TilePortalGraph portalGraph_;
+    /// Rest of the coarse route through the tile portals, after the leg Jack is walking.
+    PODVector<Vector3> route_;
+    /// Distance in tiles up to which a route is calculated in detail.
+    int refineDistance_;
+    /// Flag for the path of the next route leg being calculated.
+    bool routeLegPending_;
 };
 URHO3D_DEFINE_APPLICATION_MAIN(MyApp)
\ No newline at end of file
@@ -107,8 +107,12 @@ public:
         CollisionShape* shape = terrainNode->CreateComponent<CollisionShape>();
         shape->SetTerrain();
 
-        // Create 1000 mushrooms in the terrain. Always face outward along the terrain normal
+        // Create 1000 mushrooms in the terrain. Always face outward along the terrain normal. The physics world builds the
+        // triangle mesh and its BVH once per model and LOD level, and each mushroom collider only wraps the shared BVH in a
+        // scaled shape, so count the colliders sharing the first one's mesh data to make sure none of them built their own
         const unsigned NUM_MUSHROOMS = 1000;
+        CollisionGeometryData* mushroomGeometry = 0;
+        unsigned numSharedMushrooms = 0;
         for (unsigned i = 0; i < NUM_MUSHROOMS; ++i)
         {
             Node* objectNode = scene_->CreateChild("Mushroom");
@@ -127,7 +131,19 @@ public:
             body->SetCollisionLayer(2);
             CollisionShape* shape = objectNode->CreateComponent<CollisionShape>();
             shape->SetTriangleMesh(object->GetModel(), 0);
+
+            if (!mushroomGeometry)
+                mushroomGeometry = shape->GetGeometryData();
+            if (shape->GetGeometryData() == mushroomGeometry)
+                ++numSharedMushrooms;
         }
+
+        const unsigned numTriMeshes = scene_->GetComponent<PhysicsWorld>()->GetTriMeshCache().Size();
+        if (numSharedMushrooms == NUM_MUSHROOMS && numTriMeshes == 1)
+            URHO3D_LOGINFOF("%u mushroom colliders share one triangle mesh BVH", NUM_MUSHROOMS);
+        else
+            URHO3D_LOGWARNINGF("Only %u of %u mushroom colliders share a triangle mesh BVH, %u triangle meshes built",
+                numSharedMushrooms, NUM_MUSHROOMS, numTriMeshes);
     }
 
     void CreateInstructions()
@@ -0,0 +1,201 @@
+//
+// Created by AICDG on 2017/10/26.
+//
+
+#include <Urho3D/Graphics/AnimatedModel.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "AnimationLodController.h"
+
+/// Frames a model is remembered after it was last updated.
+static const unsigned STALE_MODEL_FRAMES = 60;
+
+AnimationLodController::AnimationLodController(Context* context) :
+    Object(context),
+    hysteresis_(2.0f),
+    frameNumber_(0)
+{
+    for (unsigned i = 0; i < MAX_ANIMATIONLODTIERS; ++i)
+        numModels_[i] = 0;
+}
+
+void AnimationLodController::Update(const PODVector<Node*>& nodes, const Vector3& viewPosition)
+{
+    ++frameNumber_;
+    for (unsigned i = 0; i < MAX_ANIMATIONLODTIERS; ++i)
+        numModels_[i] = 0;
+    frozen_.Resize(nodes.Size());
+
+    for (unsigned i = 0; i < nodes.Size(); ++i)
+    {
+        Node* node = nodes[i];
+        frozen_[i] = false;
+        HashMap<unsigned, ModelLod>::Iterator lodIt = models_.Find(node->GetID());
+        if (lodIt == models_.End() || !lodIt->second_.model_ || lodIt->second_.model_->GetNode() != node)
+        {
+            AnimatedModel* model = node->GetComponent<AnimatedModel>();
+            if (!model)
+                continue;
+
+            // Remember the settings the model was created with, the tiers only ever lower them
+            ModelLod lod;
+            lod.model_ = model;
+            lod.tier_ = ANIMATIONLODTIER_FULL;
+            lod.baseLodBias_ = model->GetAnimationLodBias();
+            lod.baseUpdateInvisible_ = model->GetUpdateInvisible();
+            CollectSkippedBones(lod, GetModelSettings(model->GetModel()));
+            lodIt = models_.Insert(MakePair(node->GetID(), lod));
+        }
+
+        ModelLod& lod = lodIt->second_;
+        AnimatedModel* model = lod.model_;
+        if (!model)
+            continue;
+
+        // Visibility is that of the last rendered frame, as the scene update runs before the view is culled
+        const AnimationLodSettings& settings = GetModelSettings(model->GetModel());
+        AnimationLodTier tier = ANIMATIONLODTIER_FROZEN;
+        if (model->IsInView())
+        {
+            const AnimationLodTier currentTier = lod.tier_ == ANIMATIONLODTIER_FROZEN ? ANIMATIONLODTIER_FULL : lod.tier_;
+            tier = SelectTier(settings, currentTier, (node->GetWorldPosition() - viewPosition).Length());
+        }
+
+        lod.lastFrame_ = frameNumber_;
+        ++numModels_[tier];
+        frozen_[i] = tier == ANIMATIONLODTIER_FROZEN;
+        if (tier != lod.tier_)
+        {
+            lod.tier_ = tier;
+            ApplyTier(lod, settings);
+        }
+    }
+
+    // Forget the models that are gone
+    for (HashMap<unsigned, ModelLod>::Iterator i = models_.Begin(); i != models_.End();)
+    {
+        if (!i->second_.model_ || frameNumber_ - i->second_.lastFrame_ > STALE_MODEL_FRAMES)
+            i = models_.Erase(i);
+        else
+            ++i;
+    }
+}
+
+void AnimationLodController::Reset()
+{
+    for (HashMap<unsigned, ModelLod>::Iterator i = models_.Begin(); i != models_.End(); ++i)
+    {
+        ModelLod& lod = i->second_;
+        if (!lod.model_)
+            continue;
+        lod.tier_ = ANIMATIONLODTIER_FULL;
+        ApplyTier(lod, defaultSettings_);
+    }
+
+    models_.Clear();
+    frozen_.Clear();
+    for (unsigned i = 0; i < MAX_ANIMATIONLODTIERS; ++i)
+        numModels_[i] = 0;
+}
+
+void AnimationLodController::SetDefaultSettings(const AnimationLodSettings& settings)
+{
+    defaultSettings_ = settings;
+}
+
+void AnimationLodController::SetModelSettings(Model* model, const AnimationLodSettings& settings)
+{
+    if (model)
+        modelSettings_[StringHash(model->GetName())] = settings;
+
+    // The skipped bones are resolved when a model is first seen
+    Reset();
+}
+
+void AnimationLodController::SetHysteresis(float hysteresis)
+{
+    hysteresis_ = Max(hysteresis, 0.0f);
+}
+
+const AnimationLodSettings& AnimationLodController::GetModelSettings(Model* model) const
+{
+    if (!model)
+        return defaultSettings_;
+    HashMap<StringHash, AnimationLodSettings>::ConstIterator i = modelSettings_.Find(StringHash(model->GetName()));
+    return i != modelSettings_.End() ? i->second_ : defaultSettings_;
+}
+
+AnimationLodTier AnimationLodController::SelectTier(const AnimationLodSettings& settings, AnimationLodTier currentTier,
+    float distance) const
+{
+    // Move a tier up or down only once the distance is past the boundary by the hysteresis
+    AnimationLodTier tier = currentTier;
+    if (tier == ANIMATIONLODTIER_FULL && distance > settings.reducedDistance_ + hysteresis_)
+        tier = ANIMATIONLODTIER_REDUCED;
+    if (tier == ANIMATIONLODTIER_REDUCED && distance > settings.minimalDistance_ + hysteresis_)
+        tier = ANIMATIONLODTIER_MINIMAL;
+    if (tier == ANIMATIONLODTIER_MINIMAL && distance < settings.minimalDistance_ - hysteresis_)
+        tier = ANIMATIONLODTIER_REDUCED;
+    if (tier == ANIMATIONLODTIER_REDUCED && distance < settings.reducedDistance_ - hysteresis_)
+        tier = ANIMATIONLODTIER_FULL;
+    return tier;
+}
+
+void AnimationLodController::CollectSkippedBones(ModelLod& lod, const AnimationLodSettings& settings) const
+{
+    lod.skippedBones_.Clear();
+    const Vector<Bone>& bones = lod.model_->GetSkeleton().GetBones();
+    for (unsigned i = 0; i < bones.Size(); ++i)
+    {
+        // The root bone is its own parent
+        unsigned depth = 0;
+        for (unsigned j = i; bones[j].parentIndex_ != j && depth <= settings.maxBoneDepth_ && depth < bones.Size();
+             j = bones[j].parentIndex_)
+            ++depth;
+
+        bool skipped = depth > settings.maxBoneDepth_;
+        for (unsigned j = 0; j < settings.skippedBones_.Size() && !skipped; ++j)
+            skipped = bones[i].name_ == settings.skippedBones_[j];
+        if (skipped)
+            lod.skippedBones_.Push(i);
+    }
+}
+
+void AnimationLodController::ApplyTier(ModelLod& lod, const AnimationLodSettings& settings) const
+{
+    AnimatedModel* model = lod.model_;
+
+    // A frozen model keeps the rates of its last tier. Its animation is paused by the caller, and updating it out of view is
+    // turned off in case the model had it on. The skipped bones stop at their last pose and resume when the model is back in a
+    // nearer tier
+    switch (lod.tier_)
+    {
+    case ANIMATIONLODTIER_FULL:
+        model->SetAnimationLodBias(lod.baseLodBias_);
+        break;
+
+    case ANIMATIONLODTIER_REDUCED:
+        model->SetAnimationLodBias(lod.baseLodBias_ * settings.reducedLodBias_);
+        break;
+
+    case ANIMATIONLODTIER_MINIMAL:
+        model->SetAnimationLodBias(lod.baseLodBias_ * settings.minimalLodBias_);
+        break;
+
+    default:
+        break;
+    }
+    model->SetUpdateInvisible(lod.tier_ == ANIMATIONLODTIER_FROZEN ? false : lod.baseUpdateInvisible_);
+
+    if (lod.tier_ != ANIMATIONLODTIER_FROZEN)
+    {
+        Skeleton& skeleton = model->GetSkeleton();
+        for (unsigned i = 0; i < lod.skippedBones_.Size(); ++i)
+        {
+            Bone* bone = skeleton.GetBone(lod.skippedBones_[i]);
+            if (bone)
+                bone->animated_ = lod.tier_ != ANIMATIONLODTIER_MINIMAL;
+        }
+    }
+}
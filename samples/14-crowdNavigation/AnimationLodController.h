@@ -0,0 +1,141 @@
+//
+// Created by AICDG on 2017/10/26.
+//
+
+#ifndef URHO3DSAMPLES_ANIMATIONLODCONTROLLER_H
+#define URHO3DSAMPLES_ANIMATIONLODCONTROLLER_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+
+class AnimatedModel;
+class Model;
+class Node;
+
+}
+
+using namespace Urho3D;
+
+/// Skeletal animation level of detail tier.
+enum AnimationLodTier
+{
+    /// Bones updated at the model's own animation LOD bias.
+    ANIMATIONLODTIER_FULL = 0,
+    /// Bones updated at a reduced rate.
+    ANIMATIONLODTIER_REDUCED,
+    /// Bones updated at a minimal rate, and the non-essential bones not animated.
+    ANIMATIONLODTIER_MINIMAL,
+    /// Not in view on the last frame. The walk animation is paused, so the pose is frozen until the model is seen again.
+    ANIMATIONLODTIER_FROZEN,
+    MAX_ANIMATIONLODTIERS
+};
+
+/// Animation LOD thresholds of a model.
+struct AnimationLodSettings
+{
+    /// Construct with defaults.
+    AnimationLodSettings() :
+        reducedDistance_(20.0f),
+        minimalDistance_(50.0f),
+        reducedLodBias_(0.5f),
+        minimalLodBias_(0.2f),
+        maxBoneDepth_(M_MAX_UNSIGNED)
+    {
+    }
+
+    /// Distance from the view beyond which models are in the reduced tier.
+    float reducedDistance_;
+    /// Distance from the view beyond which models are in the minimal tier.
+    float minimalDistance_;
+    /// Animation LOD bias of the reduced tier, relative to the model's own.
+    float reducedLodBias_;
+    /// Animation LOD bias of the minimal tier, relative to the model's own.
+    float minimalLodBias_;
+    /// Bones deeper than this in the skeleton hierarchy, e.g. fingers, are not animated in the minimal tier. The root is at depth 0.
+    unsigned maxBoneDepth_;
+    /// Named bones not animated in the minimal tier.
+    Vector<String> skippedBones_;
+};
+
+/// Assigns animated models to skeletal animation level of detail tiers by distance to the view and visibility. The tiers lower
+/// the animation LOD bias, which sets how often the engine updates the bones, and stop animating the non-essential bones of
+/// distant models. The engine already skips the bone update of models out of view, but advancing their animation still marks
+/// them for an update every frame. Such models are frozen, and flagged so that their animation can be paused. Thresholds can be
+/// set per model resource. Model settings are only touched when the tier changes.
+class AnimationLodController : public Object
+{
+    URHO3D_OBJECT(AnimationLodController, Object);
+
+public:
+    /// Construct.
+    AnimationLodController(Context* context);
+
+    /// Assign the tiers of the animated models of the nodes. Nodes without an AnimatedModel are skipped. Call once per frame.
+    void Update(const PODVector<Node*>& nodes, const Vector3& viewPosition);
+    /// Restore the settings the tiers have changed and forget the models.
+    void Reset();
+
+    /// Set thresholds of the models without their own.
+    void SetDefaultSettings(const AnimationLodSettings& settings);
+    /// Set thresholds of a model resource. Models already in a tier pick them up on their next tier change.
+    void SetModelSettings(Model* model, const AnimationLodSettings& settings);
+    /// Set distance a model must move past a tier boundary before its tier changes.
+    void SetHysteresis(float hysteresis);
+
+    /// Return thresholds of the models without their own.
+    const AnimationLodSettings& GetDefaultSettings() const { return defaultSettings_; }
+    /// Return thresholds of a model resource.
+    const AnimationLodSettings& GetModelSettings(Model* model) const;
+    /// Return hysteresis distance.
+    float GetHysteresis() const { return hysteresis_; }
+    /// Return number of models in a tier after the last update.
+    unsigned GetNumModels(AnimationLodTier tier) const { return numModels_[tier]; }
+    /// Return whether the model of each node of the last update is frozen, in the order of the nodes.
+    const PODVector<bool>& GetFrozen() const { return frozen_; }
+
+private:
+    /// Tier state and original settings of a model.
+    struct ModelLod
+    {
+        /// Animated model.
+        WeakPtr<AnimatedModel> model_;
+        /// Current tier.
+        AnimationLodTier tier_;
+        /// Animation LOD bias before the tiers were applied.
+        float baseLodBias_;
+        /// Whether the model updated out of view before the tiers were applied.
+        bool baseUpdateInvisible_;
+        /// Indices of the bones not animated in the minimal tier.
+        PODVector<unsigned> skippedBones_;
+        /// Last frame the model was updated.
+        unsigned lastFrame_;
+    };
+
+    /// Select the tier of a model.
+    AnimationLodTier SelectTier(const AnimationLodSettings& settings, AnimationLodTier currentTier, float distance) const;
+    /// Collect the bones of a model not animated in the minimal tier.
+    void CollectSkippedBones(ModelLod& lod, const AnimationLodSettings& settings) const;
+    /// Apply the settings of a model's tier.
+    void ApplyTier(ModelLod& lod, const AnimationLodSettings& settings) const;
+
+    /// Tier states by node ID.
+    HashMap<unsigned, ModelLod> models_;
+    /// Thresholds by model resource name.
+    HashMap<StringHash, AnimationLodSettings> modelSettings_;
+    /// Thresholds of the models without their own.
+    AnimationLodSettings defaultSettings_;
+    /// Hysteresis distance.
+    float hysteresis_;
+    /// Number of models per tier.
+    unsigned numModels_[MAX_ANIMATIONLODTIERS];
+    /// Frozen flags of the nodes of the last update.
+    PODVector<bool> frozen_;
+    /// Frame counter.
+    unsigned frameNumber_;
+};
+
+#endif //URHO3DSAMPLES_ANIMATIONLODCONTROLLER_H
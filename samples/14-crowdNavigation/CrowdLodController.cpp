@@ -0,0 +1,139 @@
+//
+// Created by AICDG on 2017/10/19.
+//
+
+#include <Urho3D/Scene/Node.h>
+
+#include "CrowdLodController.h"
+
+/// Frames an agent is remembered after it was last seen in the crowd.
+static const unsigned STALE_AGENT_FRAMES = 60;
+
+CrowdLodController::CrowdLodController(Context* context) :
+    Object(context),
+    midDistance_(25.0f),
+    farDistance_(60.0f),
+    hysteresis_(2.0f),
+    midAvoidanceType_(1),
+    tierFunction_(0),
+    tierFunctionData_(0),
+    frameNumber_(0)
+{
+    for (unsigned i = 0; i < MAX_CROWDLODTIERS; ++i)
+        numAgents_[i] = 0;
+}
+
+void CrowdLodController::Update(const PODVector<CrowdAgent*>& agents, const Vector3& focus)
+{
+    ++frameNumber_;
+    for (unsigned i = 0; i < MAX_CROWDLODTIERS; ++i)
+        numAgents_[i] = 0;
+
+    for (unsigned i = 0; i < agents.Size(); ++i)
+    {
+        CrowdAgent* agent = agents[i];
+        HashMap<unsigned, AgentLod>::Iterator lodIt = agents_.Find(agent->GetID());
+        if (lodIt == agents_.End() || lodIt->second_.agent_ != agent)
+        {
+            // Remember the settings the agent was created with, the tiers only ever lower them
+            AgentLod lod;
+            lod.agent_ = agent;
+            lod.tier_ = CROWDLODTIER_NEAR;
+            lod.baseQuality_ = agent->GetNavigationQuality();
+            lod.baseAvoidanceType_ = agent->GetObstacleAvoidanceType();
+            lodIt = agents_.Insert(MakePair(agent->GetID(), lod));
+        }
+
+        AgentLod& lod = lodIt->second_;
+        lod.lastFrame_ = frameNumber_;
+        const CrowdLodTier tier = SelectTier(agent, lod.tier_, (agent->GetNode()->GetWorldPosition() - focus).Length());
+        ++numAgents_[tier];
+        if (tier != lod.tier_)
+        {
+            lod.tier_ = tier;
+            ApplyTier(agent, lod);
+        }
+    }
+
+    // Forget the agents that have left the crowd
+    for (HashMap<unsigned, AgentLod>::Iterator i = agents_.Begin(); i != agents_.End();)
+    {
+        if (frameNumber_ - i->second_.lastFrame_ > STALE_AGENT_FRAMES)
+            i = agents_.Erase(i);
+        else
+            ++i;
+    }
+}
+
+void CrowdLodController::Reset()
+{
+    for (HashMap<unsigned, AgentLod>::Iterator i = agents_.Begin(); i != agents_.End(); ++i)
+    {
+        CrowdAgent* agent = i->second_.agent_;
+        if (!agent)
+            continue;
+        if (agent->GetNavigationQuality() != i->second_.baseQuality_)
+            agent->SetNavigationQuality(i->second_.baseQuality_);
+        if (agent->GetObstacleAvoidanceType() != i->second_.baseAvoidanceType_)
+            agent->SetObstacleAvoidanceType(i->second_.baseAvoidanceType_);
+    }
+
+    agents_.Clear();
+    for (unsigned i = 0; i < MAX_CROWDLODTIERS; ++i)
+        numAgents_[i] = 0;
+}
+
+void CrowdLodController::SetDistances(float midDistance, float farDistance)
+{
+    midDistance_ = Max(midDistance, 0.0f);
+    farDistance_ = Max(farDistance, midDistance_);
+}
+
+void CrowdLodController::SetHysteresis(float hysteresis)
+{
+    hysteresis_ = Max(hysteresis, 0.0f);
+}
+
+void CrowdLodController::SetMidAvoidanceType(unsigned avoidanceType)
+{
+    midAvoidanceType_ = avoidanceType;
+}
+
+void CrowdLodController::SetTierFunction(CrowdLodTierFunction function, void* userData)
+{
+    tierFunction_ = function;
+    tierFunctionData_ = userData;
+}
+
+CrowdLodTier CrowdLodController::SelectTier(CrowdAgent* agent, CrowdLodTier currentTier, float distance) const
+{
+    if (tierFunction_)
+        return tierFunction_(agent, distance, tierFunctionData_);
+
+    // Move the boundaries of the current tier outward, so that an agent must clearly cross a boundary to change tier
+    const float midDistance = currentTier == CROWDLODTIER_NEAR ? midDistance_ + hysteresis_ : midDistance_ - hysteresis_;
+    const float farDistance = currentTier == CROWDLODTIER_FAR ? farDistance_ - hysteresis_ : farDistance_ + hysteresis_;
+    if (distance > farDistance)
+        return CROWDLODTIER_FAR;
+    else if (distance > midDistance)
+        return CROWDLODTIER_MID;
+    else
+        return CROWDLODTIER_NEAR;
+}
+
+void CrowdLodController::ApplyTier(CrowdAgent* agent, const AgentLod& lod) const
+{
+    NavigationQuality quality = lod.baseQuality_;
+    unsigned avoidanceType = lod.baseAvoidanceType_;
+    // The mid tier keeps avoiding obstacles, with fewer velocity samples
+    if (lod.tier_ == CROWDLODTIER_MID)
+        avoidanceType = midAvoidanceType_;
+    else if (lod.tier_ == CROWDLODTIER_FAR)
+        quality = NAVIGATIONQUALITY_LOW;
+
+    // Changing the parameters updates the Detour agent, so skip the ones the tier change leaves as they were
+    if (agent->GetNavigationQuality() != quality)
+        agent->SetNavigationQuality(quality);
+    if (agent->GetObstacleAvoidanceType() != avoidanceType)
+        agent->SetObstacleAvoidanceType(avoidanceType);
+}
@@ -0,0 +1,107 @@
+//
+// Created by AICDG on 2017/10/19.
+//
+
+#ifndef URHO3DSAMPLES_CROWDLODCONTROLLER_H
+#define URHO3DSAMPLES_CROWDLODCONTROLLER_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Navigation/CrowdAgent.h>
+
+using namespace Urho3D;
+
+/// Crowd simulation level of detail tier.
+enum CrowdLodTier
+{
+    /// Full rate steering with the agent's own obstacle avoidance.
+    CROWDLODTIER_NEAR = 0,
+    /// Cheaper obstacle avoidance parameters.
+    CROWDLODTIER_MID,
+    /// No steering, only advance along the path corridor.
+    CROWDLODTIER_FAR,
+    MAX_CROWDLODTIERS
+};
+
+/// Function that selects the tier of an agent from its distance to the focus. Replaces the distance thresholds when set.
+typedef CrowdLodTier (*CrowdLodTierFunction)(CrowdAgent* agent, float distance, void* userData);
+
+/// Assigns the crowd agents to simulation level of detail tiers by distance to a focus, usually the camera. The tiers cap the
+/// navigation quality and choose the obstacle avoidance parameters of the agents, which set the cost of their crowd update.
+/// Agent settings are only touched when the tier changes, as every change updates the Detour agent.
+class CrowdLodController : public Object
+{
+    URHO3D_OBJECT(CrowdLodController, Object);
+
+public:
+    /// Construct.
+    CrowdLodController(Context* context);
+
+    /// Assign the tiers of the agents of the crowd, eg. those of a CrowdRepositionBatch, so that the scene is not searched for
+    /// them again. Call once per frame.
+    void Update(const PODVector<CrowdAgent*>& agents, const Vector3& focus);
+    /// Restore the agent settings the tiers have changed and forget the agents, eg. before the scene is saved or loaded.
+    void Reset();
+
+    /// Set distances from the focus beyond which agents are in the mid and far tiers.
+    void SetDistances(float midDistance, float farDistance);
+    /// Set distance an agent must move past a tier boundary before its tier changes, so that agents do not flip every frame.
+    void SetHysteresis(float hysteresis);
+    /// Set the crowd manager obstacle avoidance parameters index used by mid tier agents.
+    void SetMidAvoidanceType(unsigned avoidanceType);
+    /// Set a tier selection function to use instead of the distance thresholds. Null restores the thresholds.
+    void SetTierFunction(CrowdLodTierFunction function, void* userData = 0);
+
+    /// Return the mid tier distance.
+    float GetMidDistance() const { return midDistance_; }
+    /// Return the far tier distance.
+    float GetFarDistance() const { return farDistance_; }
+    /// Return the hysteresis distance.
+    float GetHysteresis() const { return hysteresis_; }
+    /// Return the mid tier obstacle avoidance parameters index.
+    unsigned GetMidAvoidanceType() const { return midAvoidanceType_; }
+    /// Return number of agents in a tier after the last update.
+    unsigned GetNumAgents(CrowdLodTier tier) const { return numAgents_[tier]; }
+
+private:
+    /// Tier state and original settings of an agent.
+    struct AgentLod
+    {
+        /// Agent.
+        WeakPtr<CrowdAgent> agent_;
+        /// Current tier.
+        CrowdLodTier tier_;
+        /// Navigation quality before the tiers were applied.
+        NavigationQuality baseQuality_;
+        /// Obstacle avoidance type before the tiers were applied.
+        unsigned baseAvoidanceType_;
+        /// Last frame the agent was in the crowd.
+        unsigned lastFrame_;
+    };
+
+    /// Select the tier of an agent.
+    CrowdLodTier SelectTier(CrowdAgent* agent, CrowdLodTier currentTier, float distance) const;
+    /// Apply the settings of an agent's tier.
+    void ApplyTier(CrowdAgent* agent, const AgentLod& lod) const;
+
+    /// Tier states by agent ID.
+    HashMap<unsigned, AgentLod> agents_;
+    /// Mid tier distance.
+    float midDistance_;
+    /// Far tier distance.
+    float farDistance_;
+    /// Hysteresis distance.
+    float hysteresis_;
+    /// Mid tier obstacle avoidance parameters index.
+    unsigned midAvoidanceType_;
+    /// Tier selection function.
+    CrowdLodTierFunction tierFunction_;
+    /// Tier selection function user data.
+    void* tierFunctionData_;
+    /// Number of agents per tier.
+    unsigned numAgents_[MAX_CROWDLODTIERS];
+    /// Frame counter.
+    unsigned frameNumber_;
+};
+
+#endif //URHO3DSAMPLES_CROWDLODCONTROLLER_H
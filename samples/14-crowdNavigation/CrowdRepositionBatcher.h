@@ -0,0 +1,67 @@
+//
+// Created by AICDG on 2017/10/20.
+//
+
+#ifndef URHO3DSAMPLES_CROWDREPOSITIONBATCHER_H
+#define URHO3DSAMPLES_CROWDREPOSITIONBATCHER_H
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+
+class CrowdAgent;
+class Node;
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+/// Crowd agents repositioned by a crowd update. Sent by CrowdRepositionBatcher once per scene update.
+URHO3D_EVENT(E_CROWDREPOSITIONBATCH, CrowdRepositionBatchEvent)
+{
+    URHO3D_PARAM(P_BATCH, Batch);                  // void pointer to const CrowdRepositionBatch, valid during the event only
+}
+
+/// Agents of one crowd update in contiguous arrays, all of the same size.
+struct CrowdRepositionBatch
+{
+    /// Agents in the crowd.
+    PODVector<CrowdAgent*> agents_;
+    /// Agent scene nodes.
+    PODVector<Node*> nodes_;
+    /// Actual agent velocities.
+    PODVector<Vector3> velocities_;
+    /// Time step of the crowd update.
+    float timeStep_;
+};
+
+/// Collects the agents of the scene's crowd after each crowd update and hands them to the event handlers in one batch, instead
+/// of handling E_CROWD_AGENT_REPOSITION once per agent.
+class CrowdRepositionBatcher : public Object
+{
+    URHO3D_OBJECT(CrowdRepositionBatcher, Object);
+
+public:
+    /// Construct.
+    CrowdRepositionBatcher(Context* context);
+
+    /// Set the scene whose crowd is batched. The crowd manager is looked up every update, so it may be replaced by a scene load.
+    void SetScene(Scene* scene);
+
+    /// Return the last batch.
+    const CrowdRepositionBatch& GetBatch() const { return batch_; }
+
+private:
+    /// Handle the scene post-update, which follows the crowd update.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+
+    /// Scene.
+    WeakPtr<Scene> scene_;
+    /// Batch of the last crowd update.
+    CrowdRepositionBatch batch_;
+};
+
+#endif //URHO3DSAMPLES_CROWDREPOSITIONBATCHER_H
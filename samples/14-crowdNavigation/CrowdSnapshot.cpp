@@ -0,0 +1,294 @@
+//
+// Created by AICDG on 2017/10/27.
+//
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
+#include <Urho3D/Navigation/CrowdAgent.h>
+#include <Urho3D/Navigation/CrowdManager.h>
+#include <Urho3D/Navigation/Obstacle.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include <Detour/DetourCommon.h>
+#include <DetourCrowd/DetourCrowd.h>
+
+#include "CrowdSnapshot.h"
+
+/// Snapshot file ID.
+static const char* SNAPSHOT_ID = "CSNP";
+/// Snapshot format version.
+static const unsigned SNAPSHOT_VERSION = 1;
+/// Maximum corridor length a Detour crowd agent holds. dtCrowd::init() allocates every corridor for this many polygons.
+static const unsigned MAX_CORRIDOR_POLYS = 256;
+
+/// Write an array in one block, preceded by its size.
+template <class T> static bool WriteArray(Serializer& dest, const PODVector<T>& array)
+{
+    if (!dest.WriteUInt(array.Size()))
+        return false;
+    const unsigned bytes = array.Size() * sizeof(T);
+    return !bytes || dest.Write(array.Buffer(), bytes) == bytes;
+}
+
+/// Read an array written by WriteArray() in one block.
+template <class T> static bool ReadArray(Deserializer& source, PODVector<T>& array)
+{
+    const unsigned size = source.ReadUInt();
+    const unsigned bytes = size * sizeof(T);
+    if (bytes / sizeof(T) != size || bytes > source.GetSize() - source.GetPosition())
+        return false;
+    array.Resize(size);
+    return !bytes || source.Read(&array[0], bytes) == bytes;
+}
+
+CrowdSnapshot::CrowdSnapshot()
+{
+    corridorStarts_.Push(0);
+}
+
+bool CrowdSnapshot::Capture(Scene* scene)
+{
+    Clear();
+    CrowdManager* crowdManager = scene ? scene->GetComponent<CrowdManager>() : 0;
+    if (!crowdManager)
+        return false;
+
+    const PODVector<CrowdAgent*> agents = crowdManager->GetAgents();
+    for (unsigned i = 0; i < agents.Size(); ++i)
+    {
+        CrowdAgent* agent = agents[i];
+        Node* node = agent->GetNode();
+        const CrowdAgentRequestedTarget targetType = agent->GetRequestedTargetType();
+
+        agentIds_.Push(node->GetID());
+        agentParentIds_.Push(node->GetParent() ? node->GetParent()->GetID() : 0);
+        positions_.Push(node->GetWorldPosition());
+        velocities_.Push(agent->GetActualVelocity());
+        targetTypes_.Push((unsigned char)targetType);
+        targets_.Push(targetType == CA_REQUESTEDTARGET_VELOCITY ? agent->GetTargetVelocity() : agent->GetTargetPosition());
+
+        // Only a planned path has a corridor worth keeping, a pending request is simply made again
+        const dtCrowdAgent* detourAgent = agent->GetDetourCrowdAgent();
+        if (targetType == CA_REQUESTEDTARGET_POSITION && detourAgent && detourAgent->targetState == DT_CROWDAGENT_TARGET_VALID &&
+            detourAgent->corridor.getPathCount())
+        {
+            const dtPolyRef* path = detourAgent->corridor.getPath();
+            for (int j = 0; j < detourAgent->corridor.getPathCount(); ++j)
+                corridorPolys_.Push(path[j]);
+            targetRefs_.Push(detourAgent->targetRef);
+            targets_.Back() = Vector3(detourAgent->targetPos);
+        }
+        else
+            targetRefs_.Push(0);
+        corridorStarts_.Push(corridorPolys_.Size());
+    }
+
+    PODVector<Obstacle*> obstacles;
+    scene->GetComponents<Obstacle>(obstacles, true);
+    for (unsigned i = 0; i < obstacles.Size(); ++i)
+    {
+        Node* node = obstacles[i]->GetNode();
+        obstacleIds_.Push(node->GetID());
+        obstacleParentIds_.Push(node->GetParent() ? node->GetParent()->GetID() : 0);
+        obstaclePositions_.Push(node->GetWorldPosition());
+        obstacleRotations_.Push(node->GetWorldRotation());
+        obstacleScales_.Push(node->GetWorldScale());
+        obstacleSizes_.Push(Vector2(obstacles[i]->GetRadius(), obstacles[i]->GetHeight()));
+    }
+
+    return true;
+}
+
+unsigned CrowdSnapshot::Restore(Scene* scene, CrowdSnapshotAgentFactory agentFactory, CrowdSnapshotObstacleFactory obstacleFactory,
+    void* userData) const
+{
+    CrowdManager* crowdManager = scene ? scene->GetComponent<CrowdManager>() : 0;
+    if (!crowdManager)
+        return 0;
+
+    // Obstacles go first, so that the tile cache sees the obstacle set the corridors were planned on. Nodes which only moved
+    // are moved back
+    HashMap<unsigned, unsigned> obstacleIndices;
+    for (unsigned i = 0; i < obstacleIds_.Size(); ++i)
+        obstacleIndices[obstacleIds_[i]] = i;
+
+    PODVector<Obstacle*> obstacles;
+    scene->GetComponents<Obstacle>(obstacles, true);
+    PODVector<bool> obstacleFound;
+    obstacleFound.Resize(obstacleIds_.Size());
+    for (unsigned i = 0; i < obstacleFound.Size(); ++i)
+        obstacleFound[i] = false;
+    for (unsigned i = 0; i < obstacles.Size(); ++i)
+    {
+        Node* node = obstacles[i]->GetNode();
+        HashMap<unsigned, unsigned>::ConstIterator index = obstacleIndices.Find(node->GetID());
+        if (index == obstacleIndices.End())
+        {
+            node->Remove();
+            continue;
+        }
+
+        const unsigned j = index->second_;
+        obstacleFound[j] = true;
+        if (!node->GetWorldPosition().Equals(obstaclePositions_[j]))
+            node->SetWorldPosition(obstaclePositions_[j]);
+    }
+
+    for (unsigned i = 0; i < obstacleIds_.Size(); ++i)
+    {
+        if (obstacleFound[i] || !obstacleFactory)
+            continue;
+        Node* parent = scene->GetNode(obstacleParentIds_[i]);
+        Node* node = obstacleFactory(parent ? parent : scene, obstaclePositions_[i], obstacleRotations_[i], obstacleScales_[i],
+            userData);
+        Obstacle* obstacle = node ? node->GetComponent<Obstacle>() : 0;
+        if (obstacle)
+        {
+            obstacle->SetRadius(obstacleSizes_[i].x_);
+            obstacle->SetHeight(obstacleSizes_[i].y_);
+        }
+    }
+
+    // Agents not in the snapshot are removed, the missing ones created
+    HashSet<unsigned> agentIds;
+    for (unsigned i = 0; i < agentIds_.Size(); ++i)
+        agentIds.Insert(agentIds_[i]);
+
+    const PODVector<CrowdAgent*> agents = crowdManager->GetAgents();
+    for (unsigned i = 0; i < agents.Size(); ++i)
+    {
+        if (!agentIds.Contains(agents[i]->GetNode()->GetID()))
+            agents[i]->GetNode()->Remove();
+    }
+
+    unsigned numRestored = 0;
+    for (unsigned i = 0; i < agentIds_.Size(); ++i)
+    {
+        Node* node = scene->GetNode(agentIds_[i]);
+        CrowdAgent* agent = node ? node->GetComponent<CrowdAgent>() : 0;
+        if (!agent && agentFactory)
+        {
+            Node* parent = scene->GetNode(agentParentIds_[i]);
+            node = agentFactory(parent ? parent : scene, positions_[i], userData);
+            agent = node ? node->GetComponent<CrowdAgent>() : 0;
+        }
+        if (!agent)
+            continue;
+
+        // The agent follows its node, which resets the Detour agent to the new position
+        node->SetWorldPosition(positions_[i]);
+
+        const CrowdAgentRequestedTarget targetType = (CrowdAgentRequestedTarget)targetTypes_[i];
+        if (targetType == CA_REQUESTEDTARGET_POSITION)
+            agent->SetTargetPosition(targets_[i]);
+        else if (targetType == CA_REQUESTEDTARGET_VELOCITY)
+            agent->SetTargetVelocity(targets_[i]);
+        else
+            agent->ResetTarget();
+
+        // The Detour agents live in the Detour crowd, the component only hands out a const view of them. Setting the target
+        // above has queued a move request, which is replaced by the stored corridor so that the path is not planned again.
+        // The crowd checks the corridor against the navigation mesh on its next update, and plans again only if the tiles
+        // under it have changed since
+        dtCrowdAgent* detourAgent = const_cast<dtCrowdAgent*>(agent->GetDetourCrowdAgent());
+        if (!detourAgent)
+            continue;
+
+        dtVcopy(detourAgent->vel, velocities_[i].Data());
+        dtVcopy(detourAgent->dvel, velocities_[i].Data());
+        dtVcopy(detourAgent->nvel, velocities_[i].Data());
+
+        const unsigned corridorStart = corridorStarts_[i];
+        const unsigned corridorSize = corridorStarts_[i + 1] - corridorStart;
+        // A corridor that does not fit the agent is left to the move request queued above
+        if (targetType != CA_REQUESTEDTARGET_POSITION || !corridorSize || corridorSize > MAX_CORRIDOR_POLYS ||
+            !targetRefs_[i])
+            continue;
+
+        PODVector<dtPolyRef> path;
+        path.Resize(corridorSize);
+        for (unsigned j = 0; j < corridorSize; ++j)
+            path[j] = (dtPolyRef)corridorPolys_[corridorStart + j];
+
+        detourAgent->corridor.reset(path[0], positions_[i].Data());
+        detourAgent->corridor.setCorridor(targets_[i].Data(), &path[0], (int)corridorSize);
+        detourAgent->boundary.reset();
+        detourAgent->ncorners = 0;
+        detourAgent->topologyOptTime = 0.0f;
+        detourAgent->targetRef = (dtPolyRef)targetRefs_[i];
+        dtVcopy(detourAgent->targetPos, targets_[i].Data());
+        detourAgent->targetState = DT_CROWDAGENT_TARGET_VALID;
+        detourAgent->targetPathqRef = DT_PATHQ_INVALID;
+        detourAgent->targetReplan = false;
+        detourAgent->targetReplanTime = 0.0f;
+        detourAgent->state = DT_CROWDAGENT_STATE_WALKING;
+        ++numRestored;
+    }
+
+    return numRestored;
+}
+
+bool CrowdSnapshot::Save(Serializer& dest) const
+{
+    if (!dest.WriteFileID(SNAPSHOT_ID) || !dest.WriteUInt(SNAPSHOT_VERSION))
+        return false;
+
+    return WriteArray(dest, agentIds_) && WriteArray(dest, agentParentIds_) && WriteArray(dest, positions_) &&
+        WriteArray(dest, velocities_) && WriteArray(dest, targetTypes_) && WriteArray(dest, targets_) &&
+        WriteArray(dest, targetRefs_) && WriteArray(dest, corridorStarts_) && WriteArray(dest, corridorPolys_) &&
+        WriteArray(dest, obstacleIds_) && WriteArray(dest, obstacleParentIds_) && WriteArray(dest, obstaclePositions_) &&
+        WriteArray(dest, obstacleRotations_) && WriteArray(dest, obstacleScales_) && WriteArray(dest, obstacleSizes_);
+}
+
+bool CrowdSnapshot::Load(Deserializer& source)
+{
+    Clear();
+    if (source.ReadFileID() != SNAPSHOT_ID || source.ReadUInt() != SNAPSHOT_VERSION)
+        return false;
+
+    bool success = ReadArray(source, agentIds_) && ReadArray(source, agentParentIds_) && ReadArray(source, positions_) &&
+        ReadArray(source, velocities_) && ReadArray(source, targetTypes_) && ReadArray(source, targets_) &&
+        ReadArray(source, targetRefs_) && ReadArray(source, corridorStarts_) && ReadArray(source, corridorPolys_) &&
+        ReadArray(source, obstacleIds_) && ReadArray(source, obstacleParentIds_) && ReadArray(source, obstaclePositions_) &&
+        ReadArray(source, obstacleRotations_) && ReadArray(source, obstacleScales_) && ReadArray(source, obstacleSizes_);
+
+    // Check the arrays agree with each other, so that restoring never reads past them
+    const unsigned numAgents = agentIds_.Size();
+    const unsigned numObstacles = obstacleIds_.Size();
+    success = success && agentParentIds_.Size() == numAgents && positions_.Size() == numAgents &&
+        velocities_.Size() == numAgents && targetTypes_.Size() == numAgents && targets_.Size() == numAgents &&
+        targetRefs_.Size() == numAgents && corridorStarts_.Size() == numAgents + 1 && !corridorStarts_.Front() &&
+        corridorStarts_.Back() == corridorPolys_.Size() && obstacleParentIds_.Size() == numObstacles &&
+        obstaclePositions_.Size() == numObstacles && obstacleRotations_.Size() == numObstacles &&
+        obstacleScales_.Size() == numObstacles && obstacleSizes_.Size() == numObstacles;
+    for (unsigned i = 0; i < numAgents && success; ++i)
+    {
+        success = corridorStarts_[i] <= corridorStarts_[i + 1] &&
+            corridorStarts_[i + 1] - corridorStarts_[i] <= MAX_CORRIDOR_POLYS;
+    }
+
+    if (!success)
+        Clear();
+    return success;
+}
+
+void CrowdSnapshot::Clear()
+{
+    agentIds_.Clear();
+    agentParentIds_.Clear();
+    positions_.Clear();
+    velocities_.Clear();
+    targetTypes_.Clear();
+    targets_.Clear();
+    targetRefs_.Clear();
+    corridorStarts_.Clear();
+    corridorStarts_.Push(0);
+    corridorPolys_.Clear();
+    obstacleIds_.Clear();
+    obstacleParentIds_.Clear();
+    obstaclePositions_.Clear();
+    obstacleRotations_.Clear();
+    obstacleScales_.Clear();
+    obstacleSizes_.Clear();
+}
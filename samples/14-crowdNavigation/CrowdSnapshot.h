@@ -0,0 +1,96 @@
+//
+// Created by AICDG on 2017/10/27.
+//
+
+#ifndef URHO3DSAMPLES_CROWDSNAPSHOT_H
+#define URHO3DSAMPLES_CROWDSNAPSHOT_H
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Quaternion.h>
+
+namespace Urho3D
+{
+
+class Deserializer;
+class Node;
+class Scene;
+class Serializer;
+
+}
+
+using namespace Urho3D;
+
+/// Function that creates an agent node under a parent for an agent missing from the scene. The node must have a CrowdAgent.
+/// Return null to leave the agent out.
+typedef Node* (*CrowdSnapshotAgentFactory)(Node* parent, const Vector3& position, void* userData);
+/// Function that creates an obstacle node under a parent for an obstacle missing from the scene. The node must have an Obstacle.
+/// Return null to leave the obstacle out.
+typedef Node* (*CrowdSnapshotObstacleFactory)(Node* parent, const Vector3& position, const Quaternion& rotation,
+    const Vector3& scale, void* userData);
+
+/// Compact binary snapshot of a scene's crowd: agent positions, velocities, targets and Detour path corridors, and the obstacle
+/// set. The state is kept in contiguous arrays, which are written and read in bulk. Restoring hands the corridors straight
+/// back to the Detour crowd, so the agents continue without planning their paths again. Corridors are only valid for the same
+/// navigation mesh, so snapshots are meant for checkpointing a running simulation. Agents whose corridor no longer matches the
+/// navigation mesh plan again.
+class CrowdSnapshot
+{
+public:
+    /// Construct.
+    CrowdSnapshot();
+
+    /// Capture the crowd and obstacles of a scene. Return false if the scene has no crowd manager.
+    bool Capture(Scene* scene);
+    /// Restore the crowd and obstacles to a scene. Agent and obstacle nodes are matched by ID. Nodes not in the snapshot are
+    /// removed, and the missing ones are created with the factories. Return number of agents restored without planning.
+    unsigned Restore(Scene* scene, CrowdSnapshotAgentFactory agentFactory, CrowdSnapshotObstacleFactory obstacleFactory,
+        void* userData = 0) const;
+    /// Write to a stream. Return true on success.
+    bool Save(Serializer& dest) const;
+    /// Read from a stream. Return true on success.
+    bool Load(Deserializer& source);
+    /// Clear the snapshot.
+    void Clear();
+
+    /// Return number of agents.
+    unsigned GetNumAgents() const { return agentIds_.Size(); }
+    /// Return number of obstacles.
+    unsigned GetNumObstacles() const { return obstacleIds_.Size(); }
+    /// Return total number of corridor polygons.
+    unsigned GetNumCorridorPolys() const { return corridorPolys_.Size(); }
+
+private:
+    /// Agent node IDs.
+    PODVector<unsigned> agentIds_;
+    /// Agent parent node IDs.
+    PODVector<unsigned> agentParentIds_;
+    /// Agent positions.
+    PODVector<Vector3> positions_;
+    /// Agent actual velocities.
+    PODVector<Vector3> velocities_;
+    /// Agent requested target types.
+    PODVector<unsigned char> targetTypes_;
+    /// Agent target positions, or target velocities for velocity targets.
+    PODVector<Vector3> targets_;
+    /// Agent Detour target polygons, zero when the agent had no path.
+    PODVector<unsigned long long> targetRefs_;
+    /// Agent corridor starts in the corridor polygons, and the total as the last element. The corridor of agent i ends at the
+    /// start of agent i + 1.
+    PODVector<unsigned> corridorStarts_;
+    /// Corridor polygons of all agents, as Detour polygon references.
+    PODVector<unsigned long long> corridorPolys_;
+    /// Obstacle node IDs.
+    PODVector<unsigned> obstacleIds_;
+    /// Obstacle parent node IDs.
+    PODVector<unsigned> obstacleParentIds_;
+    /// Obstacle node positions.
+    PODVector<Vector3> obstaclePositions_;
+    /// Obstacle node rotations.
+    PODVector<Quaternion> obstacleRotations_;
+    /// Obstacle node scales.
+    PODVector<Vector3> obstacleScales_;
+    /// Obstacle radii and heights.
+    PODVector<Vector2> obstacleSizes_;
+};
+
+#endif //URHO3DSAMPLES_CROWDSNAPSHOT_H
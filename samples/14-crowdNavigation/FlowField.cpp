@@ -0,0 +1,419 @@
+//
+// Created by AICDG on 2017/10/22.
+//
+
+#include <Urho3D/Container/Swap.h>
+#include <Urho3D/Navigation/NavigationEvents.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+#include <Urho3D/Scene/Node.h>
+
+#include <Detour/DetourNavMesh.h>
+
+#include "FlowField.h"
+
+/// Maximum number of cached target fields.
+static const unsigned MAX_CACHED_FIELDS = 4;
+/// Number of updates the area of an added or removed obstacle is re-sampled. The tile cache rebuilds the touched tiles over the
+/// following frames.
+static const unsigned OBSTACLE_SETTLE_UPDATES = 8;
+/// Cell offsets of the neighbors, straight ones first.
+static const int NEIGHBOR_OFFSETS[8][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 }, { 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 } };
+/// Walking distances to the neighbors in tenths of a cell.
+static const unsigned NEIGHBOR_COSTS[8] = { 10, 10, 10, 10, 14, 14, 14, 14 };
+
+FlowField::FlowField(Context* context) :
+    Object(context),
+    origin_(Vector3::ZERO),
+    size_(IntVector2::ZERO),
+    cellSize_(1.0f),
+    sampleHeight_(0.0f),
+    sampleRange_(2.0f),
+    currentField_(M_MAX_UNSIGNED),
+    target_(Vector3::ZERO),
+    updateNumber_(0)
+{
+}
+
+void FlowField::SetNavigationMesh(NavigationMesh* navMesh)
+{
+    if (navMesh_)
+    {
+        UnsubscribeFromEvent(navMesh_, E_NAVIGATION_MESH_REBUILT);
+        UnsubscribeFromEvent(navMesh_, E_NAVIGATION_ALL_TILES_REMOVED);
+        UnsubscribeFromEvent(navMesh_, E_NAVIGATION_AREA_REBUILT);
+        UnsubscribeFromEvent(navMesh_, E_NAVIGATION_TILE_ADDED);
+        UnsubscribeFromEvent(navMesh_, E_NAVIGATION_TILE_REMOVED);
+        UnsubscribeFromEvent(navMesh_, E_NAVIGATION_OBSTACLE_ADDED);
+        UnsubscribeFromEvent(navMesh_, E_NAVIGATION_OBSTACLE_REMOVED);
+    }
+
+    navMesh_ = navMesh;
+    fields_.Clear();
+    currentField_ = M_MAX_UNSIGNED;
+    dirtyAreas_.Clear();
+    walkable_.Clear();
+    size_ = IntVector2::ZERO;
+    if (!navMesh_)
+        return;
+
+    // Cover the navigation mesh bounding box, including the tiles that are not loaded
+    const BoundingBox boundingBox = navMesh_->GetWorldBoundingBox();
+    origin_ = boundingBox.min_;
+    size_.x_ = Max((int)ceilf((boundingBox.max_.x_ - boundingBox.min_.x_) / cellSize_), 1);
+    size_.y_ = Max((int)ceilf((boundingBox.max_.z_ - boundingBox.min_.z_) / cellSize_), 1);
+    walkable_.Resize((unsigned)(size_.x_ * size_.y_));
+    for (unsigned i = 0; i < walkable_.Size(); ++i)
+        walkable_[i] = 0;
+
+    PODVector<unsigned> openedCells;
+    bool blocked = false;
+    SampleArea(boundingBox, openedCells, blocked);
+
+    SubscribeToEvent(navMesh_, E_NAVIGATION_MESH_REBUILT, URHO3D_HANDLER(FlowField, HandleNavigationMeshRebuilt));
+    SubscribeToEvent(navMesh_, E_NAVIGATION_ALL_TILES_REMOVED, URHO3D_HANDLER(FlowField, HandleNavigationMeshRebuilt));
+    SubscribeToEvent(navMesh_, E_NAVIGATION_AREA_REBUILT, URHO3D_HANDLER(FlowField, HandleNavigationAreaRebuilt));
+    SubscribeToEvent(navMesh_, E_NAVIGATION_TILE_ADDED, URHO3D_HANDLER(FlowField, HandleNavigationTileChanged));
+    SubscribeToEvent(navMesh_, E_NAVIGATION_TILE_REMOVED, URHO3D_HANDLER(FlowField, HandleNavigationTileChanged));
+    SubscribeToEvent(navMesh_, E_NAVIGATION_OBSTACLE_ADDED, URHO3D_HANDLER(FlowField, HandleObstacleChanged));
+    SubscribeToEvent(navMesh_, E_NAVIGATION_OBSTACLE_REMOVED, URHO3D_HANDLER(FlowField, HandleObstacleChanged));
+}
+
+void FlowField::SetCellSize(float cellSize)
+{
+    cellSize_ = Max(cellSize, 0.1f);
+}
+
+void FlowField::SetSampleHeight(float height, float range)
+{
+    sampleHeight_ = height;
+    sampleRange_ = Max(range, 0.0f);
+}
+
+void FlowField::SetTarget(const Vector3& target)
+{
+    target_ = target;
+    const unsigned targetCell = GetCellIndex(target);
+    if (targetCell == M_MAX_UNSIGNED)
+    {
+        currentField_ = M_MAX_UNSIGNED;
+        return;
+    }
+
+    // Use the cached field of the same target cell, or replace the least recently used one
+    unsigned fieldIndex = M_MAX_UNSIGNED;
+    for (unsigned i = 0; i < fields_.Size(); ++i)
+    {
+        if (fields_[i].targetCell_ == targetCell)
+        {
+            fieldIndex = i;
+            break;
+        }
+        if (fieldIndex == M_MAX_UNSIGNED || fields_[i].lastUsed_ < fields_[fieldIndex].lastUsed_)
+            fieldIndex = i;
+    }
+
+    if (fieldIndex == M_MAX_UNSIGNED || fields_[fieldIndex].targetCell_ != targetCell)
+    {
+        if (fields_.Size() < MAX_CACHED_FIELDS)
+        {
+            fieldIndex = fields_.Size();
+            fields_.Resize(fields_.Size() + 1);
+        }
+        fields_[fieldIndex].targetCell_ = targetCell;
+        fields_[fieldIndex].dirty_ = true;
+    }
+
+    TargetField& field = fields_[fieldIndex];
+    field.lastUsed_ = updateNumber_;
+    if (field.dirty_)
+        Integrate(field);
+    currentField_ = fieldIndex;
+}
+
+void FlowField::ClearTarget()
+{
+    currentField_ = M_MAX_UNSIGNED;
+}
+
+void FlowField::Update()
+{
+    ++updateNumber_;
+    if (!navMesh_ || dirtyAreas_.Empty())
+        return;
+
+    PODVector<unsigned> openedCells;
+    bool blocked = false;
+    for (unsigned i = 0; i < dirtyAreas_.Size();)
+    {
+        SampleArea(dirtyAreas_[i].area_, openedCells, blocked);
+        if (--dirtyAreas_[i].updatesLeft_)
+            ++i;
+        else
+            dirtyAreas_.Erase(i);
+    }
+
+    // Blocked cells may cut off the routes through them, so the fields are integrated again. Opened cells can only shorten the
+    // routes, which relaxing them into the fields takes care of
+    for (unsigned i = 0; i < fields_.Size(); ++i)
+    {
+        if (blocked)
+            fields_[i].dirty_ = true;
+        else if (!openedCells.Empty() && !fields_[i].dirty_)
+            Relax(fields_[i], openedCells);
+    }
+
+    // Repair the current target's field right away, the others once they are used again
+    if (HasTarget() && fields_[currentField_].dirty_)
+        Integrate(fields_[currentField_]);
+}
+
+Vector3 FlowField::GetDirection(const Vector3& position) const
+{
+    const unsigned cell = GetCellIndex(position);
+    if (!HasTarget() || cell == M_MAX_UNSIGNED)
+        return Vector3::ZERO;
+
+    const TargetField& field = fields_[currentField_];
+    if (cell == field.targetCell_)
+        return Vector3(target_.x_ - position.x_, 0.0f, target_.z_ - position.z_).Normalized();
+
+    // Head for the neighbor closest to the target. A cell next to an obstacle may sample as blocked although the agent stands
+    // on it, so its neighbors are still looked at
+    const int x = cell % size_.x_;
+    const int z = cell / size_.x_;
+    unsigned bestCost = field.costs_[cell];
+    unsigned bestCell = M_MAX_UNSIGNED;
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        const int nx = x + NEIGHBOR_OFFSETS[i][0];
+        const int nz = z + NEIGHBOR_OFFSETS[i][1];
+        if (nx < 0 || nz < 0 || nx >= size_.x_ || nz >= size_.y_)
+            continue;
+        const unsigned neighbor = (unsigned)(nz * size_.x_ + nx);
+        if (field.costs_[neighbor] < bestCost)
+        {
+            bestCost = field.costs_[neighbor];
+            bestCell = neighbor;
+        }
+    }
+    if (bestCell == M_MAX_UNSIGNED)
+        return Vector3::ZERO;
+
+    const Vector3 center = GetCellCenter(bestCell);
+    return Vector3(center.x_ - position.x_, 0.0f, center.z_ - position.z_).Normalized();
+}
+
+float FlowField::GetDistance(const Vector3& position) const
+{
+    const unsigned cell = GetCellIndex(position);
+    if (!HasTarget() || cell == M_MAX_UNSIGNED || fields_[currentField_].costs_[cell] == M_MAX_UNSIGNED)
+        return M_INFINITY;
+    return fields_[currentField_].costs_[cell] * cellSize_ * 0.1f;
+}
+
+void FlowField::SampleArea(const BoundingBox& area, PODVector<unsigned>& openedCells, bool& blocked)
+{
+    const int beginX = Max((int)floorf((area.min_.x_ - origin_.x_) / cellSize_), 0);
+    const int beginZ = Max((int)floorf((area.min_.z_ - origin_.z_) / cellSize_), 0);
+    const int endX = Min((int)floorf((area.max_.x_ - origin_.x_) / cellSize_), size_.x_ - 1);
+    const int endZ = Min((int)floorf((area.max_.z_ - origin_.z_) / cellSize_), size_.y_ - 1);
+
+    // A cell is walkable if the navigation mesh reaches within a quarter cell of its center
+    const Vector3 extents(cellSize_ * 0.25f, sampleRange_, cellSize_ * 0.25f);
+    for (int z = beginZ; z <= endZ; ++z)
+        for (int x = beginX; x <= endX; ++x)
+        {
+            const unsigned cell = (unsigned)(z * size_.x_ + x);
+            dtPolyRef polyRef = 0;
+            navMesh_->FindNearestPoint(GetCellCenter(cell), extents, 0, &polyRef);
+            const unsigned char walkable = polyRef ? 1 : 0;
+            if (walkable == walkable_[cell])
+                continue;
+
+            walkable_[cell] = walkable;
+            if (walkable)
+                openedCells.Push(cell);
+            else
+                blocked = true;
+        }
+}
+
+void FlowField::Integrate(TargetField& field)
+{
+    field.costs_.Resize(walkable_.Size());
+    for (unsigned i = 0; i < field.costs_.Size(); ++i)
+        field.costs_[i] = M_MAX_UNSIGNED;
+    field.dirty_ = false;
+
+    // The target cell is the source even if it samples as blocked, the target itself is on the navigation mesh
+    queue_.Clear();
+    field.costs_[field.targetCell_] = 0;
+    PushCell(0, field.targetCell_);
+    Propagate(field);
+}
+
+void FlowField::Relax(TargetField& field, const PODVector<unsigned>& openedCells)
+{
+    // Give each opened cell the cost through its cheapest neighbor, then propagate the decreases
+    queue_.Clear();
+    for (unsigned i = 0; i < openedCells.Size(); ++i)
+    {
+        const unsigned cell = openedCells[i];
+        const int x = cell % size_.x_;
+        const int z = cell / size_.x_;
+        unsigned bestCost = field.costs_[cell];
+        for (unsigned j = 0; j < 8; ++j)
+        {
+            const int nx = x + NEIGHBOR_OFFSETS[j][0];
+            const int nz = z + NEIGHBOR_OFFSETS[j][1];
+            if (nx < 0 || nz < 0 || nx >= size_.x_ || nz >= size_.y_)
+                continue;
+            // Do not cut corners
+            if (j >= 4 && (!walkable_[z * size_.x_ + nx] || !walkable_[nz * size_.x_ + x]))
+                continue;
+            const unsigned neighborCost = field.costs_[nz * size_.x_ + nx];
+            if (neighborCost != M_MAX_UNSIGNED && neighborCost + NEIGHBOR_COSTS[j] < bestCost)
+                bestCost = neighborCost + NEIGHBOR_COSTS[j];
+        }
+
+        if (bestCost < field.costs_[cell])
+        {
+            field.costs_[cell] = bestCost;
+            PushCell(bestCost, cell);
+        }
+    }
+    Propagate(field);
+}
+
+void FlowField::Propagate(TargetField& field)
+{
+    while (!queue_.Empty())
+    {
+        const CostEntry entry = PopCell();
+        // Skip cells queued again with a lower cost since
+        if (entry.cost_ != field.costs_[entry.index_])
+            continue;
+
+        const int x = entry.index_ % size_.x_;
+        const int z = entry.index_ / size_.x_;
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            const int nx = x + NEIGHBOR_OFFSETS[i][0];
+            const int nz = z + NEIGHBOR_OFFSETS[i][1];
+            if (nx < 0 || nz < 0 || nx >= size_.x_ || nz >= size_.y_)
+                continue;
+            const unsigned neighbor = (unsigned)(nz * size_.x_ + nx);
+            if (!walkable_[neighbor])
+                continue;
+            // Do not cut corners
+            if (i >= 4 && (!walkable_[z * size_.x_ + nx] || !walkable_[nz * size_.x_ + x]))
+                continue;
+
+            const unsigned cost = entry.cost_ + NEIGHBOR_COSTS[i];
+            if (cost < field.costs_[neighbor])
+            {
+                field.costs_[neighbor] = cost;
+                PushCell(cost, neighbor);
+            }
+        }
+    }
+}
+
+void FlowField::PushCell(unsigned cost, unsigned index)
+{
+    CostEntry entry;
+    entry.cost_ = cost;
+    entry.index_ = index;
+    queue_.Push(entry);
+
+    // Sift up
+    unsigned i = queue_.Size() - 1;
+    while (i)
+    {
+        const unsigned parent = (i - 1) / 2;
+        if (queue_[parent].cost_ <= queue_[i].cost_)
+            break;
+        Swap(queue_[parent], queue_[i]);
+        i = parent;
+    }
+}
+
+FlowField::CostEntry FlowField::PopCell()
+{
+    const CostEntry top = queue_.Front();
+    queue_.Front() = queue_.Back();
+    queue_.Pop();
+
+    // Sift down
+    unsigned i = 0;
+    for (;;)
+    {
+        const unsigned left = 2 * i + 1;
+        const unsigned right = left + 1;
+        unsigned smallest = i;
+        if (left < queue_.Size() && queue_[left].cost_ < queue_[smallest].cost_)
+            smallest = left;
+        if (right < queue_.Size() && queue_[right].cost_ < queue_[smallest].cost_)
+            smallest = right;
+        if (smallest == i)
+            break;
+        Swap(queue_[smallest], queue_[i]);
+        i = smallest;
+    }
+
+    return top;
+}
+
+void FlowField::QueueArea(const BoundingBox& area, unsigned updates)
+{
+    // Include the cells the area only touches
+    DirtyArea dirtyArea;
+    dirtyArea.area_ = BoundingBox(area.min_ - Vector3(cellSize_, 0.0f, cellSize_), area.max_ + Vector3(cellSize_, 0.0f, cellSize_));
+    dirtyArea.updatesLeft_ = updates;
+    dirtyAreas_.Push(dirtyArea);
+}
+
+unsigned FlowField::GetCellIndex(const Vector3& position) const
+{
+    const int x = (int)floorf((position.x_ - origin_.x_) / cellSize_);
+    const int z = (int)floorf((position.z_ - origin_.z_) / cellSize_);
+    if (x < 0 || z < 0 || x >= size_.x_ || z >= size_.y_)
+        return M_MAX_UNSIGNED;
+    return (unsigned)(z * size_.x_ + x);
+}
+
+Vector3 FlowField::GetCellCenter(unsigned index) const
+{
+    return Vector3(origin_.x_ + ((index % size_.x_) + 0.5f) * cellSize_, sampleHeight_,
+        origin_.z_ + ((index / size_.x_) + 0.5f) * cellSize_);
+}
+
+void FlowField::HandleNavigationMeshRebuilt(StringHash eventType, VariantMap& eventData)
+{
+    QueueArea(navMesh_->GetWorldBoundingBox(), 1);
+}
+
+void FlowField::HandleNavigationAreaRebuilt(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NavigationAreaRebuilt;
+
+    QueueArea(BoundingBox(eventData[P_BOUNDSMIN].GetVector3(), eventData[P_BOUNDSMAX].GetVector3()), 1);
+}
+
+void FlowField::HandleNavigationTileChanged(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NavigationTileAdded;
+
+    const BoundingBox tileBox = navMesh_->GetTileBoundingBox(eventData[P_TILE].GetIntVector2());
+    QueueArea(tileBox.Transformed(navMesh_->GetNode()->GetWorldTransform()), 1);
+}
+
+void FlowField::HandleObstacleChanged(StringHash eventType, VariantMap& eventData)
+{
+    using namespace NavigationObstacleAdded;
+
+    const Vector3 position = eventData[P_POSITION].GetVector3();
+    const float radius = eventData[P_RADIUS].GetFloat();
+    QueueArea(BoundingBox(position - Vector3(radius, 0.0f, radius), position + Vector3(radius, 0.0f, radius)),
+        OBSTACLE_SETTLE_UPDATES);
+}
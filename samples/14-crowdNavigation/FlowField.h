@@ -0,0 +1,147 @@
+//
+// Created by AICDG on 2017/10/22.
+//
+
+#ifndef URHO3DSAMPLES_FLOWFIELD_H
+#define URHO3DSAMPLES_FLOWFIELD_H
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/BoundingBox.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+}
+
+using namespace Urho3D;
+
+/// Flow field over the loaded navigation mesh tiles, for steering any number of agents to a shared target. The navigation mesh
+/// is sampled into a grid of walkable cells once, and per target an integration field of walking distances to the target is
+/// computed over the grid. Agents then steer by sampling the field instead of planning a path each. The fields of the last few
+/// targets are cached. Tile and obstacle changes re-sample only the affected cells: newly opened cells are relaxed into the
+/// cached fields, and fields that lose cells are integrated again.
+class FlowField : public Object
+{
+    URHO3D_OBJECT(FlowField, Object);
+
+public:
+    /// Construct.
+    FlowField(Context* context);
+
+    /// Set the navigation mesh and sample the grid over its bounding box. Forgets the cached fields.
+    void SetNavigationMesh(NavigationMesh* navMesh);
+    /// Set grid cell size. Takes effect when the navigation mesh is next set.
+    void SetCellSize(float cellSize);
+    /// Set height of the walkable layer the grid samples, and the height range around it. The grid covers one layer only.
+    void SetSampleHeight(float height, float range);
+    /// Set the target, computing its integration field unless it is cached.
+    void SetTarget(const Vector3& target);
+    /// Clear the target.
+    void ClearTarget();
+    /// Re-sample the changed cells and repair the fields. Call once per frame.
+    void Update();
+
+    /// Return the steering direction toward the target at a position, or zero if the target can not be reached from there.
+    Vector3 GetDirection(const Vector3& position) const;
+    /// Return the walking distance to the target from a position, or infinity if the target can not be reached from there.
+    float GetDistance(const Vector3& position) const;
+    /// Return whether a target is set.
+    bool HasTarget() const { return currentField_ < fields_.Size(); }
+    /// Return the target.
+    const Vector3& GetTarget() const { return target_; }
+    /// Return number of grid cells.
+    unsigned GetNumCells() const { return walkable_.Size(); }
+    /// Return number of cached fields.
+    unsigned GetNumCachedFields() const { return fields_.Size(); }
+
+private:
+    /// Integration field of one target.
+    struct TargetField
+    {
+        /// Target cell index.
+        unsigned targetCell_;
+        /// Walking distance of each cell to the target, in tenths of a cell. M_MAX_UNSIGNED if unreachable.
+        PODVector<unsigned> costs_;
+        /// Whether cells have been blocked since the field was integrated.
+        bool dirty_;
+        /// Last time the field was used as the target.
+        unsigned lastUsed_;
+    };
+
+    /// Cell in the integration queue.
+    struct CostEntry
+    {
+        /// Walking distance to the target.
+        unsigned cost_;
+        /// Cell index.
+        unsigned index_;
+    };
+
+    /// Area to re-sample.
+    struct DirtyArea
+    {
+        /// Area in world space.
+        BoundingBox area_;
+        /// Number of updates the area is still re-sampled, to catch the navigation mesh tiles rebuilt over several frames.
+        unsigned updatesLeft_;
+    };
+
+    /// Sample the walkability of the cells in an area. Collect the cells that changed.
+    void SampleArea(const BoundingBox& area, PODVector<unsigned>& openedCells, bool& blocked);
+    /// Integrate a field from its target.
+    void Integrate(TargetField& field);
+    /// Relax newly opened cells into a field.
+    void Relax(TargetField& field, const PODVector<unsigned>& openedCells);
+    /// Propagate costs from the queued cells.
+    void Propagate(TargetField& field);
+    /// Queue a cell for propagation.
+    void PushCell(unsigned cost, unsigned index);
+    /// Take the queued cell with the lowest cost.
+    CostEntry PopCell();
+    /// Queue an area for re-sampling.
+    void QueueArea(const BoundingBox& area, unsigned updates);
+    /// Return the cell index of a position, or M_MAX_UNSIGNED if outside the grid.
+    unsigned GetCellIndex(const Vector3& position) const;
+    /// Return the cell center.
+    Vector3 GetCellCenter(unsigned index) const;
+
+    /// Handle a navigation mesh rebuild.
+    void HandleNavigationMeshRebuilt(StringHash eventType, VariantMap& eventData);
+    /// Handle a partial navigation mesh rebuild.
+    void HandleNavigationAreaRebuilt(StringHash eventType, VariantMap& eventData);
+    /// Handle a tile being added or removed.
+    void HandleNavigationTileChanged(StringHash eventType, VariantMap& eventData);
+    /// Handle an obstacle being added or removed.
+    void HandleObstacleChanged(StringHash eventType, VariantMap& eventData);
+
+    /// Navigation mesh.
+    WeakPtr<NavigationMesh> navMesh_;
+    /// Grid origin in world space.
+    Vector3 origin_;
+    /// Grid size in cells.
+    IntVector2 size_;
+    /// Cell size.
+    float cellSize_;
+    /// Sampled layer height.
+    float sampleHeight_;
+    /// Sampled height range.
+    float sampleRange_;
+    /// Walkability of each cell.
+    PODVector<unsigned char> walkable_;
+    /// Cached fields.
+    Vector<TargetField> fields_;
+    /// Index of the current target's field.
+    unsigned currentField_;
+    /// Current target.
+    Vector3 target_;
+    /// Areas to re-sample.
+    PODVector<DirtyArea> dirtyAreas_;
+    /// Integration queue as a binary heap.
+    PODVector<CostEntry> queue_;
+    /// Update counter.
+    unsigned updateNumber_;
+};
+
+#endif //URHO3DSAMPLES_FLOWFIELD_H
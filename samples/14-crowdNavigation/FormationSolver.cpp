@@ -0,0 +1,246 @@
+//
+// Created by AICDG on 2017/10/21.
+//
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+
+#include <Detour/DetourNavMesh.h>
+
+#include "FormationSolver.h"
+
+/// Maximum number of polygons visited when checking that a slot is reachable from the target.
+static const int MAX_SLOT_VISITED_POLYS = 32;
+/// Number of times the slot candidates are extended when too many of them are dropped.
+static const unsigned MAX_CANDIDATE_ROUNDS = 3;
+static IntVector2 GetSlotCell(const Vector3& position, float cellSize)
+{
+    return IntVector2((int)floorf(position.x_ / cellSize), (int)floorf(position.z_ / cellSize));
+}
+
+FormationSolver::FormationSolver() :
+    shape_(FORMATION_CIRCLE),
+    gap_(0.5f)
+{
+}
+
+void FormationSolver::SetShape(FormationShape shape)
+{
+    shape_ = shape;
+}
+
+void FormationSolver::SetGap(float gap)
+{
+    gap_ = Max(gap, 0.0f);
+}
+
+unsigned FormationSolver::Solve(NavigationMesh* navMesh, const Vector3& target, const PODVector<Vector3>& positions,
+    float agentRadius, PODVector<Vector3>& dest)
+{
+    const unsigned numAgents = positions.Size();
+    dest.Resize(numAgents);
+    slots_.Clear();
+    if (!numAgents)
+        return 0;
+
+    // Face the formation from the group toward the target
+    Vector3 center;
+    for (unsigned i = 0; i < numAgents; ++i)
+        center += positions[i];
+    center /= (float)numAgents;
+    Vector3 forward = Vector3(target.x_ - center.x_, 0.0f, target.z_ - center.z_).Normalized();
+    if (forward == Vector3::ZERO)
+        forward = Vector3::FORWARD;
+    const Vector3 right = Vector3::UP.CrossProduct(forward);
+
+    const float spacing = 2.0f * agentRadius + gap_;
+    const float minSeparation = 2.0f * agentRadius;
+    const Vector3 extents(spacing * 0.5f, 2.0f, spacing * 0.5f);
+
+    // Snap the slot candidates to the navigation mesh in one pass, extending the candidates if too many are dropped. The
+    // accepted slots are bucketed by cells of the slot spacing, so the overlap test only looks at the neighboring cells
+    HashMap<IntVector2, PODVector<unsigned> > slotCells;
+    unsigned numCandidates = numAgents + numAgents / 2 + 8;
+    unsigned processed = 0;
+    for (unsigned round = 0; round < MAX_CANDIDATE_ROUNDS && slots_.Size() < numAgents; ++round)
+    {
+        GenerateCandidates(numAgents, numCandidates, spacing);
+        for (; processed < candidates_.Size() && slots_.Size() < numAgents; ++processed)
+        {
+            const Vector3& candidate = candidates_[processed];
+            dtPolyRef polyRef = 0;
+            const Vector3 slot = navMesh->FindNearestPoint(target + right * candidate.x_ + forward * candidate.z_, extents, 0,
+                &polyRef);
+            if (!polyRef)
+                continue;
+
+            // Drop slots that can not be walked to straight from the target, eg. behind an obstacle
+            const Vector3 reached = navMesh->MoveAlongSurface(target, slot, extents, MAX_SLOT_VISITED_POLYS);
+            if ((reached - slot).LengthSquared() > agentRadius * agentRadius)
+                continue;
+
+            // Drop slots that snapping has pushed onto another slot
+            const IntVector2 cell = GetSlotCell(slot, spacing);
+            bool overlaps = false;
+            for (int z = cell.y_ - 1; z <= cell.y_ + 1 && !overlaps; ++z)
+                for (int x = cell.x_ - 1; x <= cell.x_ + 1 && !overlaps; ++x)
+                {
+                    HashMap<IntVector2, PODVector<unsigned> >::ConstIterator i = slotCells.Find(IntVector2(x, z));
+                    if (i == slotCells.End())
+                        continue;
+                    for (unsigned j = 0; j < i->second_.Size(); ++j)
+                    {
+                        if ((slots_[i->second_[j]] - slot).LengthSquared() < minSeparation * minSeparation)
+                        {
+                            overlaps = true;
+                            break;
+                        }
+                    }
+                }
+            if (overlaps)
+                continue;
+
+            slotCells[cell].Push(slots_.Size());
+            slots_.Push(slot);
+        }
+        numCandidates *= 2;
+    }
+
+    // Give the slots to the agents with the least total walking distance, with the Hungarian algorithm over the slot to agent
+    // distances. Two walks that cross can always be shortened by swapping their slots, so the minimum has no crossing walks.
+    // The slots are at most as many as the agents, and the agents left over are sent to the target
+    const unsigned numSlots = slots_.Size();
+    costs_.Resize(numSlots * numAgents);
+    for (unsigned i = 0; i < numSlots; ++i)
+        for (unsigned j = 0; j < numAgents; ++j)
+            costs_[i * numAgents + j] = (slots_[i] - positions[j]).Length();
+
+    // Slot and agent potentials, the slot matched to each agent and the search tree, with index 0 as a virtual agent and slot
+    // indices starting from 1
+    PODVector<float> slotPotentials;
+    PODVector<float> agentPotentials;
+    PODVector<unsigned> agentSlots;
+    PODVector<unsigned> previousAgents;
+    PODVector<float> minSlack;
+    PODVector<bool> visited;
+    slotPotentials.Resize(numSlots + 1);
+    agentPotentials.Resize(numAgents + 1);
+    agentSlots.Resize(numAgents + 1);
+    previousAgents.Resize(numAgents + 1);
+    minSlack.Resize(numAgents + 1);
+    visited.Resize(numAgents + 1);
+    for (unsigned i = 0; i <= numSlots; ++i)
+        slotPotentials[i] = 0.0f;
+    for (unsigned j = 0; j <= numAgents; ++j)
+    {
+        agentPotentials[j] = 0.0f;
+        agentSlots[j] = 0;
+        previousAgents[j] = 0;
+    }
+    for (unsigned i = 1; i <= numSlots; ++i)
+    {
+        // Grow an alternating path from slot i until it reaches a free agent, then flip the matching along it
+        agentSlots[0] = i;
+        unsigned agent = 0;
+        for (unsigned j = 0; j <= numAgents; ++j)
+        {
+            minSlack[j] = M_INFINITY;
+            visited[j] = false;
+        }
+
+        do
+        {
+            visited[agent] = true;
+            const unsigned slot = agentSlots[agent];
+            float delta = M_INFINITY;
+            unsigned nextAgent = 0;
+            for (unsigned j = 1; j <= numAgents; ++j)
+            {
+                if (visited[j])
+                    continue;
+                const float slack = costs_[(slot - 1) * numAgents + j - 1] - slotPotentials[slot] - agentPotentials[j];
+                if (slack < minSlack[j])
+                {
+                    minSlack[j] = slack;
+                    previousAgents[j] = agent;
+                }
+                if (minSlack[j] < delta)
+                {
+                    delta = minSlack[j];
+                    nextAgent = j;
+                }
+            }
+
+            for (unsigned j = 0; j <= numAgents; ++j)
+            {
+                if (visited[j])
+                {
+                    slotPotentials[agentSlots[j]] += delta;
+                    agentPotentials[j] -= delta;
+                }
+                else
+                    minSlack[j] -= delta;
+            }
+            agent = nextAgent;
+        } while (agentSlots[agent]);
+
+        do
+        {
+            const unsigned previousAgent = previousAgents[agent];
+            agentSlots[agent] = agentSlots[previousAgent];
+            agent = previousAgent;
+        } while (agent);
+    }
+
+    for (unsigned j = 1; j <= numAgents; ++j)
+        dest[j - 1] = agentSlots[j] ? slots_[agentSlots[j] - 1] : target;
+
+    return slots_.Size();
+}
+
+void FormationSolver::GenerateCandidates(unsigned numAgents, unsigned count, float spacing)
+{
+    candidates_.Clear();
+
+    switch (shape_)
+    {
+    case FORMATION_GRID:
+        {
+            // Square grid sized for the group, extended with more rows at the back for the extra candidates
+            const unsigned columns = Max((unsigned)ceilf(sqrtf((float)numAgents)), 1U);
+            const unsigned rows = (numAgents + columns - 1) / columns;
+            for (unsigned i = 0; i < count; ++i)
+            {
+                const float x = ((float)(i % columns) - (columns - 1) * 0.5f) * spacing;
+                const float z = ((rows - 1) * 0.5f - (float)(i / columns)) * spacing;
+                candidates_.Push(Vector3(x, 0.0f, z));
+            }
+        }
+        break;
+
+    case FORMATION_WEDGE:
+        // Row r behind the tip has r + 1 slots
+        for (unsigned row = 0; candidates_.Size() < count; ++row)
+        {
+            for (unsigned i = 0; i <= row && candidates_.Size() < count; ++i)
+                candidates_.Push(Vector3(((float)i - row * 0.5f) * spacing, 0.0f, -(float)row * spacing));
+        }
+        break;
+
+    default:
+        // Target, then rings one spacing apart with as many slots as fit on each, every other ring rotated by half a slot
+        candidates_.Push(Vector3::ZERO);
+        for (unsigned ring = 1; candidates_.Size() < count; ++ring)
+        {
+            const float radius = ring * spacing;
+            const unsigned numSlots = (unsigned)(2.0f * M_PI * ring);
+            const float offset = (ring & 1) ? 180.0f / numSlots : 0.0f;
+            for (unsigned i = 0; i < numSlots && candidates_.Size() < count; ++i)
+            {
+                const float angle = offset + 360.0f * i / numSlots;
+                candidates_.Push(Vector3(Sin(angle) * radius, 0.0f, Cos(angle) * radius));
+            }
+        }
+        break;
+    }
+}
@@ -0,0 +1,72 @@
+//
+// Created by AICDG on 2017/10/21.
+//
+
+#ifndef URHO3DSAMPLES_FORMATIONSOLVER_H
+#define URHO3DSAMPLES_FORMATIONSOLVER_H
+
+#include <Urho3D/Container/Vector.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+}
+
+using namespace Urho3D;
+
+/// Formation shape.
+enum FormationShape
+{
+    /// Concentric rings around the target.
+    FORMATION_CIRCLE = 0,
+    /// Square grid centered on the target.
+    FORMATION_GRID,
+    /// Widening rows behind the target, which is the tip.
+    FORMATION_WEDGE,
+    MAX_FORMATIONSHAPES
+};
+
+/// Computes the target slots of a group order. The slots of a formation shape, facing from the group toward the target, are
+/// snapped to the navigation mesh in one pass. Slots off the mesh, cut off from the target or overlapping other slots are
+/// dropped. The slots are then assigned to the agents by minimum total travel distance, which leaves no crossing walks. The
+/// assignment takes cubic time in the group size, which is fine for the groups a player orders around.
+class FormationSolver
+{
+public:
+    /// Construct.
+    FormationSolver();
+
+    /// Set formation shape.
+    void SetShape(FormationShape shape);
+    /// Set gap between the agents in addition to their diameter.
+    void SetGap(float gap);
+    /// Compute the slot of each agent. The slots are in the same order as the positions. Agents left without a slot, if the
+    /// navigation mesh around the target is too cramped, are sent to the target itself. Return number of slots found.
+    unsigned Solve(NavigationMesh* navMesh, const Vector3& target, const PODVector<Vector3>& positions, float agentRadius,
+        PODVector<Vector3>& dest);
+
+    /// Return formation shape.
+    FormationShape GetShape() const { return shape_; }
+    /// Return gap between the agents.
+    float GetGap() const { return gap_; }
+
+private:
+    /// Generate formation slot candidates in the formation's own space, X to the right and Z toward the target.
+    void GenerateCandidates(unsigned numAgents, unsigned count, float spacing);
+
+    /// Formation shape.
+    FormationShape shape_;
+    /// Gap between the agents.
+    float gap_;
+    /// Slot candidates.
+    PODVector<Vector3> candidates_;
+    /// Valid slots.
+    PODVector<Vector3> slots_;
+    /// Distances from the slots to the agents, one row per slot.
+    PODVector<float> costs_;
+};
+
+#endif //URHO3DSAMPLES_FORMATIONSOLVER_H
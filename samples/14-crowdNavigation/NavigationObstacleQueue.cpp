@@ -0,0 +1,131 @@
+//
+// Created by AICDG on 2017/10/24.
+//
+
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "NavigationObstacleQueue.h"
+
+/// Weight of the newest measurement in the averaged costs.
+static const float COST_SMOOTHING = 0.25f;
+
+NavigationObstacleQueue::NavigationObstacleQueue(Context* context) :
+    Object(context),
+    timeBudget_(1000),
+    baseSceneUpdateTime_(0.0f),
+    changeCost_(1000.0f),
+    numUnmeasured_(0),
+    numApplied_(0),
+    lastUpdateTime_(0)
+{
+}
+
+void NavigationObstacleQueue::SetScene(Scene* scene)
+{
+    if (scene_)
+    {
+        UnsubscribeFromEvent(scene_, E_SCENEUPDATE);
+        UnsubscribeFromEvent(scene_, E_SCENEPOSTUPDATE);
+    }
+
+    scene_ = scene;
+    numUnmeasured_ = 0;
+    // The dynamic navigation mesh updates its tile cache in the scene subsystem update, between these two events
+    if (scene_)
+    {
+        SubscribeToEvent(scene_, E_SCENEUPDATE, URHO3D_HANDLER(NavigationObstacleQueue, HandleSceneUpdate));
+        SubscribeToEvent(scene_, E_SCENEPOSTUPDATE, URHO3D_HANDLER(NavigationObstacleQueue, HandleScenePostUpdate));
+    }
+}
+
+void NavigationObstacleQueue::AddNode(Node* node, Node* parent)
+{
+    if (!node || !parent)
+        return;
+
+    ObstacleChange change;
+    change.node_ = node;
+    change.parent_ = parent;
+    change.queuedTime_ = GetSubsystem<Time>()->GetElapsedTime();
+    pending_.Push(change);
+}
+
+void NavigationObstacleQueue::RemoveNode(Node* node)
+{
+    if (!node)
+        return;
+
+    ObstacleChange change;
+    change.node_ = node;
+    change.queuedTime_ = GetSubsystem<Time>()->GetElapsedTime();
+    pending_.Push(change);
+}
+
+void NavigationObstacleQueue::Update()
+{
+    numApplied_ = 0;
+    lastUpdateTime_ = 0;
+    if (pending_.Empty())
+        return;
+
+    // Adding and removing obstacles queues tile cache requests, and rebuilds tiles right away when the request queue of the tile
+    // cache is full, so the time is checked after each change. The layer rebuilds of the applied changes and the next one are
+    // charged at the estimated cost, as they happen later in the scene update
+    HiresTimer timer;
+    while (!pending_.Empty() &&
+        (!numApplied_ || timer.GetUSec(false) + (numApplied_ + 1) * changeCost_ <= (float)timeBudget_))
+    {
+        const ObstacleChange change = pending_.Front();
+        pending_.PopFront();
+        Apply(change);
+        ++numApplied_;
+    }
+    numUnmeasured_ += numApplied_;
+    lastUpdateTime_ = timer.GetUSec(false);
+}
+
+void NavigationObstacleQueue::Clear()
+{
+    pending_.Clear();
+}
+
+void NavigationObstacleQueue::SetTimeBudget(unsigned usec)
+{
+    timeBudget_ = usec;
+}
+
+float NavigationObstacleQueue::GetOldestPendingAge() const
+{
+    if (pending_.Empty())
+        return 0.0f;
+    return GetSubsystem<Time>()->GetElapsedTime() - pending_.Front().queuedTime_;
+}
+
+void NavigationObstacleQueue::Apply(const ObstacleChange& change)
+{
+    if (change.parent_)
+        change.parent_->AddChild(change.node_);
+    else
+        change.node_->Remove();
+}
+
+void NavigationObstacleQueue::HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+{
+    sceneUpdateTimer_.Reset();
+}
+
+void NavigationObstacleQueue::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // The scene update also covers the crowd and the other subsystems. Their cost is learned from the updates without changes
+    // and taken off, the rest is the rebuild cost of the changes
+    const float updateTime = (float)sceneUpdateTimer_.GetUSec(false);
+    if (!numUnmeasured_)
+        baseSceneUpdateTime_ = Lerp(baseSceneUpdateTime_, updateTime, COST_SMOOTHING);
+    else
+    {
+        const float cost = Max(updateTime - baseSceneUpdateTime_, 0.0f) / numUnmeasured_;
+        changeCost_ = Lerp(changeCost_, cost, COST_SMOOTHING);
+        numUnmeasured_ = 0;
+    }
+}
@@ -0,0 +1,104 @@
+//
+// Created by AICDG on 2017/10/24.
+//
+
+#ifndef URHO3DSAMPLES_NAVIGATIONOBSTACLEQUEUE_H
+#define URHO3DSAMPLES_NAVIGATIONOBSTACLEQUEUE_H
+
+#include <Urho3D/Container/List.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+namespace Urho3D
+{
+
+class Node;
+class Scene;
+
+}
+
+using namespace Urho3D;
+
+/// Time-sliced queue of navigation obstacle changes. Obstacles added or removed through the queue reach the dynamic navigation
+/// mesh over several frames, as many per frame as fit in the time budget, so that a mass change such as clearing many props at
+/// once does not rebuild all of their tile cache layers in one frame. Most of the cost of a change is the layer rebuild the
+/// tile cache does later, in the scene update. The queue measures the scene updates that follow its changes against the ones
+/// without, and charges each change with the difference averaged over recent changes. Changes are applied in the order they
+/// were queued. The changes are queued by node: an obstacle joins the tile cache as soon as its node is in the scene, so a new
+/// obstacle node is kept out of the scene until its change is applied.
+class NavigationObstacleQueue : public Object
+{
+    URHO3D_OBJECT(NavigationObstacleQueue, Object);
+
+public:
+    /// Construct.
+    NavigationObstacleQueue(Context* context);
+
+    /// Set the scene whose updates are measured for the rebuild cost of the changes.
+    void SetScene(Scene* scene);
+    /// Queue a node with obstacles, created outside the scene, to be added to a parent node.
+    void AddNode(Node* node, Node* parent);
+    /// Queue a node with obstacles to be removed from the scene.
+    void RemoveNode(Node* node);
+    /// Apply the queued changes within the time budget. Call once per frame.
+    void Update();
+    /// Drop the queued changes, eg. when the scene is reloaded.
+    void Clear();
+
+    /// Set time budget per frame in microseconds, covering applying the changes and their estimated rebuild cost. At least one
+    /// change is applied per frame.
+    void SetTimeBudget(unsigned usec);
+
+    /// Return time budget per frame in microseconds.
+    unsigned GetTimeBudget() const { return timeBudget_; }
+    /// Return estimated rebuild cost of a change in microseconds.
+    float GetChangeCost() const { return changeCost_; }
+    /// Return number of queued changes.
+    unsigned GetNumPending() const { return pending_.Size(); }
+    /// Return age of the oldest queued change in seconds, or zero if the queue is empty.
+    float GetOldestPendingAge() const;
+    /// Return number of changes applied on the last update.
+    unsigned GetNumApplied() const { return numApplied_; }
+    /// Return time spent applying the changes on the last update in microseconds, without the rebuild cost.
+    long long GetLastUpdateTime() const { return lastUpdateTime_; }
+
+private:
+    /// Queued obstacle change.
+    struct ObstacleChange
+    {
+        /// Node to add or remove.
+        SharedPtr<Node> node_;
+        /// Parent node to add to, null if the node is removed.
+        WeakPtr<Node> parent_;
+        /// Elapsed time when the change was queued.
+        float queuedTime_;
+    };
+
+    /// Apply a change.
+    void Apply(const ObstacleChange& change);
+    /// Handle the scene update starting. Start measuring it.
+    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle the scene post-update, which follows the tile cache update. Update the cost estimates.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+
+    /// Queued changes, oldest first.
+    List<ObstacleChange> pending_;
+    /// Time budget in microseconds.
+    unsigned timeBudget_;
+    /// Scene whose updates are measured.
+    WeakPtr<Scene> scene_;
+    /// Timer of the scene update in progress.
+    HiresTimer sceneUpdateTimer_;
+    /// Average scene update time without changes to rebuild, in microseconds.
+    float baseSceneUpdateTime_;
+    /// Average rebuild cost of a change in microseconds.
+    float changeCost_;
+    /// Changes applied since the last measured scene update.
+    unsigned numUnmeasured_;
+    /// Changes applied on the last update.
+    unsigned numApplied_;
+    /// Time spent on the last update in microseconds.
+    long long lastUpdateTime_;
+};
+
+#endif //URHO3DSAMPLES_NAVIGATIONOBSTACLEQUEUE_H
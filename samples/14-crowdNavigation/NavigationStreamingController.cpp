@@ -0,0 +1,150 @@
+//
+// Created by AICDG on 2017/10/23.
+//
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+
+#include "NavigationStreamingController.h"
+
+static bool CompareStreamingTiles(const StreamingTile& lhs, const StreamingTile& rhs)
+{
+    return lhs.distance_ < rhs.distance_;
+}
+
+NavigationStreamingController::NavigationStreamingController() :
+    streamingDistance_(2),
+    clusterRadius_(2),
+    maxTiles_(64),
+    mainFocus_(Vector3::ZERO),
+    updateNumber_(0)
+{
+}
+
+void NavigationStreamingController::SetStreamingDistance(int distance)
+{
+    streamingDistance_ = Max(distance, 0);
+}
+
+void NavigationStreamingController::SetClusterRadius(int radius)
+{
+    clusterRadius_ = Max(radius, 0);
+}
+
+void NavigationStreamingController::SetMaxTiles(unsigned maxTiles)
+{
+    maxTiles_ = Max(maxTiles, 1U);
+}
+
+void NavigationStreamingController::Update(NavigationMesh* navMesh, const PODVector<Vector3>& focuses)
+{
+    ++updateNumber_;
+    clusters_.Clear();
+    wantedTiles_.Clear();
+    missingTiles_.Clear();
+
+    // Cluster the focuses by their tiles. A focus joins the first cluster whose first tile is within the cluster radius, so a
+    // cluster spans at most twice the radius however the focuses are spread
+    const IntVector2 numTiles = navMesh->GetNumTiles();
+    PODVector<IntVector2> seedTiles;
+    for (unsigned i = 0; i < focuses.Size(); ++i)
+    {
+        const IntVector2 tile = VectorMin(VectorMax(IntVector2::ZERO, navMesh->GetTileIndex(focuses[i])),
+            numTiles - IntVector2::ONE);
+        unsigned j = 0;
+        while (j < clusters_.Size() && Max(Abs(tile.x_ - seedTiles[j].x_), Abs(tile.y_ - seedTiles[j].y_)) > clusterRadius_)
+            ++j;
+
+        if (j == clusters_.Size())
+        {
+            FocusCluster cluster;
+            cluster.positionSum_ = Vector3::ZERO;
+            cluster.numFocuses_ = 0;
+            cluster.minTile_ = tile;
+            cluster.maxTile_ = tile;
+            clusters_.Push(cluster);
+            seedTiles.Push(tile);
+        }
+
+        FocusCluster& cluster = clusters_[j];
+        cluster.positionSum_ += focuses[i];
+        ++cluster.numFocuses_;
+        cluster.minTile_ = VectorMin(cluster.minTile_, tile);
+        cluster.maxTile_ = VectorMax(cluster.maxTile_, tile);
+    }
+
+    // Take the union of the cluster windows. Each window covers the tiles of its focuses and the streaming distance around them
+    unsigned largestCluster = 0;
+    for (unsigned i = 0; i < clusters_.Size(); ++i)
+    {
+        const FocusCluster& cluster = clusters_[i];
+        if (cluster.numFocuses_ > clusters_[largestCluster].numFocuses_)
+            largestCluster = i;
+
+        const IntVector2 beginTile = VectorMax(IntVector2::ZERO, cluster.minTile_ - IntVector2::ONE * streamingDistance_);
+        const IntVector2 endTile = VectorMin(cluster.maxTile_ + IntVector2::ONE * streamingDistance_, numTiles - IntVector2::ONE);
+        for (int z = beginTile.y_; z <= endTile.y_; ++z)
+            for (int x = beginTile.x_; x <= endTile.x_; ++x)
+            {
+                const int distance = Max(Max(cluster.minTile_.x_ - x, x - cluster.maxTile_.x_),
+                    Max(cluster.minTile_.y_ - z, z - cluster.maxTile_.y_));
+                HashMap<IntVector2, int>::Iterator j = wantedTiles_.Find(IntVector2(x, z));
+                if (j == wantedTiles_.End())
+                    wantedTiles_[IntVector2(x, z)] = Max(distance, 0);
+                else
+                    j->second_ = Min(j->second_, Max(distance, 0));
+            }
+    }
+    if (!clusters_.Empty())
+        mainFocus_ = clusters_[largestCluster].positionSum_ / (float)clusters_[largestCluster].numFocuses_;
+
+    // Keep the tiles nearest to the focuses within the budget
+    PODVector<StreamingTile> wanted;
+    for (HashMap<IntVector2, int>::ConstIterator i = wantedTiles_.Begin(); i != wantedTiles_.End(); ++i)
+    {
+        StreamingTile tile;
+        tile.tile_ = i->first_;
+        tile.distance_ = i->second_;
+        wanted.Push(tile);
+    }
+    Sort(wanted.Begin(), wanted.End(), CompareStreamingTiles);
+    if (wanted.Size() > maxTiles_)
+        wanted.Resize(maxTiles_);
+
+    for (unsigned i = 0; i < wanted.Size(); ++i)
+    {
+        HashMap<IntVector2, unsigned>::Iterator j = residentTiles_.Find(wanted[i].tile_);
+        if (j != residentTiles_.End())
+            j->second_ = updateNumber_;
+        else
+            missingTiles_.Push(wanted[i]);
+    }
+}
+
+void NavigationStreamingController::AddTile(const IntVector2& tile)
+{
+    residentTiles_[tile] = updateNumber_;
+}
+
+bool NavigationStreamingController::EvictTile(IntVector2& tile)
+{
+    HashMap<IntVector2, unsigned>::Iterator oldest = residentTiles_.End();
+    for (HashMap<IntVector2, unsigned>::Iterator i = residentTiles_.Begin(); i != residentTiles_.End(); ++i)
+    {
+        // Tiles wanted on this update are not evicted
+        if (i->second_ != updateNumber_ && (oldest == residentTiles_.End() || i->second_ < oldest->second_))
+            oldest = i;
+    }
+    if (oldest == residentTiles_.End())
+        return false;
+
+    tile = oldest->first_;
+    residentTiles_.Erase(oldest);
+    return true;
+}
+
+void NavigationStreamingController::Clear()
+{
+    residentTiles_.Clear();
+    missingTiles_.Clear();
+}
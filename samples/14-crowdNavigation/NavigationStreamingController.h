@@ -0,0 +1,107 @@
+//
+// Created by AICDG on 2017/10/23.
+//
+
+#ifndef URHO3DSAMPLES_NAVIGATIONSTREAMINGCONTROLLER_H
+#define URHO3DSAMPLES_NAVIGATIONSTREAMINGCONTROLLER_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Math/Vector3.h>
+
+namespace Urho3D
+{
+
+class NavigationMesh;
+
+}
+
+using namespace Urho3D;
+
+/// Tile wanted by the streaming controller.
+struct StreamingTile
+{
+    /// Tile index.
+    IntVector2 tile_;
+    /// Distance in tiles to the nearest tile with a focus on it.
+    int distance_;
+};
+
+/// Multi-focus navigation mesh streaming controller. Clusters the focus positions, e.g. agents and cameras, and keeps the union
+/// of a streaming window per cluster resident, so that split groups each keep the tiles under them. The resident tiles are held
+/// within a fixed budget, which should match the maximum tiles given to NavigationMesh::Allocate(). Tiles that leave the windows
+/// stay resident until the budget needs room, and are then evicted least recently wanted first.
+class NavigationStreamingController
+{
+public:
+    /// Construct.
+    NavigationStreamingController();
+
+    /// Set the streaming distance in tiles around each cluster.
+    void SetStreamingDistance(int distance);
+    /// Set the cluster radius in tiles. Focuses farther apart than this start separate clusters.
+    void SetClusterRadius(int radius);
+    /// Set maximum number of resident tiles.
+    void SetMaxTiles(unsigned maxTiles);
+    /// Cluster the focus positions and collect the wanted tiles, nearest to the focuses first. Call once per frame.
+    void Update(NavigationMesh* navMesh, const PODVector<Vector3>& focuses);
+    /// Record a tile as added to the navigation mesh.
+    void AddTile(const IntVector2& tile);
+    /// Choose the least recently wanted tile outside the windows for removal and forget it. Return false if there is none.
+    bool EvictTile(IntVector2& tile);
+    /// Forget all resident tiles.
+    void Clear();
+
+    /// Return the streaming distance in tiles.
+    int GetStreamingDistance() const { return streamingDistance_; }
+    /// Return the cluster radius in tiles.
+    int GetClusterRadius() const { return clusterRadius_; }
+    /// Return maximum number of resident tiles.
+    unsigned GetMaxTiles() const { return maxTiles_; }
+    /// Return the wanted tiles that are not resident, nearest to the focuses first.
+    const PODVector<StreamingTile>& GetMissingTiles() const { return missingTiles_; }
+    /// Return the focus position of the largest cluster.
+    const Vector3& GetMainFocus() const { return mainFocus_; }
+    /// Return number of clusters.
+    unsigned GetNumClusters() const { return clusters_.Size(); }
+    /// Return whether a tile is resident.
+    bool IsResident(const IntVector2& tile) const { return residentTiles_.Contains(tile); }
+    /// Return whether the budget is used up.
+    bool IsFull() const { return residentTiles_.Size() >= maxTiles_; }
+    /// Return number of resident tiles.
+    unsigned GetNumResidentTiles() const { return residentTiles_.Size(); }
+
+private:
+    /// Focus cluster.
+    struct FocusCluster
+    {
+        /// Sum of the focus positions.
+        Vector3 positionSum_;
+        /// Number of focuses.
+        unsigned numFocuses_;
+        /// Minimum tile index of the focuses.
+        IntVector2 minTile_;
+        /// Maximum tile index of the focuses.
+        IntVector2 maxTile_;
+    };
+
+    /// Streaming distance in tiles.
+    int streamingDistance_;
+    /// Cluster radius in tiles.
+    int clusterRadius_;
+    /// Maximum number of resident tiles.
+    unsigned maxTiles_;
+    /// Clusters of the last update.
+    PODVector<FocusCluster> clusters_;
+    /// Wanted tiles of the last update by tile index, with their distance to the focuses.
+    HashMap<IntVector2, int> wantedTiles_;
+    /// Wanted tiles that are not resident, nearest first.
+    PODVector<StreamingTile> missingTiles_;
+    /// Resident tiles with the last update they were wanted on.
+    HashMap<IntVector2, unsigned> residentTiles_;
+    /// Focus position of the largest cluster.
+    Vector3 mainFocus_;
+    /// Update counter.
+    unsigned updateNumber_;
+};
+
+#endif //URHO3DSAMPLES_NAVIGATIONSTREAMINGCONTROLLER_H
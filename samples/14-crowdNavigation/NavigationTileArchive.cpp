@@ -0,0 +1,256 @@
+//
+// Created by AICDG on 2017/10/13.
+//
+
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+
+#include "NavigationTileArchive.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Archive file identifier.
+static const char* ARCHIVE_ID = "NTAR";
+/// Archive format version.
+static const unsigned ARCHIVE_VERSION = 1;
+/// Alignment of the tile data in the archive.
+static const unsigned TILE_ALIGNMENT = 16;
+
+/// Pad the file with zeros up to the tile alignment. Return true on success.
+static bool AlignFile(File& file)
+{
+    static const unsigned char padding[TILE_ALIGNMENT] = { 0 };
+    const unsigned misalignment = file.GetPosition() % TILE_ALIGNMENT;
+    return !misalignment || file.Write(padding, TILE_ALIGNMENT - misalignment) == TILE_ALIGNMENT - misalignment;
+}
+
+NavigationTileArchive::NavigationTileArchive() :
+    numMeshTiles_(IntVector2::ZERO),
+    data_(0),
+    size_(0)
+{
+#ifdef _WIN32
+    fileHandle_ = 0;
+    mappingHandle_ = 0;
+#endif
+}
+
+NavigationTileArchive::~NavigationTileArchive()
+{
+    Close();
+}
+
+bool NavigationTileArchive::Write(NavigationMesh* navMesh, const String& fileName)
+{
+    // Write to a temporary file and only replace the archive once it is complete, so that a failed write, eg. on a full
+    // disk, never leaves a truncated archive behind for Open()
+    const String tempFileName = fileName + ".tmp";
+    File file(navMesh->GetContext(), tempFileName, FILE_WRITE);
+    if (!file.IsOpen())
+        return false;
+
+    // Header. The index offset is patched in after the tile data has been written
+    const IntVector2 numTiles = navMesh->GetNumTiles();
+    bool success = file.WriteFileID(ARCHIVE_ID) && file.WriteUInt(ARCHIVE_VERSION) && file.WriteInt(numTiles.x_) &&
+        file.WriteInt(numTiles.y_);
+    const unsigned tileCountPosition = file.GetPosition();
+    success = success && file.WriteUInt(0) && file.WriteUInt(0);
+
+    // Tile data, one tile at a time so that the whole mesh never needs to be serialized at once
+    PODVector<IntVector2> tiles;
+    PODVector<unsigned> offsets;
+    PODVector<unsigned> sizes;
+    for (int z = 0; z < numTiles.y_ && success; ++z)
+        for (int x = 0; x < numTiles.x_ && success; ++x)
+        {
+            const IntVector2 tileIdx(x, z);
+            const PODVector<unsigned char> tileData = navMesh->GetTileData(tileIdx);
+            if (tileData.Empty())
+                continue;
+
+            success = AlignFile(file);
+            tiles.Push(tileIdx);
+            offsets.Push(file.GetPosition());
+            sizes.Push(tileData.Size());
+            success = success && file.Write(&tileData[0], tileData.Size()) == tileData.Size();
+        }
+
+    // Tile index
+    success = success && AlignFile(file);
+    const unsigned indexOffset = file.GetPosition();
+    for (unsigned i = 0; i < tiles.Size() && success; ++i)
+    {
+        success = file.WriteInt(tiles[i].x_) && file.WriteInt(tiles[i].y_) && file.WriteUInt(offsets[i]) &&
+            file.WriteUInt(sizes[i]);
+    }
+
+    success = success && file.Seek(tileCountPosition) == tileCountPosition && file.WriteUInt(tiles.Size()) &&
+        file.WriteUInt(indexOffset);
+    file.Close();
+
+    FileSystem* fileSystem = navMesh->GetSubsystem<FileSystem>();
+    if (success)
+    {
+        // Renaming does not replace an existing file on all platforms
+        if (fileSystem->FileExists(fileName))
+            fileSystem->Delete(fileName);
+        success = fileSystem->Rename(tempFileName, fileName);
+    }
+    if (!success)
+    {
+        fileSystem->Delete(tempFileName);
+        URHO3D_LOGERRORF("Failed to write navigation tile archive %s", fileName.CString());
+        return false;
+    }
+
+    URHO3D_LOGINFOF("Wrote %u navigation tiles to %s", tiles.Size(), fileName.CString());
+    return true;
+}
+
+bool NavigationTileArchive::Open(const String& fileName)
+{
+    Close();
+
+    const String nativeName = GetNativePath(fileName);
+    unsigned fileSize = 0;
+
+#ifdef _WIN32
+    fileHandle_ = CreateFileW(WString(nativeName).CString(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, 0);
+    if (fileHandle_ == INVALID_HANDLE_VALUE)
+    {
+        fileHandle_ = 0;
+        URHO3D_LOGERROR("Could not open navigation tile archive " + fileName);
+        return false;
+    }
+    fileSize = (unsigned)GetFileSize(fileHandle_, 0);
+    mappingHandle_ = CreateFileMappingW(fileHandle_, 0, PAGE_READONLY, 0, 0, 0);
+    if (mappingHandle_)
+        data_ = (const unsigned char*)MapViewOfFile(mappingHandle_, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = open(nativeName.CString(), O_RDONLY);
+    if (fd < 0)
+    {
+        URHO3D_LOGERROR("Could not open navigation tile archive " + fileName);
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        fileSize = (unsigned)fileStat.st_size;
+        void* mapping = mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (mapping != MAP_FAILED)
+            data_ = (const unsigned char*)mapping;
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+#endif
+
+    if (!data_)
+    {
+        URHO3D_LOGERROR("Could not map navigation tile archive " + fileName);
+        Close();
+        return false;
+    }
+    size_ = fileSize;
+
+    MemoryBuffer header(data_, size_);
+    if (header.ReadFileID() != ARCHIVE_ID || header.ReadUInt() != ARCHIVE_VERSION)
+    {
+        URHO3D_LOGERROR(fileName + " is not a valid navigation tile archive");
+        Close();
+        return false;
+    }
+    numMeshTiles_.x_ = header.ReadInt();
+    numMeshTiles_.y_ = header.ReadInt();
+    const unsigned tileCount = header.ReadUInt();
+    const unsigned indexOffset = header.ReadUInt();
+
+    // Only the index is read now, the tile data pages are touched when the tiles are streamed in
+    const unsigned entrySize = 4 * sizeof(unsigned);
+    if (indexOffset > size_ || tileCount > (size_ - indexOffset) / entrySize)
+    {
+        URHO3D_LOGERROR(fileName + " has a corrupt tile index");
+        Close();
+        return false;
+    }
+
+    MemoryBuffer index(data_ + indexOffset, tileCount * entrySize);
+    for (unsigned i = 0; i < tileCount; ++i)
+    {
+        IntVector2 tileIdx;
+        tileIdx.x_ = index.ReadInt();
+        tileIdx.y_ = index.ReadInt();
+        TileEntry entry;
+        entry.offset_ = index.ReadUInt();
+        entry.size_ = index.ReadUInt();
+        if (entry.offset_ <= size_ && entry.size_ <= size_ - entry.offset_)
+            index_[tileIdx] = entry;
+    }
+
+    return true;
+}
+
+void NavigationTileArchive::Close()
+{
+#ifdef _WIN32
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mappingHandle_)
+        CloseHandle(mappingHandle_);
+    if (fileHandle_)
+        CloseHandle(fileHandle_);
+    mappingHandle_ = 0;
+    fileHandle_ = 0;
+#else
+    if (data_)
+        munmap((void*)data_, size_);
+#endif
+
+    data_ = 0;
+    size_ = 0;
+    numMeshTiles_ = IntVector2::ZERO;
+    index_.Clear();
+}
+
+const unsigned char* NavigationTileArchive::GetTileData(const IntVector2& tile, unsigned& size) const
+{
+    HashMap<IntVector2, TileEntry>::ConstIterator i = index_.Find(tile);
+    if (i == index_.End())
+    {
+        size = 0;
+        return 0;
+    }
+
+    size = i->second_.size_;
+    return data_ + i->second_.offset_;
+}
+
+bool NavigationTileArchive::GetTile(const IntVector2& tile, PODVector<unsigned char>& dest) const
+{
+    unsigned size;
+    const unsigned char* tileData = GetTileData(tile, size);
+    if (!tileData)
+        return false;
+
+    dest.Resize(size);
+    memcpy(&dest[0], tileData, size);
+    return true;
+}
+
+bool NavigationTileArchive::AddTile(NavigationMesh* navMesh, const IntVector2& tile)
+{
+    // NavigationMesh::AddTile() takes a buffer, so the tile is copied once from the mapping. The read faults in only the
+    // pages of this tile
+    return GetTile(tile, buffer_) && navMesh->AddTile(buffer_);
+}
@@ -0,0 +1,88 @@
+//
+// Created by AICDG on 2017/10/12.
+//
+
+#include <Urho3D/IO/Compression.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Navigation/NavigationMesh.h>
+
+#include "NavigationTileStore.h"
+
+NavigationTileStore::NavigationTileStore() :
+    uncompressedSize_(0),
+    residentSize_(0)
+{
+}
+
+void NavigationTileStore::Save(NavigationMesh* navMesh)
+{
+    Clear();
+
+    const IntVector2 numTiles = navMesh->GetNumTiles();
+    for (int z = 0; z < numTiles.y_; ++z)
+        for (int x = 0; x < numTiles.x_; ++x)
+        {
+            const IntVector2 tileIdx(x, z);
+            const PODVector<unsigned char> tileData = navMesh->GetTileData(tileIdx);
+            if (tileData.Empty())
+                continue;
+
+            // Compress directly to the end of the arena, then trim to the actual compressed size
+            const unsigned offset = arena_.Size();
+            arena_.Resize(offset + EstimateCompressBound(tileData.Size()));
+            const unsigned compressedSize = CompressData(&arena_[offset], &tileData[0], tileData.Size());
+            arena_.Resize(offset + compressedSize);
+
+            TileEntry& entry = index_[tileIdx];
+            entry.offset_ = offset;
+            entry.compressedSize_ = compressedSize;
+            entry.size_ = tileData.Size();
+            uncompressedSize_ += tileData.Size();
+        }
+
+    URHO3D_LOGINFOF("Stored %u navigation tiles: %u bytes compressed, %u bytes uncompressed", index_.Size(), arena_.Size(),
+        uncompressedSize_);
+}
+
+bool NavigationTileStore::GetTile(const IntVector2& tile, PODVector<unsigned char>& dest) const
+{
+    HashMap<IntVector2, TileEntry>::ConstIterator i = index_.Find(tile);
+    if (i == index_.End())
+        return false;
+
+    const TileEntry& entry = i->second_;
+    dest.Resize(entry.size_);
+    return DecompressData(&dest[0], &arena_[entry.offset_], entry.size_) == entry.compressedSize_;
+}
+
+bool NavigationTileStore::AddTile(NavigationMesh* navMesh, const IntVector2& tile)
+{
+    return !residentTiles_.Contains(tile) && GetTile(tile, buffer_) && AddTile(navMesh, tile, buffer_);
+}
+
+bool NavigationTileStore::AddTile(NavigationMesh* navMesh, const IntVector2& tile, const PODVector<unsigned char>& tileData)
+{
+    if (residentTiles_.Contains(tile) || !navMesh->AddTile(tileData))
+        return false;
+
+    residentTiles_.Insert(tile);
+    residentSize_ += tileData.Size();
+    return true;
+}
+
+void NavigationTileStore::RemoveTile(NavigationMesh* navMesh, const IntVector2& tile)
+{
+    navMesh->RemoveTile(tile);
+
+    if (residentTiles_.Erase(tile))
+        residentSize_ -= index_[tile].size_;
+}
+
+void NavigationTileStore::Clear()
+{
+    arena_.Clear();
+    index_.Clear();
+    residentTiles_.Clear();
+    uncompressedSize_ = 0;
+    residentSize_ = 0;
+}
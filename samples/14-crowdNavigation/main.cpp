@@ -4,9 +4,25 @@
 
 #include <Urho3D/Urho3DAll.h>
 
+#include "AnimationLodController.h"
+#include "CrowdAnimationBinding.h"
+#include "CrowdLodController.h"
+#include "CrowdRepositionBatcher.h"
+#include "CrowdSnapshot.h"
+#include "FlowField.h"
+#include "FormationSolver.h"
+#include "NavigationObstacleQueue.h"
+#include "NavigationStreamingController.h"
+#include "NavigationTileArchive.h"
+#include "NavigationTilePrefetcher.h"
+#include "NavigationTileStore.h"
+
 using namespace Urho3D;
 
 static const String INSTRUCTION("instructionText");
+static const String LOD_STATS("lodStatsText");
+/// Distance to the formation slot at which a flow field agent switches to its own path to the slot.
+static const float FLOW_HANDOVER_DISTANCE = 8.0f;
 
 class MyApp : public Application
 {
@@ -15,7 +31,29 @@ public:
             : Application(context)
             , streamingDistance_(2)
             , drawDebug_(false)
+            , useStreaming_(false)
+            , useCrowdLod_(true)
+            , useAnimationLod_(true)
+            , useFlowField_(true)
     {
+        // Create the tile prefetcher, which decodes the tiles the crowd is heading to ahead of the streaming window
+        tilePrefetcher_ = new NavigationTilePrefetcher(context);
+        tilePrefetcher_->SetStreamingDistance(streamingDistance_);
+        // Budget the resident tiles for the streaming windows of two clusters
+        streamingController_.SetStreamingDistance(streamingDistance_);
+        streamingController_.SetMaxTiles(2 * (2 * streamingDistance_ + 1) * (2 * streamingDistance_ + 1));
+        // Create the crowd LOD controller, which lowers the simulation cost of the agents far from the camera
+        crowdLod_ = new CrowdLodController(context);
+        // Create the crowd reposition batcher, which hands all agents of a crowd update to one event handler, and the walk
+        // animation binding driven by it
+        repositionBatcher_ = new CrowdRepositionBatcher(context);
+        crowdAnimation_ = new CrowdAnimationBinding(context);
+        // Create the animation LOD controller, which lowers the bone update cost of the walkers far from the camera or out of view
+        animationLod_ = new AnimationLodController(context);
+        // Create the flow field, which steers the whole group to a shared target without a path per agent
+        flowField_ = new FlowField(context);
+        // Create the obstacle queue, which spreads the tile cache rebuilds of many obstacle changes over frames
+        obstacleQueue_ = new NavigationObstacleQueue(context);
     }
     virtual void Setup()
     {
@@ -56,6 +94,14 @@ public:
         ResourceCache* cache = GetSubsystem<ResourceCache>();
 
         scene_ = new Scene(context_);
+        repositionBatcher_->SetScene(scene_);
+        obstacleQueue_->SetScene(scene_);
+//        crowdAnimation_->SetAnimation(cache->GetResource<Animation>("Models/Jack_Walk.ani"));
+        crowdAnimation_->SetAnimation(cache->GetResource<Animation>("Models/Kachujin/Kachujin_Walk.ani"));
+        // Stop animating the fingers and other bones past the hands and feet of distant walkers
+        AnimationLodSettings walkerLod;
+        walkerLod.maxBoneDepth_ = 7;
+        animationLod_->SetModelSettings(cache->GetResource<Model>("Models/Kachujin/Kachujin.mdl"), walkerLod);
 
         // Create octree, use default volume (-1000, -1000, -1000) to (1000, 1000, 1000)
         // Also create a DebugRenderer component so that we can draw debug geometry
@@ -125,6 +171,7 @@ public:
         // physics geometry from the scene nodes, as it often is simpler, but if it can not find any (like in this example)
         // it will use renderable geometry instead
         navMesh->Build();
+        flowField_->SetNavigationMesh(navMesh);
 
         // Create an off-mesh connection to each box to make them climbable (tiny boxes are skipped). A connection is built from 2 nodes.
         // Note that OffMeshConnections must be added before building the navMesh, but as we are adding Obstacles next, tiles will be automatically rebuilt.
@@ -144,6 +191,13 @@ public:
         params.adaptiveRings = 3;
         params.adaptiveDepth = 3;
         crowdManager->SetObstacleAvoidanceParams(0, params);
+        // Set the params to "Low (11)" setting for the agents in the crowd LOD mid tier
+        params.velBias = 0.5f;
+        params.adaptiveDivs = 5;
+        params.adaptiveRings = 2;
+        params.adaptiveDepth = 1;
+        crowdManager->SetObstacleAvoidanceParams(1, params);
+        crowdLod_->SetMidAvoidanceType(1);
 
         // Create some movable barrels. We create them as crowd agents, as for moving entities it is less expensive and more convenient than using obstacles
         CreateMovingBarrels(navMesh);
@@ -185,8 +239,12 @@ public:
                 "Use WASD keys to move, RMB to rotate view\n"
                         "LMB to set destination, SHIFT+LMB to spawn a Jack\n"
                         "MMB or O key to add obstacles or remove obstacles/agents\n"
-                        "F5 to save scene, F7 to load\n"
+                        "X to clear the obstacles around the cursor\n"
+                        "F5 to save crowd snapshot, F7 to load, with SHIFT the whole scene\n"
                         "Tab to toggle navigation mesh streaming\n"
+                        "L to toggle crowd LOD, K to toggle animation LOD\n"
+                        "F to cycle formation shape\n"
+                        "G to toggle flow field steering\n"
                         "Space to toggle debug geometry\n"
                         "F12 to toggle this instruction text"
         );
@@ -198,6 +256,11 @@ public:
         instructionText->SetHorizontalAlignment(HA_CENTER);
         instructionText->SetVerticalAlignment(VA_CENTER);
         instructionText->SetPosition(0, ui->GetRoot()->GetHeight() / 4);
+
+        // Construct the LOD statistics text in the top left corner
+        Text* lodStatsText = ui->GetRoot()->CreateChild<Text>(LOD_STATS);
+        lodStatsText->SetFont(cache->GetResource<Font>("Fonts/Anonymous Pro.ttf"), 12);
+        lodStatsText->SetPosition(10, 10);
     }
 
     void SetupViewport()
@@ -256,19 +319,50 @@ public:
             // Add new obstacle or remove existing obstacle/agent with middle mouse button
         else if (input->GetMouseButtonPress(MOUSEB_MIDDLE) || input->GetKeyPress(KEY_O))
             AddOrRemoveObject();
+            // Remove all obstacles around the cursor with X
+        else if (input->GetKeyPress(KEY_X))
+            ClearMushrooms();
 
-        // Check for loading/saving the scene from/to the file Data/Scenes/CrowdNavigation.xml relative to the executable directory
+        // Check for saving/loading a crowd snapshot to/from the file Data/Scenes/CrowdNavigation.snapshot relative to the
+        // executable directory. With SHIFT, the whole scene is saved to/loaded from Data/Scenes/CrowdNavigation.xml instead
         if (input->GetKeyPress(KEY_F5))
         {
-            File saveFile(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/CrowdNavigation.xml", FILE_WRITE);
-            scene_->SaveXML(saveFile);
+            if (input->GetQualifierDown(QUAL_SHIFT))
+            {
+                // Save the agents with their own settings rather than their LOD tier settings
+                crowdLod_->Reset();
+                animationLod_->Reset();
+                File saveFile(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/CrowdNavigation.xml", FILE_WRITE);
+                scene_->SaveXML(saveFile);
+            }
+            else
+                SaveCrowdSnapshot();
         }
         else if (input->GetKeyPress(KEY_F7))
         {
-            File loadFile(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/CrowdNavigation.xml", FILE_READ);
-            scene_->LoadXML(loadFile);
+            if (input->GetQualifierDown(QUAL_SHIFT))
+            {
+                crowdLod_->Reset();
+                animationLod_->Reset();
+                File loadFile(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/CrowdNavigation.xml", FILE_READ);
+                obstacleQueue_->Clear();
+                scene_->LoadXML(loadFile);
+                flowAgents_.Clear();
+                flowSlots_.Clear();
+                flowField_->SetNavigationMesh(scene_->GetComponent<DynamicNavigationMesh>());
+            }
+            else
+                LoadCrowdSnapshot();
         }
 
+            // Cycle the formation shape with F
+        else if (input->GetKeyPress(KEY_F))
+            formationSolver_.SetShape((FormationShape)((formationSolver_.GetShape() + 1) % MAX_FORMATIONSHAPES));
+
+            // Toggle flow field steering with G
+        else if (input->GetKeyPress(KEY_G))
+            useFlowField_ = !useFlowField_;
+
             // Toggle debug geometry with space
         else if (input->GetKeyPress(KEY_SPACE))
             drawDebug_ = !drawDebug_;
@@ -299,8 +393,40 @@ public:
             ToggleStreaming(useStreaming_);
         }
         if (useStreaming_)
-            UpdateStreaming();
+            UpdateStreaming(timeStep);
+
+        // The crowd LOD tiers are updated from the agents of the crowd reposition batch, see HandleCrowdRepositionBatch()
+        if (input->GetKeyPress(KEY_L))
+        {
+            useCrowdLod_ = !useCrowdLod_;
+            if (!useCrowdLod_)
+                crowdLod_->Reset();
+        }
+
+        // The animation LOD tiers are updated with the crowd animation, see HandleCrowdRepositionBatch()
+        if (input->GetKeyPress(KEY_K))
+        {
+            useAnimationLod_ = !useAnimationLod_;
+            if (!useAnimationLod_)
+                animationLod_->Reset();
+        }
+        UpdateLodStats();
+
+        // Apply the queued obstacle changes within the frame's budget
+        obstacleQueue_->Update();
+
+        // Steer the group by the flow field until the agents are near their formation slots
+        UpdateFlowAgents();
+    }
 
+    void UpdateLodStats()
+    {
+        Text* lodStatsText = GetSubsystem<UI>()->GetRoot()->GetChildStaticCast<Text>(LOD_STATS, false);
+        lodStatsText->SetText(ToString("Crowd LOD near %u mid %u far %u\nAnimation LOD full %u reduced %u minimal %u frozen %u",
+            crowdLod_->GetNumAgents(CROWDLODTIER_NEAR), crowdLod_->GetNumAgents(CROWDLODTIER_MID),
+            crowdLod_->GetNumAgents(CROWDLODTIER_FAR), animationLod_->GetNumModels(ANIMATIONLODTIER_FULL),
+            animationLod_->GetNumModels(ANIMATIONLODTIER_REDUCED), animationLod_->GetNumModels(ANIMATIONLODTIER_MINIMAL),
+            animationLod_->GetNumModels(ANIMATIONLODTIER_FROZEN)));
     }
 
     void SubscribeToEvents()
@@ -318,11 +444,10 @@ public:
         // use a larger extents for finding a point on the navmesh to fix the agent's position
         SubscribeToEvent(E_CROWD_AGENT_FAILURE, URHO3D_HANDLER(MyApp, HandleCrowdAgentFailure));
 
-        // Subscribe HandleCrowdAgentReposition() function for controlling the animation
-        SubscribeToEvent(E_CROWD_AGENT_REPOSITION, URHO3D_HANDLER(MyApp, HandleCrowdAgentReposition));
+        // Subscribe HandleCrowdRepositionBatch() function for controlling the animation of all agents at once after the crowd
+        // update, rather than once per agent
+        SubscribeToEvent(repositionBatcher_, E_CROWDREPOSITIONBATCH, URHO3D_HANDLER(MyApp, HandleCrowdRepositionBatch));
 
-        // Subscribe HandleCrowdAgentFormation() function for positioning agent into a formation
-        SubscribeToEvent(E_CROWD_AGENT_FORMATION, URHO3D_HANDLER(MyApp, HandleCrowdAgentFormation));
     }
 
     void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
@@ -366,8 +491,78 @@ public:
                 // Spawn a jack at the target position
                 SpawnJack(pathPos, jackGroup);
             else
-                // Set crowd agents target position
-                scene_->GetComponent<CrowdManager>()->SetCrowdTarget(pathPos, jackGroup);
+                // Set crowd agents target positions to the formation slots around the target position
+                SetFormationTarget(navMesh, pathPos, jackGroup);
+        }
+    }
+
+    void SetFormationTarget(DynamicNavigationMesh* navMesh, const Vector3& target, Node* jackGroup)
+    {
+        // Compute the slots of the whole group at once, rather than a random point per agent
+        const PODVector<CrowdAgent*> agents = scene_->GetComponent<CrowdManager>()->GetAgents(jackGroup, false);
+        PODVector<Vector3> positions;
+        float agentRadius = 0.0f;
+        for (unsigned i = 0; i < agents.Size(); ++i)
+        {
+            positions.Push(agents[i]->GetPosition());
+            agentRadius = Max(agentRadius, agents[i]->GetRadius());
+        }
+
+        PODVector<Vector3> slots;
+        formationSolver_.Solve(navMesh, target, positions, agentRadius, slots);
+
+        flowAgents_.Clear();
+        flowSlots_.Clear();
+        if (useFlowField_)
+            flowField_->SetTarget(target);
+        else
+            flowField_->ClearTarget();
+
+        // With the flow field, only the agents near the target plan a path to their slot. The others steer by the field, which
+        // is shared by the whole group, and are handed over to their slot once they get near
+        for (unsigned i = 0; i < agents.Size(); ++i)
+        {
+            if (!flowField_->HasTarget() || (agents[i]->GetPosition() - slots[i]).Length() < FLOW_HANDOVER_DISTANCE)
+                agents[i]->SetTargetPosition(slots[i]);
+            else
+            {
+                flowAgents_.Push(WeakPtr<CrowdAgent>(agents[i]));
+                flowSlots_.Push(slots[i]);
+            }
+        }
+    }
+
+    void UpdateFlowAgents()
+    {
+        // Re-sample the cells changed by the obstacles and tiles
+        flowField_->Update();
+
+        for (unsigned i = 0; i < flowAgents_.Size();)
+        {
+            CrowdAgent* agent = flowAgents_[i];
+            if (!agent)
+            {
+                flowAgents_.Erase(i);
+                flowSlots_.Erase(i);
+                continue;
+            }
+
+            // Hand the agent over to its slot when near it, or when the field can not lead it further
+            const Vector3 position = agent->GetPosition();
+            const Vector3 direction = flowField_->GetDirection(position);
+            if (direction == Vector3::ZERO || (position - flowSlots_[i]).Length() < FLOW_HANDOVER_DISTANCE)
+            {
+                agent->SetTargetPosition(flowSlots_[i]);
+                flowAgents_[i] = flowAgents_.Back();
+                flowAgents_.Pop();
+                flowSlots_[i] = flowSlots_.Back();
+                flowSlots_.Pop();
+            }
+            else
+            {
+                agent->SetTargetVelocity(direction * agent->GetMaxSpeed());
+                ++i;
+            }
         }
     }
 
@@ -381,21 +576,44 @@ public:
         {
             Node* hitNode = hitDrawable->GetNode();
 
-            // Note that navmesh rebuild happens when the Obstacle component is removed
+            // Note that navmesh rebuild happens when the Obstacle component is removed. The mushrooms are added and removed
+            // through the obstacle queue, which spreads the rebuilds over frames
             if (hitNode->GetName() == "Mushroom")
-                hitNode->Remove();
+                obstacleQueue_->RemoveNode(hitNode);
             else if (hitNode->GetName() == "Jack")
                 hitNode->Remove();
             else
-                CreateMushroom(hitPos);
+                CreateMushroom(hitPos, true);
+        }
+    }
+
+    void ClearMushrooms()
+    {
+        // Raycast and remove all mushrooms around the hit position at once, like an explosion would
+        const float CLEAR_RADIUS = 15.0f;
+        Vector3 hitPos;
+        Drawable* hitDrawable;
+
+        if (Raycast(250.0f, hitPos, hitDrawable))
+        {
+            PODVector<Node*> mushrooms;
+            scene_->GetChildren(mushrooms);
+            for (unsigned i = 0; i < mushrooms.Size(); ++i)
+            {
+                if (mushrooms[i]->GetName() == "Mushroom" &&
+                    (mushrooms[i]->GetWorldPosition() - hitPos).LengthSquared() < CLEAR_RADIUS * CLEAR_RADIUS)
+                    obstacleQueue_->RemoveNode(mushrooms[i]);
+            }
         }
     }
 
-    Node* CreateMushroom(const Vector3& pos)
+    Node* CreateMushroom(const Vector3& pos, bool queued = false)
     {
         ResourceCache* cache = GetSubsystem<ResourceCache>();
 
-        Node* mushroomNode = scene_->CreateChild("Mushroom");
+        // A queued mushroom is built outside the scene, and the obstacle queue adds it to the scene later
+        SharedPtr<Node> mushroomNode(queued ? new Node(context_) : scene_->CreateChild("Mushroom"));
+        mushroomNode->SetName("Mushroom");
         mushroomNode->SetPosition(pos);
         mushroomNode->SetRotation(Quaternion(0.0f, Random(360.0f), 0.0f));
         mushroomNode->SetScale(2.0f + Random(0.5f));
@@ -404,6 +622,14 @@ public:
         mushroomObject->SetMaterial(cache->GetResource<Material>("Materials/Mushroom.xml"));
         mushroomObject->SetCastShadows(true);
 
+        // Create the Obstacle component, which will indicate to the navigation mesh not to generate walkable area where the
+        // mushroom is
+        Obstacle* obstacle = mushroomNode->CreateComponent<Obstacle>();
+        obstacle->SetRadius(mushroomNode->GetScale().x_);
+        obstacle->SetHeight(mushroomNode->GetScale().y_);
+
+        if (queued)
+            obstacleQueue_->AddNode(mushroomNode, scene_);
         return mushroomNode;
     }
 
@@ -437,75 +663,112 @@ public:
 
     void ToggleStreaming(bool enabled)
     {
-        NavigationMesh* navMesh = scene_->GetComponent<NavigationMesh>();
+        DynamicNavigationMesh* navMesh = scene_->GetComponent<DynamicNavigationMesh>();
         if (enabled)
         {
-            int maxTiles = (2 * streamingDistance_ + 1) * (2 * streamingDistance_ + 1);
+            // Allocate for the tile budget of the streaming controller, which holds the windows of two clusters
             BoundingBox boundingBox = navMesh->GetBoundingBox();
             SaveNavigationData();
-            navMesh->Allocate(boundingBox, maxTiles);
+            navMesh->Allocate(boundingBox, streamingController_.GetMaxTiles());
         }
         else
+        {
+            tilePrefetcher_->Reset();
             navMesh->Build();
+        }
     }
 
-    void UpdateStreaming()
+    void UpdateStreaming(float timeStep)
     {
-        // Center the navigation mesh at the crowd of jacks
-        Vector3 averageJackPosition;
+        // Stream the tiles around every jack, clustered so that a split group keeps the tiles under each part, and around the
+        // camera. Predict the movement of the crowd toward the jacks' average target
+        PODVector<Vector3> focuses;
+        Vector3 averageTarget;
+        unsigned numTargets = 0;
         if (Node* jackGroup = scene_->GetChild("Jacks"))
         {
             const unsigned numJacks = jackGroup->GetNumChildren();
             for (unsigned i = 0; i < numJacks; ++i)
-                averageJackPosition += jackGroup->GetChild(i)->GetWorldPosition();
-            averageJackPosition /= (float)numJacks;
+            {
+                Node* jack = jackGroup->GetChild(i);
+                focuses.Push(jack->GetWorldPosition());
+                CrowdAgent* agent = jack->GetComponent<CrowdAgent>();
+                if (agent && agent->GetRequestedTargetType() == CA_REQUESTEDTARGET_POSITION)
+                {
+                    averageTarget += agent->GetTargetPosition();
+                    ++numTargets;
+                }
+                // The agents steered by the flow field are heading to its target
+                else if (agent && agent->GetRequestedTargetType() == CA_REQUESTEDTARGET_VELOCITY && flowField_->HasTarget())
+                {
+                    averageTarget += flowField_->GetTarget();
+                    ++numTargets;
+                }
+            }
         }
+        focuses.Push(cameraNode_->GetWorldPosition());
+        PODVector<Vector3> corridor;
+        if (numTargets)
+            corridor.Push(averageTarget / (float)numTargets);
 
-        // Compute currently loaded area
         DynamicNavigationMesh* navMesh = scene_->GetComponent<DynamicNavigationMesh>();
-        const IntVector2 jackTile = navMesh->GetTileIndex(averageJackPosition);
-        const IntVector2 numTiles = navMesh->GetNumTiles();
-        const IntVector2 beginTile = VectorMax(IntVector2::ZERO, jackTile - IntVector2::ONE * streamingDistance_);
-        const IntVector2 endTile = VectorMin(jackTile + IntVector2::ONE * streamingDistance_, numTiles - IntVector2::ONE);
+        streamingController_.Update(navMesh, focuses);
 
-        // Remove tiles
-        for (HashSet<IntVector2>::Iterator i = addedTiles_.Begin(); i != addedTiles_.End();)
+        // Decode the tiles ahead of the largest cluster on worker threads, before they enter its streaming window. The tiles of
+        // the other clusters are queued for decoding when they are first taken below
+        tilePrefetcher_->Prefetch(navMesh, streamingController_.GetMainFocus(), corridor, timeStep);
+
+        // Add the missing tiles nearest to the focuses first. The tiles under a focus are added right away, the others once the
+        // prefetcher has decoded them and within its per-frame budget, so crossing a tile border does not add a whole row of
+        // tiles in one frame. When the tile budget is used up, the least recently wanted tile outside the windows makes room
+        const PODVector<StreamingTile>& missingTiles = streamingController_.GetMissingTiles();
+        for (unsigned i = 0; i < missingTiles.Size(); ++i)
         {
-            const IntVector2 tileIdx = *i;
-            if (beginTile.x_ <= tileIdx.x_ && tileIdx.x_ <= endTile.x_ && beginTile.y_ <= tileIdx.y_ && tileIdx.y_ <= endTile.y_)
-                ++i;
-            else
-            {
-                navMesh->RemoveTile(tileIdx);
-                i = addedTiles_.Erase(i);
-            }
-        }
+            const IntVector2 tileIdx = missingTiles[i].tile_;
+            if (navMesh->HasTile(tileIdx) || !(tileArchive_.HasTile(tileIdx) || tileStore_.HasTile(tileIdx)))
+                continue;
 
-        // Add tiles
-        for (int z = beginTile.y_; z <= endTile.y_; ++z)
-            for (int x = beginTile.x_; x <= endTile.x_; ++x)
+            const bool decoded = tilePrefetcher_->TakeTile(tileIdx, tileBuffer_);
+            if (!decoded && missingTiles[i].distance_ > 0)
+                continue;
+
+            IntVector2 evictedIdx;
+            if (streamingController_.IsFull())
             {
-                const IntVector2 tileIdx(x, z);
-                if (!navMesh->HasTile(tileIdx) && tileData_.Contains(tileIdx))
-                {
-                    addedTiles_.Insert(tileIdx);
-                    navMesh->AddTile(tileData_[tileIdx]);
-                }
+                if (!streamingController_.EvictTile(evictedIdx))
+                    break;
+                tileStore_.RemoveTile(navMesh, evictedIdx);
             }
+
+            streamingController_.AddTile(tileIdx);
+            // Only one of the tile sources is filled, see SaveNavigationData()
+            if (tileArchive_.IsOpen() && decoded)
+                navMesh->AddTile(tileBuffer_);
+            else if (tileArchive_.IsOpen())
+                tileArchive_.AddTile(navMesh, tileIdx);
+            else if (decoded)
+                tileStore_.AddTile(navMesh, tileIdx, tileBuffer_);
+            else
+                tileStore_.AddTile(navMesh, tileIdx);
+        }
     }
 
     void SaveNavigationData()
     {
-        NavigationMesh* navMesh = scene_->GetComponent<NavigationMesh>();
-        tileData_.Clear();
-        addedTiles_.Clear();
-        const IntVector2 numTiles = navMesh->GetNumTiles();
-        for (int z = 0; z < numTiles.y_; ++z)
-            for (int x = 0; x <= numTiles.x_; ++x)
-            {
-                const IntVector2 tileIdx = IntVector2(x, z);
-                tileData_[tileIdx] = navMesh->GetTileData(tileIdx);
-            }
+        DynamicNavigationMesh* navMesh = scene_->GetComponent<DynamicNavigationMesh>();
+        // Stop decoding from the old tile sources before they are replaced
+        tilePrefetcher_->Reset();
+        streamingController_.Clear();
+        tileArchive_.Close();
+        tileStore_.Clear();
+
+        // Write the fully built navigation mesh to a tile archive and stream the tiles from its memory mapping, so that only
+        // the pages of the tiles in the streaming window are read. If the archive can not be written, keep the tiles
+        // compressed in memory instead
+        const String archiveName = GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/CrowdNavigation.tiles";
+        if (!NavigationTileArchive::Write(navMesh, archiveName) || !tileArchive_.Open(archiveName))
+            tileStore_.Save(navMesh);
+        tilePrefetcher_->SetTileSources(&tileArchive_, &tileStore_);
     }
 
     void CreateBoxOffMeshConnections(DynamicNavigationMesh* navMesh, Node* boxGroup)
@@ -553,7 +816,7 @@ public:
         barrel->Remove();
     }
 
-    void SpawnJack(const Vector3& pos, Node* jackGroup)
+    Node* SpawnJack(const Vector3& pos, Node* jackGroup)
     {
         ResourceCache* cache = GetSubsystem<ResourceCache>();
         SharedPtr<Node> jackNode(jackGroup->CreateChild("Jack"));
@@ -564,13 +827,72 @@ public:
         modelObject->SetModel(cache->GetResource<Model>("Models/Kachujin/Kachujin.mdl"));
         modelObject->SetMaterial(cache->GetResource<Material>("Models/Kachujin/Materials/Kachujin.xml"));
         modelObject->SetCastShadows(true);
-        jackNode->CreateComponent<AnimationController>();
 
         // Create a CrowdAgent component and set its height and realistic max speed/acceleration. Use default radius
         CrowdAgent* agent = jackNode->CreateComponent<CrowdAgent>();
         agent->SetHeight(2.0f);
         agent->SetMaxSpeed(3.0f);
         agent->SetMaxAccel(5.0f);
+        return jackNode;
+    }
+
+    void SaveCrowdSnapshot()
+    {
+        // The snapshot holds the crowd state and obstacle set only, which is all that changes while the sample runs
+        CrowdSnapshot snapshot;
+        if (!snapshot.Capture(scene_))
+            return;
+        File saveFile(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/CrowdNavigation.snapshot", FILE_WRITE);
+        snapshot.Save(saveFile);
+    }
+
+    void LoadCrowdSnapshot()
+    {
+        File loadFile(context_, GetSubsystem<FileSystem>()->GetProgramDir() + "Data/Scenes/CrowdNavigation.snapshot", FILE_READ);
+        CrowdSnapshot snapshot;
+        if (!loadFile.IsOpen() || !snapshot.Load(loadFile))
+            return;
+
+        // Drop the queued obstacle changes, the snapshot has the obstacle set to restore
+        obstacleQueue_->Clear();
+        snapshot.Restore(scene_, CreateSnapshotJack, CreateSnapshotMushroom, this);
+
+        // The formation slots are not in the snapshot. The agents steered by the flow field when the snapshot was taken keep
+        // steering by it toward the group target
+        flowAgents_.Clear();
+        flowSlots_.Clear();
+        if (Node* jackGroup = scene_->GetChild("Jacks"))
+        {
+            PODVector<CrowdAgent*> agents;
+            jackGroup->GetComponents<CrowdAgent>(agents, true);
+            for (unsigned i = 0; i < agents.Size(); ++i)
+            {
+                if (agents[i]->GetRequestedTargetType() != CA_REQUESTEDTARGET_VELOCITY)
+                    continue;
+                if (flowField_->HasTarget())
+                {
+                    flowAgents_.Push(WeakPtr<CrowdAgent>(agents[i]));
+                    flowSlots_.Push(flowField_->GetTarget());
+                }
+                else
+                    agents[i]->ResetTarget();
+            }
+        }
+    }
+
+    static Node* CreateSnapshotJack(Node* parent, const Vector3& position, void* userData)
+    {
+        return static_cast<MyApp*>(userData)->SpawnJack(position, parent);
+    }
+
+    static Node* CreateSnapshotMushroom(Node* parent, const Vector3& position, const Quaternion& rotation, const Vector3& scale,
+        void* userData)
+    {
+        // The mushrooms are always children of the scene
+        Node* mushroomNode = static_cast<MyApp*>(userData)->CreateMushroom(position);
+        mushroomNode->SetWorldRotation(rotation);
+        mushroomNode->SetWorldScale(scale);
+        return mushroomNode;
     }
 
     void HandleCrowdAgentFailure(StringHash eventType, VariantMap& eventData)
@@ -590,58 +912,25 @@ public:
         }
     }
 
-    void HandleCrowdAgentReposition(StringHash eventType, VariantMap& eventData)
+    void HandleCrowdRepositionBatch(StringHash eventType, VariantMap& eventData)
     {
-//        static const char* WALKING_ANI = "Models/Jack_Walk.ani";
-        static const char* WALKING_ANI = "Models/Kachujin/Kachujin_Walk.ani";
+        using namespace CrowdRepositionBatchEvent;
 
-        using namespace CrowdAgentReposition;
+        // Update the crowd LOD tiers by distance to the camera from the agents the batcher has already gathered, instead of
+        // searching the scene for them a second time. The tiers take effect on the next crowd update
+        const CrowdRepositionBatch& batch = *static_cast<const CrowdRepositionBatch*>(eventData[P_BATCH].GetVoidPtr());
+        if (useCrowdLod_)
+            crowdLod_->Update(batch.agents_, cameraNode_->GetWorldPosition());
 
-        Node* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
-        CrowdAgent* agent = static_cast<CrowdAgent*>(eventData[P_CROWD_AGENT].GetPtr());
-        Vector3 velocity = eventData[P_VELOCITY].GetVector3();
-        float timeStep = eventData[P_TIMESTEP].GetFloat();
-
-        // Only Jack agent has animation controller
-        AnimationController* animCtrl = node->GetComponent<AnimationController>();
-        if (animCtrl)
-        {
-            float speed = velocity.Length();
-            if (animCtrl->IsPlaying(WALKING_ANI))
-            {
-                float speedRatio = speed / agent->GetMaxSpeed();
-                // Face the direction of its velocity but moderate the turning speed based on the speed ratio and timeStep
-                node->SetRotation(node->GetRotation().Slerp(Quaternion(Vector3::FORWARD, velocity), 10.0f * timeStep * speedRatio));
-                // Throttle the animation speed based on agent speed ratio (ratio = 1 is full throttle)
-                animCtrl->SetSpeed(WALKING_ANI, speedRatio * 1.5f);
-            }
-            else
-                animCtrl->Play(WALKING_ANI, 0, true, 0.1f);
+        // Lower the bone update rate of the walkers by distance to the camera and visibility
+        if (useAnimationLod_)
+            animationLod_->Update(batch.nodes_, cameraNode_->GetWorldPosition());
 
-            // If speed is too low then stop the animation
-            if (speed < agent->GetRadius())
-                animCtrl->Stop(WALKING_ANI, 0.5f);
-        }
+        // Turn the animated agents toward their velocity and throttle their walk animation, pausing it for the walkers out of
+        // view. Agents without an AnimatedModel, like the barrels, are skipped by the binding
+        crowdAnimation_->Apply(batch, useAnimationLod_ ? &animationLod_->GetFrozen() : 0);
     }
 
-    void HandleCrowdAgentFormation(StringHash eventType, VariantMap& eventData)
-    {
-        using namespace CrowdAgentFormation;
-
-        unsigned index = eventData[P_INDEX].GetUInt();
-        unsigned size = eventData[P_SIZE].GetUInt();
-        Vector3 position = eventData[P_POSITION].GetVector3();
-
-        // The first agent will always move to the exact position, all other agents will select a random point nearby
-        if (index)
-        {
-            CrowdManager* crowdManager = static_cast<CrowdManager*>(GetEventSender());
-            CrowdAgent* agent = static_cast<CrowdAgent*>(eventData[P_CROWD_AGENT].GetPtr());
-            eventData[P_POSITION] = crowdManager->GetRandomPointInCircle(position, agent->GetRadius(), agent->GetQueryFilterType());
-        }
-    }
-
-
 private:
     /// Scene.
     SharedPtr<Scene> scene_;
@@ -665,9 +954,39 @@ private:
     bool useStreaming_;
     /// Streaming distance.
     int streamingDistance_;
-    /// Tile data.
-    HashMap<IntVector2, PODVector<unsigned char> > tileData_;
-    /// Added tiles.
-    HashSet<IntVector2> addedTiles_;
+    /// Memory-mapped tile archive.
+    NavigationTileArchive tileArchive_;
+    /// Compressed tile data, used when the tile archive is not available.
+    NavigationTileStore tileStore_;
+    /// Streaming controller, which keeps the tiles around the focus clusters resident.
+    NavigationStreamingController streamingController_;
+    /// Tile prefetcher.
+    SharedPtr<NavigationTilePrefetcher> tilePrefetcher_;
+    /// Buffer for the tiles taken from the prefetcher.
+    PODVector<unsigned char> tileBuffer_;
+    /// Crowd LOD controller.
+    SharedPtr<CrowdLodController> crowdLod_;
+    /// Flag for using crowd LOD.
+    bool useCrowdLod_;
+    /// Crowd reposition batcher.
+    SharedPtr<CrowdRepositionBatcher> repositionBatcher_;
+    /// Walk animation binding of the crowd agents.
+    SharedPtr<CrowdAnimationBinding> crowdAnimation_;
+    /// Animation LOD controller.
+    SharedPtr<AnimationLodController> animationLod_;
+    /// Flag for using animation LOD.
+    bool useAnimationLod_;
+    /// Formation solver for the group targets.
+    FormationSolver formationSolver_;
+    /// Time-sliced obstacle change queue.
+    SharedPtr<NavigationObstacleQueue> obstacleQueue_;
+    /// Flow field of the group target.
+    SharedPtr<FlowField> flowField_;
+    /// Flag for steering the group by the flow field.
+    bool useFlowField_;
+    /// Agents steered by the flow field.
+    Vector<WeakPtr<CrowdAgent> > flowAgents_;
+    /// Formation slots of the agents steered by the flow field.
+    PODVector<Vector3> flowSlots_;
 };
 URHO3D_DEFINE_APPLICATION_MAIN(MyApp)
\ No newline at end of file
@@ -0,0 +1,310 @@
+//
+// Created by AICDG on 2017/10/17.
+//
+
+#include <Urho3D/Urho3DAll.h>
+
+using namespace Urho3D;
+
+/// Random seed of the scene layouts, partial build areas and query endpoints.
+static const unsigned BENCHMARK_SEED = 12345;
+/// Number of timed full builds per configuration.
+static const unsigned NUM_FULL_BUILDS = 3;
+/// Number of timed partial builds per configuration.
+static const unsigned NUM_PARTIAL_BUILDS = 50;
+/// Number of timed path queries per configuration.
+static const unsigned NUM_PATH_QUERIES = 500;
+/// Number of remove and add cycles over all tiles per configuration.
+static const unsigned NUM_TILE_CYCLES = 5;
+/// Number of timed random point queries per configuration.
+static const unsigned NUM_RANDOM_POINTS = 1000;
+/// Swept tile sizes in cells.
+static const int TILE_SIZES[] = { 16, 32, 64 };
+/// Swept cell sizes.
+static const float CELL_SIZES[] = { 0.2f, 0.3f, 0.5f };
+/// Swept agent radii.
+static const float AGENT_RADII[] = { 0.4f, 0.6f, 1.0f };
+
+class MyApp : public Application
+{
+public:
+    MyApp(Context* context)
+            : Application(context)
+    {
+    }
+    virtual void Setup()
+    {
+        // Called before engine initialization. engineParameters_ member variable can be modified here. No window is needed
+        engineParameters_[Urho3D::EP_WINDOW_TITLE] = "15 navigation benchmark";
+        engineParameters_[Urho3D::EP_HEADLESS]     = true;
+    }
+    virtual void Start()
+    {
+        // Write the results to the file given with -output, or next to the executable
+        String outputName = GetSubsystem<FileSystem>()->GetProgramDir() + "NavigationBenchmark.json";
+        const Vector<String>& arguments = GetArguments();
+        for (unsigned i = 0; i + 1 < arguments.Size(); ++i)
+        {
+            if (arguments[i].ToLower() == "-output")
+                outputName = arguments[i + 1];
+        }
+
+        RunBenchmarks(outputName);
+        engine_->Exit();
+    }
+
+    void RunBenchmarks(const String& outputName)
+    {
+        JSONValue results;
+        for (unsigned scene = 0; scene < 2; ++scene)
+            for (unsigned i = 0; i < sizeof(TILE_SIZES) / sizeof(TILE_SIZES[0]); ++i)
+                for (unsigned j = 0; j < sizeof(CELL_SIZES) / sizeof(CELL_SIZES[0]); ++j)
+                    for (unsigned k = 0; k < sizeof(AGENT_RADII) / sizeof(AGENT_RADII[0]); ++k)
+                        results.Push(BenchmarkScene(scene == 1, TILE_SIZES[i], CELL_SIZES[j], AGENT_RADII[k]));
+
+        JSONFile file(context_);
+        JSONValue& root = file.GetRoot();
+        root.Set("timeStamp", Time::GetTimeStamp());
+        root.Set("seed", BENCHMARK_SEED);
+        root.Set("threads", GetSubsystem<WorkQueue>()->GetNumThreads());
+        root.Set("results", results);
+        if (file.SaveFile(outputName))
+            URHO3D_LOGINFO("Wrote navigation benchmark results to " + outputName);
+        else
+            URHO3D_LOGERROR("Could not write navigation benchmark results to " + outputName);
+    }
+
+    JSONValue BenchmarkScene(bool crowdScene, int tileSize, float cellSize, float agentRadius)
+    {
+        SharedPtr<Scene> scene = crowdScene ? CreateCrowdNavigationScene() : CreateNavigationScene();
+        NavigationMesh* navMesh = crowdScene ? scene->GetComponent<DynamicNavigationMesh>() :
+            scene->GetComponent<NavigationMesh>();
+        navMesh->SetTileSize(tileSize);
+        navMesh->SetCellSize(cellSize);
+        navMesh->SetAgentRadius(agentRadius);
+
+        JSONValue result;
+        result.Set("scene", crowdScene ? "14-crowdNavigation" : "11-navigation");
+        result.Set("tileSize", tileSize);
+        result.Set("cellSize", cellSize);
+        result.Set("agentRadius", agentRadius);
+
+        // Untimed first build. The crowd navigation scene adds its off-mesh connections to the built mesh, like the sample
+        navMesh->Build();
+        if (crowdScene)
+            CreateBoxOffMeshConnections(navMesh, scene->GetChild("Boxes"));
+
+        HiresTimer timer;
+        PODVector<float> times;
+
+        // Full builds
+        for (unsigned i = 0; i < NUM_FULL_BUILDS; ++i)
+        {
+            timer.Reset();
+            navMesh->Build();
+            times.Push(timer.GetUSec(false) / 1000.0f);
+        }
+        result.Set("build", SummarizeTimes(times));
+
+        const IntVector2 numTiles = navMesh->GetNumTiles();
+        result.Set("numTiles", numTiles.x_ * numTiles.y_);
+        result.Set("navigationDataSize", navMesh->GetNavigationDataAttr().Size());
+
+        // Partial builds of mushroom sized areas
+        SetRandomSeed(BENCHMARK_SEED);
+        times.Clear();
+        for (unsigned i = 0; i < NUM_PARTIAL_BUILDS; ++i)
+        {
+            const Vector3 center(Random(90.0f) - 45.0f, 0.0f, Random(90.0f) - 45.0f);
+            const BoundingBox area(center - Vector3(1.5f, 0.0f, 1.5f), center + Vector3(1.5f, 3.0f, 1.5f));
+            timer.Reset();
+            navMesh->Build(area);
+            times.Push(timer.GetUSec(false) / 1000.0f);
+        }
+        result.Set("partialBuild", SummarizeTimes(times));
+
+        // Path queries between the same seeded endpoints for every configuration, snapped to the navigation mesh untimed
+        SetRandomSeed(BENCHMARK_SEED);
+        PODVector<Vector3> endpoints;
+        for (unsigned i = 0; i < NUM_PATH_QUERIES * 2; ++i)
+            endpoints.Push(navMesh->FindNearestPoint(Vector3(Random(90.0f) - 45.0f, 0.0f, Random(90.0f) - 45.0f)));
+
+        times.Clear();
+        PODVector<Vector3> path;
+        unsigned numFailedPaths = 0;
+        for (unsigned i = 0; i < NUM_PATH_QUERIES; ++i)
+        {
+            timer.Reset();
+            navMesh->FindPath(path, endpoints[i * 2], endpoints[i * 2 + 1]);
+            times.Push(timer.GetUSec(false) / 1000.0f);
+            if (path.Empty())
+                ++numFailedPaths;
+        }
+        JSONValue findPath = SummarizeTimes(times);
+        findPath.Set("failures", numFailedPaths);
+        result.Set("findPath", findPath);
+
+        // Random points around the path endpoints
+        SetRandomSeed(BENCHMARK_SEED);
+        times.Clear();
+        for (unsigned i = 0; i < NUM_RANDOM_POINTS; ++i)
+        {
+            timer.Reset();
+            navMesh->GetRandomPointInCircle(endpoints[i % endpoints.Size()], 5.0f);
+            times.Push(timer.GetUSec(false) / 1000.0f);
+        }
+        result.Set("randomPointInCircle", SummarizeTimes(times));
+
+        // Streaming cycles: remove every tile and add it back from its saved data
+        Vector<PODVector<unsigned char> > tileData;
+        PODVector<IntVector2> tiles;
+        for (int z = 0; z < numTiles.y_; ++z)
+            for (int x = 0; x < numTiles.x_; ++x)
+            {
+                const IntVector2 tileIdx(x, z);
+                PODVector<unsigned char> data = navMesh->GetTileData(tileIdx);
+                if (data.Empty())
+                    continue;
+                tiles.Push(tileIdx);
+                tileData.Push(data);
+            }
+
+        times.Clear();
+        PODVector<float> addTimes;
+        for (unsigned i = 0; i < NUM_TILE_CYCLES; ++i)
+        {
+            for (unsigned j = 0; j < tiles.Size(); ++j)
+            {
+                timer.Reset();
+                navMesh->RemoveTile(tiles[j]);
+                times.Push(timer.GetUSec(false) / 1000.0f);
+                timer.Reset();
+                navMesh->AddTile(tileData[j]);
+                addTimes.Push(timer.GetUSec(false) / 1000.0f);
+            }
+        }
+        result.Set("removeTile", SummarizeTimes(times));
+        result.Set("addTile", SummarizeTimes(addTimes));
+
+        URHO3D_LOGINFOF("%s tile size %d cell size %.2f agent radius %.2f: build %.2f ms, path p50 %.3f ms",
+            result.Get("scene").GetString().CString(), tileSize, cellSize, agentRadius,
+            result.Get("build").Get("p50").GetFloat(), findPath.Get("p50").GetFloat());
+        return result;
+    }
+
+    JSONValue SummarizeTimes(PODVector<float>& times)
+    {
+        // Times in milliseconds, percentiles by nearest rank
+        JSONValue summary;
+        summary.Set("count", times.Size());
+        if (times.Empty())
+            return summary;
+
+        Sort(times.Begin(), times.End());
+        float total = 0.0f;
+        for (unsigned i = 0; i < times.Size(); ++i)
+            total += times[i];
+
+        summary.Set("mean", total / times.Size());
+        summary.Set("min", times.Front());
+        summary.Set("p50", GetPercentile(times, 50.0f));
+        summary.Set("p90", GetPercentile(times, 90.0f));
+        summary.Set("p99", GetPercentile(times, 99.0f));
+        summary.Set("max", times.Back());
+        return summary;
+    }
+
+    float GetPercentile(const PODVector<float>& sortedTimes, float percent)
+    {
+        const unsigned rank = (unsigned)ceilf(percent / 100.0f * sortedTimes.Size());
+        return sortedTimes[Clamp(rank, 1U, sortedTimes.Size()) - 1];
+    }
+
+    SharedPtr<Scene> CreateNavigationScene()
+    {
+        // Same geometry as 11-navigation, without the parts that only matter for rendering
+        SharedPtr<Scene> scene(new Scene(context_));
+        SetRandomSeed(BENCHMARK_SEED);
+
+        CreatePlane(scene);
+        for (unsigned i = 0; i < 100; ++i)
+            CreateMushroom(scene, Vector3(Random(90.0f) - 45.0f, 0.0f, Random(90.0f) - 45.0f));
+        CreateBoxes(scene, scene);
+
+        NavigationMesh* navMesh = scene->CreateComponent<NavigationMesh>();
+        scene->CreateComponent<Navigable>();
+        navMesh->SetPadding(Vector3(0.0f, 10.0f, 0.0f));
+        return scene;
+    }
+
+    SharedPtr<Scene> CreateCrowdNavigationScene()
+    {
+        // Same geometry as 14-crowdNavigation, without the parts that only matter for rendering. The crowd is not needed
+        // for the navigation mesh operations
+        SharedPtr<Scene> scene(new Scene(context_));
+        SetRandomSeed(BENCHMARK_SEED);
+
+        CreatePlane(scene);
+        CreateBoxes(scene, scene->CreateChild("Boxes"));
+        for (unsigned i = 0; i < 100; ++i)
+            CreateMushroom(scene, Vector3(Random(90.0f) - 45.0f, 0.0f, Random(90.0f) - 45.0f));
+
+        DynamicNavigationMesh* navMesh = scene->CreateComponent<DynamicNavigationMesh>();
+        navMesh->SetAgentHeight(10.0f);
+        navMesh->SetCellHeight(0.05f);
+        scene->CreateComponent<Navigable>();
+        navMesh->SetPadding(Vector3(0.0f, 10.0f, 0.0f));
+        return scene;
+    }
+
+    void CreatePlane(Scene* scene)
+    {
+        Node* planeNode = scene->CreateChild("Plane");
+        planeNode->SetScale(Vector3(100.0f, 1.0f, 100.0f));
+        StaticModel* planeObject = planeNode->CreateComponent<StaticModel>();
+        planeObject->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/Plane.mdl"));
+    }
+
+    void CreateBoxes(Scene* scene, Node* boxGroup)
+    {
+        for (unsigned i = 0; i < 20; ++i)
+        {
+            Node* boxNode = boxGroup->CreateChild("Box");
+            float size = 1.0f + Random(10.0f);
+            boxNode->SetPosition(Vector3(Random(80.0f) - 40.0f, size * 0.5f, Random(80.0f) - 40.0f));
+            boxNode->SetScale(size);
+            StaticModel* boxObject = boxNode->CreateComponent<StaticModel>();
+            boxObject->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/Box.mdl"));
+        }
+    }
+
+    void CreateMushroom(Scene* scene, const Vector3& pos)
+    {
+        Node* mushroomNode = scene->CreateChild("Mushroom");
+        mushroomNode->SetPosition(pos);
+        mushroomNode->SetRotation(Quaternion(0.0f, Random(360.0f), 0.0f));
+        mushroomNode->SetScale(2.0f + Random(0.5f));
+        StaticModel* mushroomObject = mushroomNode->CreateComponent<StaticModel>();
+        mushroomObject->SetModel(GetSubsystem<ResourceCache>()->GetResource<Model>("Models/Mushroom.mdl"));
+    }
+
+    void CreateBoxOffMeshConnections(NavigationMesh* navMesh, Node* boxGroup)
+    {
+        const Vector<SharedPtr<Node> >& boxes = boxGroup->GetChildren();
+        for (unsigned i = 0; i < boxes.Size(); ++i)
+        {
+            Node* box = boxes[i];
+            Vector3 boxPos = box->GetPosition();
+            float boxHalfSize = box->GetScale().x_ / 2;
+
+            Node* connectionStart = box->CreateChild("ConnectionStart");
+            connectionStart->SetWorldPosition(navMesh->FindNearestPoint(boxPos + Vector3(boxHalfSize, -boxHalfSize, 0)));
+            Node* connectionEnd = connectionStart->CreateChild("ConnectionEnd");
+            connectionEnd->SetWorldPosition(navMesh->FindNearestPoint(boxPos + Vector3(boxHalfSize, boxHalfSize, 0)));
+
+            OffMeshConnection* connection = connectionStart->CreateComponent<OffMeshConnection>();
+            connection->SetEndPoint(connectionEnd);
+        }
+    }
+};
+URHO3D_DEFINE_APPLICATION_MAIN(MyApp)
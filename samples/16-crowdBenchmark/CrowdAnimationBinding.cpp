@@ -0,0 +1,114 @@
+//
+// Created by AICDG on 2017/10/20.
+//
+
+#include <Urho3D/Graphics/Animation.h>
+#include <Urho3D/Graphics/AnimatedModel.h>
+#include <Urho3D/Graphics/AnimationState.h>
+#include <Urho3D/Navigation/CrowdAgent.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "CrowdAnimationBinding.h"
+#include "CrowdRepositionBatcher.h"
+
+CrowdAnimationBinding::CrowdAnimationBinding(Context* context) :
+    Object(context),
+    turnRate_(10.0f),
+    speedScale_(1.5f),
+    fadeInTime_(0.1f),
+    fadeOutTime_(0.5f)
+{
+}
+
+void CrowdAnimationBinding::SetAnimation(Animation* animation)
+{
+    animation_ = animation;
+    states_.Clear();
+}
+
+void CrowdAnimationBinding::SetTurnRate(float turnRate)
+{
+    turnRate_ = Max(turnRate, 0.0f);
+}
+
+void CrowdAnimationBinding::SetSpeedScale(float speedScale)
+{
+    speedScale_ = speedScale;
+}
+
+void CrowdAnimationBinding::SetFadeTimes(float fadeInTime, float fadeOutTime)
+{
+    fadeInTime_ = Max(fadeInTime, M_EPSILON);
+    fadeOutTime_ = Max(fadeOutTime, M_EPSILON);
+}
+
+void CrowdAnimationBinding::Apply(const CrowdRepositionBatch& batch, const PODVector<bool>* paused)
+{
+    if (!animation_)
+        return;
+
+    // Forget removed nodes once they make up most of the states
+    const unsigned numAgents = batch.agents_.Size();
+    if (states_.Size() > 2 * numAgents + 64)
+        states_.Clear();
+
+    const float timeStep = batch.timeStep_;
+    const bool hasPaused = paused && paused->Size() == numAgents;
+    for (unsigned i = 0; i < numAgents; ++i)
+    {
+        Node* node = batch.nodes_[i];
+        AnimationState* state = GetState(node);
+        if (!state)
+            continue;
+
+        CrowdAgent* agent = batch.agents_[i];
+        const Vector3& velocity = batch.velocities_[i];
+        const float speed = velocity.Length();
+        const float weight = state->GetWeight();
+        const float speedRatio = speed / agent->GetMaxSpeed();
+        // Face the direction of its velocity but moderate the turning speed based on the speed ratio and timeStep
+        if (weight > 0.0f)
+            node->SetRotation(node->GetRotation().Slerp(Quaternion(Vector3::FORWARD, velocity), turnRate_ * timeStep * speedRatio));
+
+        // A paused agent keeps its pose, so that its model is not marked for an update
+        if (hasPaused && paused->At(i))
+            continue;
+
+        // Throttle the animation speed based on agent speed ratio (ratio = 1 is full throttle)
+        if (weight > 0.0f)
+            state->AddTime(speedRatio * speedScale_ * timeStep);
+
+        // Fade the animation in while the agent walks, and out once its speed is too low
+        if (speed < agent->GetRadius())
+            state->SetWeight(Max(weight - timeStep / fadeOutTime_, 0.0f));
+        else
+            state->SetWeight(Min(weight + timeStep / fadeInTime_, 1.0f));
+    }
+}
+
+AnimationState* CrowdAnimationBinding::GetState(Node* node)
+{
+    HashMap<unsigned, BoundState>::Iterator i = states_.Find(node->GetID());
+    if (i != states_.End() && i->second_.node_ == node && (i->second_.state_ || !i->second_.animated_))
+        return i->second_.state_;
+
+    BoundState bound;
+    bound.node_ = node;
+    bound.animated_ = false;
+    AnimatedModel* model = node->GetComponent<AnimatedModel>();
+    if (model)
+    {
+        AnimationState* state = model->GetAnimationState(animation_->GetNameHash());
+        if (!state)
+        {
+            state = model->AddAnimationState(animation_);
+            if (state)
+                state->SetLooped(true);
+        }
+        bound.state_ = state;
+        bound.animated_ = state != 0;
+    }
+
+    states_[node->GetID()] = bound;
+    return bound.state_;
+}
@@ -0,0 +1,83 @@
+//
+// Created by AICDG on 2017/10/20.
+//
+
+#ifndef URHO3DSAMPLES_CROWDANIMATIONBINDING_H
+#define URHO3DSAMPLES_CROWDANIMATIONBINDING_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+
+namespace Urho3D
+{
+
+class Animation;
+class AnimationState;
+class Node;
+
+}
+
+struct CrowdRepositionBatch;
+
+using namespace Urho3D;
+
+/// Binds a looped walk animation to the movement of crowd agents. Turns each animated agent toward its velocity and plays the
+/// animation at a speed proportional to the agent's, fading it in and out as the agent starts and stops. The animation states
+/// are resolved once per agent and driven directly, without name lookups.
+class CrowdAnimationBinding : public Object
+{
+    URHO3D_OBJECT(CrowdAnimationBinding, Object);
+
+public:
+    /// Construct.
+    CrowdAnimationBinding(Context* context);
+
+    /// Set the walk animation. Agents whose node has an AnimatedModel get a state for it.
+    void SetAnimation(Animation* animation);
+    /// Set turn rate toward the velocity at full speed, as the slerp factor per second.
+    void SetTurnRate(float turnRate);
+    /// Set animation playback speed at the agent's full speed.
+    void SetSpeedScale(float speedScale);
+    /// Set fade in and fade out times of the animation.
+    void SetFadeTimes(float fadeInTime, float fadeOutTime);
+    /// Animate the agents of a crowd update. Agents flagged in paused, which is in the order of the batch, are still turned but
+    /// their animation is not advanced or faded, so that their model is not marked for an update.
+    void Apply(const CrowdRepositionBatch& batch, const PODVector<bool>* paused = 0);
+
+    /// Return the walk animation.
+    Animation* GetAnimation() const { return animation_; }
+    /// Return turn rate.
+    float GetTurnRate() const { return turnRate_; }
+    /// Return animation playback speed at full speed.
+    float GetSpeedScale() const { return speedScale_; }
+
+private:
+    /// Walk animation state of an agent node.
+    struct BoundState
+    {
+        /// Agent scene node.
+        WeakPtr<Node> node_;
+        /// Walk animation state, null if the node is not animated.
+        WeakPtr<AnimationState> state_;
+        /// Whether the node is animated.
+        bool animated_;
+    };
+
+    /// Return the walk animation state of a node, creating it if necessary. Return null if the node is not animated.
+    AnimationState* GetState(Node* node);
+
+    /// Walk animation states by node ID.
+    HashMap<unsigned, BoundState> states_;
+    /// Walk animation.
+    SharedPtr<Animation> animation_;
+    /// Turn rate.
+    float turnRate_;
+    /// Animation playback speed at full speed.
+    float speedScale_;
+    /// Fade in time.
+    float fadeInTime_;
+    /// Fade out time.
+    float fadeOutTime_;
+};
+
+#endif //URHO3DSAMPLES_CROWDANIMATIONBINDING_H
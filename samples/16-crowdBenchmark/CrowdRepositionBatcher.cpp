@@ -0,0 +1,56 @@
+//
+// Created by AICDG on 2017/10/20.
+//
+
+#include <Urho3D/Navigation/CrowdAgent.h>
+#include <Urho3D/Navigation/CrowdManager.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "CrowdRepositionBatcher.h"
+
+CrowdRepositionBatcher::CrowdRepositionBatcher(Context* context) :
+    Object(context)
+{
+    batch_.timeStep_ = 0.0f;
+}
+
+void CrowdRepositionBatcher::SetScene(Scene* scene)
+{
+    if (scene_)
+        UnsubscribeFromEvent(scene_, E_SCENEPOSTUPDATE);
+
+    scene_ = scene;
+    // The crowd manager updates the agents in the scene subsystem update, which the scene post-update follows
+    if (scene_)
+        SubscribeToEvent(scene_, E_SCENEPOSTUPDATE, URHO3D_HANDLER(CrowdRepositionBatcher, HandleScenePostUpdate));
+}
+
+void CrowdRepositionBatcher::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    CrowdManager* crowdManager = scene_ ? scene_->GetComponent<CrowdManager>() : 0;
+    if (!crowdManager)
+        return;
+
+    batch_.agents_ = crowdManager->GetAgents();
+    batch_.timeStep_ = eventData[ScenePostUpdate::P_TIMESTEP].GetFloat();
+
+    const unsigned numAgents = batch_.agents_.Size();
+    batch_.nodes_.Resize(numAgents);
+    batch_.velocities_.Resize(numAgents);
+    for (unsigned i = 0; i < numAgents; ++i)
+    {
+        CrowdAgent* agent = batch_.agents_[i];
+        batch_.nodes_[i] = agent->GetNode();
+        batch_.velocities_[i] = agent->GetActualVelocity();
+    }
+
+    if (!numAgents)
+        return;
+
+    using namespace CrowdRepositionBatchEvent;
+
+    VariantMap& batchData = GetEventDataMap();
+    batchData[P_BATCH] = (void*)&batch_;
+    SendEvent(E_CROWDREPOSITIONBATCH, batchData);
+}
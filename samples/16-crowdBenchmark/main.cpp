@@ -0,0 +1,407 @@
+//
+// Created by AICDG on 2017/10/25.
+//
+
+#include <Urho3D/Urho3DAll.h>
+
+#ifdef __linux__
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+#include "CrowdAnimationBinding.h"
+#include "CrowdRepositionBatcher.h"
+
+using namespace Urho3D;
+
+/// Default random seed of the scene layout, spawn positions and group targets.
+static const unsigned DEFAULT_SEED = 12345;
+/// Default number of agents.
+static const unsigned DEFAULT_NUM_AGENTS = 10000;
+/// Default number of simulated frames.
+static const unsigned DEFAULT_NUM_FRAMES = 1000;
+/// Default number of agent groups sharing a target.
+static const unsigned DEFAULT_NUM_GROUPS = 16;
+/// Default interval in frames between group targets.
+static const unsigned DEFAULT_TARGET_INTERVAL = 300;
+/// Fixed simulation time step.
+static const float FIXED_TIMESTEP = 1.0f / 60.0f;
+/// Side length of the 14-crowdNavigation scene, which the scene is scaled up from.
+static const float BASE_WORLD_SIZE = 100.0f;
+/// Walkable area per agent, which sets the scaled world size.
+static const float AREA_PER_AGENT = 4.0f;
+/// Interval in frames between resident memory samples.
+static const unsigned MEMORY_SAMPLE_INTERVAL = 60;
+
+/// Return resident memory of the process in megabytes, or zero where it is not known.
+static float GetResidentMemory()
+{
+#ifdef __linux__
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0.0f;
+    if (fscanf(statm, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+    return (float)((double)resident * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0));
+#else
+    return 0.0f;
+#endif
+}
+
+class MyApp : public Application
+{
+public:
+    MyApp(Context* context)
+            : Application(context)
+            , seed_(DEFAULT_SEED)
+            , numAgents_(DEFAULT_NUM_AGENTS)
+            , numFrames_(DEFAULT_NUM_FRAMES)
+            , numGroups_(DEFAULT_NUM_GROUPS)
+            , targetInterval_(DEFAULT_TARGET_INTERVAL)
+            , animate_(true)
+            , worldSize_(BASE_WORLD_SIZE)
+            , numFailures_(0)
+            , animationTime_(0)
+    {
+        // Create the crowd reposition batcher and the walk animation binding, as in 14-crowdNavigation
+        repositionBatcher_ = new CrowdRepositionBatcher(context);
+        crowdAnimation_ = new CrowdAnimationBinding(context);
+    }
+    virtual void Setup()
+    {
+        // Called before engine initialization. engineParameters_ member variable can be modified here. No window is needed
+        engineParameters_[Urho3D::EP_WINDOW_TITLE] = "16 crowd benchmark";
+        engineParameters_[Urho3D::EP_HEADLESS]     = true;
+    }
+    virtual void Start()
+    {
+        // Write the results to the file given with -output, or next to the executable. The other options override the defaults
+        String outputName = GetSubsystem<FileSystem>()->GetProgramDir() + "CrowdBenchmark.json";
+        const Vector<String>& arguments = GetArguments();
+        for (unsigned i = 0; i < arguments.Size(); ++i)
+        {
+            const String argument = arguments[i].ToLower();
+            if (argument == "-noanimation")
+                animate_ = false;
+            else if (i + 1 >= arguments.Size())
+                continue;
+            else if (argument == "-output")
+                outputName = arguments[++i];
+            else if (argument == "-seed")
+                seed_ = ToUInt(arguments[++i]);
+            else if (argument == "-agents")
+                numAgents_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-frames")
+                numFrames_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-groups")
+                numGroups_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-targetinterval")
+                targetInterval_ = Max(ToUInt(arguments[++i]), 1U);
+        }
+
+        RunBenchmark(outputName);
+        engine_->Exit();
+    }
+
+    void RunBenchmark(const String& outputName)
+    {
+        const float memoryAtStart = GetResidentMemory();
+        HiresTimer timer;
+
+        CreateScene();
+        JSONValue setup;
+        setup.Set("sceneTime", timer.GetUSec(true) / 1000.0f);
+        SpawnAgents();
+        setup.Set("spawnTime", timer.GetUSec(true) / 1000.0f);
+        setup.Set("memory", GetResidentMemory());
+
+        SubscribeToEvent(E_CROWD_AGENT_FAILURE, URHO3D_HANDLER(MyApp, HandleCrowdAgentFailure));
+        if (animate_)
+            SubscribeToEvent(repositionBatcher_, E_CROWDREPOSITIONBATCH, URHO3D_HANDLER(MyApp, HandleCrowdRepositionBatch));
+
+        // Step the scene with a fixed time step. The scene holds only the navigation components and the agents, so the update
+        // time is the crowd and tile cache update, with the agent batching and animation binding timed separately
+        JSONValue frames;
+        PODVector<float> updateTimes;
+        PODVector<float> crowdTimes;
+        PODVector<float> animationTimes;
+        PODVector<float> targetTimes;
+        float peakMemory = 0.0f;
+        for (unsigned frame = 0; frame < numFrames_; ++frame)
+        {
+            if (frame % targetInterval_ == 0)
+            {
+                timer.Reset();
+                SetGroupTargets();
+                targetTimes.Push(timer.GetUSec(false) / 1000.0f);
+            }
+
+            const unsigned failuresBefore = numFailures_;
+            animationTime_ = 0;
+            timer.Reset();
+            scene_->Update(FIXED_TIMESTEP);
+            const float updateTime = timer.GetUSec(false) / 1000.0f;
+            const float animationTime = animationTime_ / 1000.0f;
+
+            updateTimes.Push(updateTime);
+            crowdTimes.Push(updateTime - animationTime);
+            animationTimes.Push(animationTime);
+
+            JSONValue frameResult;
+            frameResult.Set("update", updateTime);
+            frameResult.Set("crowd", updateTime - animationTime);
+            frameResult.Set("animation", animationTime);
+            frameResult.Set("failures", numFailures_ - failuresBefore);
+            if (frame % MEMORY_SAMPLE_INTERVAL == 0 || frame + 1 == numFrames_)
+            {
+                const float memory = GetResidentMemory();
+                frameResult.Set("memory", memory);
+                peakMemory = Max(peakMemory, memory);
+            }
+            frames.Push(frameResult);
+        }
+
+        CrowdManager* crowdManager = scene_->GetComponent<CrowdManager>();
+        JSONFile file(context_);
+        JSONValue& root = file.GetRoot();
+        root.Set("timeStamp", Time::GetTimeStamp());
+        root.Set("seed", seed_);
+        root.Set("threads", GetSubsystem<WorkQueue>()->GetNumThreads());
+        root.Set("agents", numAgents_);
+        root.Set("activeAgents", crowdManager->GetAgents().Size());
+        root.Set("frames", numFrames_);
+        root.Set("timeStep", FIXED_TIMESTEP);
+        root.Set("groups", numGroups_);
+        root.Set("targetInterval", targetInterval_);
+        root.Set("animation", animate_);
+        root.Set("worldSize", worldSize_);
+        root.Set("setup", setup);
+        root.Set("update", SummarizeTimes(updateTimes));
+        root.Set("crowdUpdate", SummarizeTimes(crowdTimes));
+        root.Set("animationUpdate", SummarizeTimes(animationTimes));
+        root.Set("setTargets", SummarizeTimes(targetTimes));
+        root.Set("failures", numFailures_);
+        root.Set("memoryAtStart", memoryAtStart);
+        root.Set("peakMemory", peakMemory);
+        root.Set("frameResults", frames);
+        if (file.SaveFile(outputName))
+            URHO3D_LOGINFO("Wrote crowd benchmark results to " + outputName);
+        else
+            URHO3D_LOGERROR("Could not write crowd benchmark results to " + outputName);
+
+        URHO3D_LOGINFOF("%u agents, %u frames: crowd update p50 %.2f ms p99 %.2f ms, animation p50 %.2f ms, %u failures",
+            numAgents_, numFrames_, root.Get("crowdUpdate").Get("p50").GetFloat(),
+            root.Get("crowdUpdate").Get("p99").GetFloat(), root.Get("animationUpdate").Get("p50").GetFloat(), numFailures_);
+    }
+
+    void CreateScene()
+    {
+        // Same layout as 14-crowdNavigation, scaled up so that the agents have about the same room. The box and mushroom
+        // counts grow with the area
+        ResourceCache* cache = GetSubsystem<ResourceCache>();
+        SetRandomSeed(seed_);
+        worldSize_ = Max(BASE_WORLD_SIZE, sqrtf(numAgents_ * AREA_PER_AGENT));
+        const float scale = worldSize_ / BASE_WORLD_SIZE;
+        const unsigned numBoxes = (unsigned)(20 * scale * scale);
+        const unsigned numMushrooms = (unsigned)(100 * scale * scale);
+
+        scene_ = new Scene(context_);
+        // Batch the agents only when they are animated, so that the crowd time has no batching in it. The batching is timed
+        // with the animation: the timer starts in this post-update handler, which runs before the batcher's as it is
+        // subscribed first
+        if (animate_)
+        {
+            SubscribeToEvent(scene_, E_SCENEPOSTUPDATE, URHO3D_HANDLER(MyApp, HandleScenePostUpdate));
+            repositionBatcher_->SetScene(scene_);
+        }
+        crowdAnimation_->SetAnimation(cache->GetResource<Animation>("Models/Kachujin/Kachujin_Walk.ani"));
+        scene_->CreateComponent<Octree>()->SetSize(BoundingBox(-worldSize_, worldSize_), 8);
+
+        Node* planeNode = scene_->CreateChild("Plane");
+        planeNode->SetScale(Vector3(worldSize_, 1.0f, worldSize_));
+        StaticModel* planeObject = planeNode->CreateComponent<StaticModel>();
+        planeObject->SetModel(cache->GetResource<Model>("Models/Plane.mdl"));
+
+        Node* boxGroup = scene_->CreateChild("Boxes");
+        for (unsigned i = 0; i < numBoxes; ++i)
+        {
+            Node* boxNode = boxGroup->CreateChild("Box");
+            float size = 1.0f + Random(10.0f);
+            boxNode->SetPosition(Vector3(Random(0.8f) - 0.4f, 0.0f, Random(0.8f) - 0.4f) * worldSize_ +
+                Vector3(0.0f, size * 0.5f, 0.0f));
+            boxNode->SetScale(size);
+            StaticModel* boxObject = boxNode->CreateComponent<StaticModel>();
+            boxObject->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
+        }
+
+        // The tile cache has to hold all the mushroom obstacles
+        DynamicNavigationMesh* navMesh = scene_->CreateComponent<DynamicNavigationMesh>();
+        navMesh->SetTileSize(32);
+        navMesh->SetAgentHeight(10.0f);
+        navMesh->SetCellHeight(0.05f);
+        navMesh->SetMaxObstacles(Max(numMushrooms * 2, 1024U));
+        scene_->CreateComponent<Navigable>();
+        navMesh->SetPadding(Vector3(0.0f, 10.0f, 0.0f));
+        navMesh->Build();
+
+        for (unsigned i = 0; i < numMushrooms; ++i)
+        {
+            Node* mushroomNode = scene_->CreateChild("Mushroom");
+            mushroomNode->SetPosition(Vector3(Random(0.9f) - 0.45f, 0.0f, Random(0.9f) - 0.45f) * worldSize_);
+            mushroomNode->SetRotation(Quaternion(0.0f, Random(360.0f), 0.0f));
+            mushroomNode->SetScale(2.0f + Random(0.5f));
+            StaticModel* mushroomObject = mushroomNode->CreateComponent<StaticModel>();
+            mushroomObject->SetModel(cache->GetResource<Model>("Models/Mushroom.mdl"));
+            Obstacle* obstacle = mushroomNode->CreateComponent<Obstacle>();
+            obstacle->SetRadius(mushroomNode->GetScale().x_);
+            obstacle->SetHeight(mushroomNode->GetScale().y_);
+        }
+
+        // Same obstacle avoidance settings as 14-crowdNavigation, with room for all agents
+        CrowdManager* crowdManager = scene_->CreateComponent<CrowdManager>();
+        crowdManager->SetMaxAgents(numAgents_);
+        CrowdObstacleAvoidanceParams params = crowdManager->GetObstacleAvoidanceParams(0);
+        params.velBias = 0.5f;
+        params.adaptiveDivs = 7;
+        params.adaptiveRings = 3;
+        params.adaptiveDepth = 3;
+        crowdManager->SetObstacleAvoidanceParams(0, params);
+
+        // Let the tile cache take in the obstacles before the agents are spawned
+        for (unsigned i = 0; i < 60; ++i)
+            scene_->Update(FIXED_TIMESTEP);
+    }
+
+    void SpawnAgents()
+    {
+        // Spawn the agents like the jacks of 14-crowdNavigation at seeded positions, spread over the groups
+        ResourceCache* cache = GetSubsystem<ResourceCache>();
+        DynamicNavigationMesh* navMesh = scene_->GetComponent<DynamicNavigationMesh>();
+        Model* model = cache->GetResource<Model>("Models/Kachujin/Kachujin.mdl");
+        SetRandomSeed(seed_ + 1);
+
+        groups_.Clear();
+        for (unsigned i = 0; i < numGroups_; ++i)
+            groups_.Push(SharedPtr<Node>(scene_->CreateChild("Jacks")));
+
+        for (unsigned i = 0; i < numAgents_; ++i)
+        {
+            const Vector3 position(Random(0.9f) - 0.45f, 0.0f, Random(0.9f) - 0.45f);
+            Node* jackNode = groups_[i % numGroups_]->CreateChild("Jack");
+            jackNode->SetPosition(navMesh->FindNearestPoint(position * worldSize_, Vector3(5.0f, 5.0f, 5.0f)));
+            if (animate_)
+                jackNode->CreateComponent<AnimatedModel>()->SetModel(model);
+
+            CrowdAgent* agent = jackNode->CreateComponent<CrowdAgent>();
+            agent->SetHeight(2.0f);
+            agent->SetMaxSpeed(3.0f);
+            agent->SetMaxAccel(5.0f);
+        }
+    }
+
+    void SetGroupTargets()
+    {
+        // Send each group to a seeded target, spread around it as far as the group needs room
+        DynamicNavigationMesh* navMesh = scene_->GetComponent<DynamicNavigationMesh>();
+        CrowdManager* crowdManager = scene_->GetComponent<CrowdManager>();
+        const float spreadRadius = sqrtf(numAgents_ / numGroups_ * AREA_PER_AGENT) * 0.5f;
+        for (unsigned i = 0; i < groups_.Size(); ++i)
+        {
+            const Vector3 target = navMesh->FindNearestPoint(
+                Vector3(Random(0.9f) - 0.45f, 0.0f, Random(0.9f) - 0.45f) * worldSize_, Vector3(5.0f, 5.0f, 5.0f));
+            const PODVector<CrowdAgent*> agents = crowdManager->GetAgents(groups_[i], false);
+            for (unsigned j = 0; j < agents.Size(); ++j)
+                agents[j]->SetTargetPosition(navMesh->GetRandomPointInCircle(target, spreadRadius));
+        }
+    }
+
+    JSONValue SummarizeTimes(PODVector<float>& times)
+    {
+        // Times in milliseconds, percentiles by nearest rank
+        JSONValue summary;
+        summary.Set("count", times.Size());
+        if (times.Empty())
+            return summary;
+
+        Sort(times.Begin(), times.End());
+        float total = 0.0f;
+        for (unsigned i = 0; i < times.Size(); ++i)
+            total += times[i];
+
+        summary.Set("mean", total / times.Size());
+        summary.Set("min", times.Front());
+        summary.Set("p50", GetPercentile(times, 50.0f));
+        summary.Set("p90", GetPercentile(times, 90.0f));
+        summary.Set("p99", GetPercentile(times, 99.0f));
+        summary.Set("max", times.Back());
+        return summary;
+    }
+
+    float GetPercentile(const PODVector<float>& sortedTimes, float percent)
+    {
+        const unsigned rank = (unsigned)ceilf(percent / 100.0f * sortedTimes.Size());
+        return sortedTimes[Clamp(rank, 1U, sortedTimes.Size()) - 1];
+    }
+
+    void HandleCrowdAgentFailure(StringHash eventType, VariantMap& eventData)
+    {
+        using namespace CrowdAgentFailure;
+
+        ++numFailures_;
+
+        // Move invalid agents back onto the navigation mesh like 14-crowdNavigation does
+        Node* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
+        CrowdAgentState agentState = (CrowdAgentState)eventData[P_CROWD_AGENT_STATE].GetInt();
+        if (agentState == CA_STATE_INVALID)
+            node->SetPosition(scene_->GetComponent<DynamicNavigationMesh>()->FindNearestPoint(node->GetPosition(),
+                Vector3(5.0f, 5.0f, 5.0f)));
+    }
+
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+    {
+        animationTimer_.Reset();
+    }
+
+    void HandleCrowdRepositionBatch(StringHash eventType, VariantMap& eventData)
+    {
+        using namespace CrowdRepositionBatchEvent;
+
+        const CrowdRepositionBatch& batch = *static_cast<const CrowdRepositionBatch*>(eventData[P_BATCH].GetVoidPtr());
+        crowdAnimation_->Apply(batch);
+        animationTime_ += animationTimer_.GetUSec(false);
+    }
+
+private:
+    /// Scene.
+    SharedPtr<Scene> scene_;
+    /// Agent groups.
+    Vector<SharedPtr<Node> > groups_;
+    /// Crowd reposition batcher.
+    SharedPtr<CrowdRepositionBatcher> repositionBatcher_;
+    /// Walk animation binding of the agents.
+    SharedPtr<CrowdAnimationBinding> crowdAnimation_;
+    /// Random seed.
+    unsigned seed_;
+    /// Number of agents.
+    unsigned numAgents_;
+    /// Number of simulated frames.
+    unsigned numFrames_;
+    /// Number of agent groups.
+    unsigned numGroups_;
+    /// Interval in frames between group targets.
+    unsigned targetInterval_;
+    /// Flag for animating the agents.
+    bool animate_;
+    /// Scaled world size.
+    float worldSize_;
+    /// Number of agent failure events.
+    unsigned numFailures_;
+    /// Timer of the agent batching and animation, started at the scene post-update.
+    HiresTimer animationTimer_;
+    /// Time spent batching and animating the agents on the current frame in microseconds.
+    long long animationTime_;
+};
+URHO3D_DEFINE_APPLICATION_MAIN(MyApp)
@@ -0,0 +1,183 @@
+//
+// Created by AICDG on 2017/10/28.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "ProjectilePool.h"
+
+ProjectilePool::ProjectilePool(Context* context) :
+    Component(context),
+    spawnCounter_(0),
+    numRecycled_(0)
+{
+}
+
+void ProjectilePool::RegisterObject(Context* context)
+{
+    context->RegisterFactory<ProjectilePool>();
+}
+
+void ProjectilePool::Allocate(Node* prototype, unsigned capacity)
+{
+    if (!prototype || prototype->GetParent() != node_ || !prototype->GetComponent<RigidBody>())
+    {
+        URHO3D_LOGERROR("Projectile prototype must be a child of the pool node and have a rigid body");
+        return;
+    }
+
+    for (unsigned i = 0; i < projectiles_.Size(); ++i)
+    {
+        Node* node = projectiles_[i].node_;
+        if (node && node != prototype)
+            node->Remove();
+    }
+    projectiles_.Clear();
+    freeProjectiles_.Clear();
+    spawnCounter_ = 0;
+    numRecycled_ = 0;
+
+    // Disable the prototype before cloning, so that the clones start out of the physics world
+    prototype->SetTemporary(true);
+    prototype->SetEnabled(false);
+    capacity = Max(capacity, 1U);
+    projectiles_.Resize(capacity);
+    for (unsigned i = 0; i < capacity; ++i)
+    {
+        Node* node = i ? prototype->Clone() : prototype;
+        node->SetTemporary(true);
+
+        Projectile& projectile = projectiles_[i];
+        projectile.node_ = node;
+        projectile.body_ = node->GetComponent<RigidBody>();
+        projectile.spawnNumber_ = 0;
+        projectile.active_ = false;
+    }
+
+    // Hand out the projectiles in order, the free list is used from the back
+    freeProjectiles_.Resize(capacity);
+    for (unsigned i = 0; i < capacity; ++i)
+        freeProjectiles_[i] = capacity - 1 - i;
+}
+
+Node* ProjectilePool::Spawn(const Vector3& position, const Quaternion& rotation, const Vector3& linearVelocity)
+{
+    if (projectiles_.Empty())
+        return 0;
+
+    unsigned index;
+    if (!freeProjectiles_.Empty())
+    {
+        index = freeProjectiles_.Back();
+        freeProjectiles_.Pop();
+    }
+    else
+    {
+        index = SelectRecycled();
+        ++numRecycled_;
+    }
+
+    Projectile& projectile = projectiles_[index];
+    Node* node = projectile.node_;
+    RigidBody* body = projectile.body_;
+    if (!node || !body)
+        return 0;
+
+    // Enabling adds the existing body back to the physics world. A recycled projectile stays in the world and is only moved
+    if (!projectile.active_)
+        node->SetEnabled(true);
+    node->SetWorldTransform(position, rotation);
+    body->ResetForces();
+    body->SetAngularVelocity(Vector3::ZERO);
+    body->SetLinearVelocity(linearVelocity);
+    body->Activate();
+
+    projectile.spawnNumber_ = ++spawnCounter_;
+    projectile.active_ = true;
+    return node;
+}
+
+void ProjectilePool::Release(Node* projectile)
+{
+    for (unsigned i = 0; i < projectiles_.Size(); ++i)
+    {
+        if (projectiles_[i].node_ == projectile)
+        {
+            if (projectiles_[i].active_)
+                Deactivate(i);
+            return;
+        }
+    }
+}
+
+void ProjectilePool::ReleaseAll()
+{
+    for (unsigned i = 0; i < projectiles_.Size(); ++i)
+    {
+        if (projectiles_[i].active_)
+            Deactivate(i);
+    }
+}
+
+void ProjectilePool::SetBounds(const BoundingBox& bounds)
+{
+    bounds_ = bounds;
+}
+
+void ProjectilePool::OnSceneSet(Scene* scene)
+{
+    if (scene)
+        SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(ProjectilePool, HandleScenePostUpdate));
+    else
+        UnsubscribeFromEvent(E_SCENEPOSTUPDATE);
+}
+
+void ProjectilePool::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (!bounds_.Defined())
+        return;
+
+    for (unsigned i = 0; i < projectiles_.Size(); ++i)
+    {
+        const Projectile& projectile = projectiles_[i];
+        if (projectile.active_ && projectile.node_ && bounds_.IsInside(projectile.node_->GetWorldPosition()) == OUTSIDE)
+            Deactivate(i);
+    }
+}
+
+unsigned ProjectilePool::SelectRecycled() const
+{
+    // Out of bounds projectiles are normally released on the scene post-update, but may have left the bounds since
+    unsigned oldest = 0;
+    unsigned oldestSleeping = M_MAX_UNSIGNED;
+    for (unsigned i = 0; i < projectiles_.Size(); ++i)
+    {
+        const Projectile& projectile = projectiles_[i];
+        if (!projectile.node_ || !projectile.body_)
+            continue;
+        if (bounds_.Defined() && bounds_.IsInside(projectile.node_->GetWorldPosition()) == OUTSIDE)
+            return i;
+
+        if (projectile.spawnNumber_ < projectiles_[oldest].spawnNumber_)
+            oldest = i;
+        if (!projectile.body_->IsActive() &&
+            (oldestSleeping == M_MAX_UNSIGNED || projectile.spawnNumber_ < projectiles_[oldestSleeping].spawnNumber_))
+            oldestSleeping = i;
+    }
+
+    return oldestSleeping != M_MAX_UNSIGNED ? oldestSleeping : oldest;
+}
+
+void ProjectilePool::Deactivate(unsigned index)
+{
+    // Disabling takes the body out of the physics world and the drawable out of the octree, both are kept for the next spawn
+    Projectile& projectile = projectiles_[index];
+    if (projectile.node_)
+        projectile.node_->SetEnabled(false);
+    projectile.active_ = false;
+    freeProjectiles_.Push(index);
+}
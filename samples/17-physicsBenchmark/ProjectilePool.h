@@ -0,0 +1,93 @@
+//
+// Created by AICDG on 2017/10/28.
+//
+
+#ifndef URHO3DSAMPLES_PROJECTILEPOOL_H
+#define URHO3DSAMPLES_PROJECTILEPOOL_H
+
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Scene/Component.h>
+
+namespace Urho3D
+{
+
+class RigidBody;
+
+}
+
+using namespace Urho3D;
+
+/// Fixed capacity pool of physics projectiles. The projectile nodes, with their drawables, rigid bodies and collision shapes,
+/// are cloned from a prototype once. Spawning enables a free projectile and resets its transform and velocities, releasing
+/// disables it, which takes its body out of the physics world without destroying it. Projectiles that leave the bounds are
+/// released automatically. When all projectiles are in use, spawning recycles an out of bounds one first, then the oldest
+/// sleeping one, then the oldest one. The projectile nodes are temporary, so they are not saved with the scene.
+class ProjectilePool : public Component
+{
+    URHO3D_OBJECT(ProjectilePool, Component);
+
+public:
+    /// Construct.
+    ProjectilePool(Context* context);
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Build the pool by cloning a prototype node, which becomes the first projectile. The prototype must be a child of the
+    /// pool's node and have a RigidBody. Previous projectiles are removed.
+    void Allocate(Node* prototype, unsigned capacity);
+    /// Spawn a projectile. Return its node, or null if the pool has not been allocated.
+    Node* Spawn(const Vector3& position, const Quaternion& rotation, const Vector3& linearVelocity);
+    /// Release a projectile back to the pool.
+    void Release(Node* projectile);
+    /// Release all projectiles.
+    void ReleaseAll();
+    /// Set world space bounds, outside of which projectiles are released.
+    void SetBounds(const BoundingBox& bounds);
+
+    /// Return world space bounds.
+    const BoundingBox& GetBounds() const { return bounds_; }
+    /// Return capacity.
+    unsigned GetCapacity() const { return projectiles_.Size(); }
+    /// Return number of projectiles in use.
+    unsigned GetNumActive() const { return projectiles_.Size() - freeProjectiles_.Size(); }
+    /// Return number of projectiles recycled while still in use since allocation.
+    unsigned GetNumRecycled() const { return numRecycled_; }
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Pooled projectile.
+    struct Projectile
+    {
+        /// Projectile node.
+        WeakPtr<Node> node_;
+        /// Rigid body.
+        WeakPtr<RigidBody> body_;
+        /// Spawn sequence number, for finding the oldest projectile.
+        unsigned spawnNumber_;
+        /// Whether in use.
+        bool active_;
+    };
+
+    /// Handle the scene post-update. Release the projectiles out of bounds.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Select the projectile to recycle when none are free.
+    unsigned SelectRecycled() const;
+    /// Disable a projectile and return it to the free list.
+    void Deactivate(unsigned index);
+
+    /// Projectiles.
+    Vector<Projectile> projectiles_;
+    /// Indices of the free projectiles.
+    PODVector<unsigned> freeProjectiles_;
+    /// World space bounds.
+    BoundingBox bounds_;
+    /// Spawn counter.
+    unsigned spawnCounter_;
+    /// Number of projectiles recycled while in use.
+    unsigned numRecycled_;
+};
+
+#endif //URHO3DSAMPLES_PROJECTILEPOOL_H
@@ -0,0 +1,420 @@
+//
+// Created by AICDG on 2017/10/30.
+//
+
+#include <Urho3D/Urho3DAll.h>
+
+#include <Bullet/BulletCollision/BroadphaseCollision/btDispatcher.h>
+#include <Bullet/BulletCollision/BroadphaseCollision/btOverlappingPairCache.h>
+#include <Bullet/BulletCollision/NarrowPhaseCollision/btPersistentManifold.h>
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+
+#ifdef __linux__
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+#include "CollisionShapeCache.h"
+#include "ProjectilePool.h"
+#include "SharedCollisionShape.h"
+
+using namespace Urho3D;
+
+/// Default random seed of the projectile script.
+static const unsigned DEFAULT_SEED = 12345;
+/// Default number of projectiles fired.
+static const unsigned DEFAULT_NUM_PROJECTILES = 10000;
+/// Default number of simulated frames.
+static const unsigned DEFAULT_NUM_FRAMES = 1000;
+/// Default number of projectiles fired per frame.
+static const unsigned DEFAULT_FIRE_RATE = 20;
+/// Default number of rows of the box pyramid, as in 08-physics.
+static const unsigned DEFAULT_PYRAMID_ROWS = 8;
+/// Fixed simulation time step.
+static const float FIXED_TIMESTEP = 1.0f / 60.0f;
+/// Projectile speed, as in 08-physics.
+static const float OBJECT_VELOCITY = 30.0f;
+/// Interval in frames between resident memory samples.
+static const unsigned MEMORY_SAMPLE_INTERVAL = 60;
+
+/// Return resident memory of the process in megabytes, or zero where it is not known.
+static float GetResidentMemory()
+{
+#ifdef __linux__
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (!statm)
+        return 0.0f;
+    if (fscanf(statm, "%lu %lu", &size, &resident) != 2)
+        resident = 0;
+    fclose(statm);
+    return (float)((double)resident * sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0));
+#else
+    return 0.0f;
+#endif
+}
+
+/// Return peak resident memory of the process in megabytes, or zero where it is not known.
+static float GetPeakResidentMemory()
+{
+#ifdef __linux__
+    unsigned long peak = 0;
+    char line[256];
+    FILE* status = fopen("/proc/self/status", "r");
+    if (!status)
+        return 0.0f;
+    while (fgets(line, sizeof(line), status))
+    {
+        if (sscanf(line, "VmHWM: %lu kB", &peak) == 1)
+            break;
+    }
+    fclose(status);
+    return (float)(peak / 1024.0);
+#else
+    return 0.0f;
+#endif
+}
+
+class MyApp : public Application
+{
+public:
+    MyApp(Context* context)
+            : Application(context)
+            , seed_(DEFAULT_SEED)
+            , numProjectiles_(DEFAULT_NUM_PROJECTILES)
+            , numFrames_(DEFAULT_NUM_FRAMES)
+            , fireRate_(DEFAULT_FIRE_RATE)
+            , pyramidRows_(DEFAULT_PYRAMID_ROWS)
+            , poolCapacity_(0)
+            , sharedShapes_(false)
+            , numFired_(0)
+            , stepTime_(0)
+    {
+        // Register the projectile pool and the shared collision shapes of 08-physics, which can be benchmarked against the
+        // plain SpawnObject() projectiles
+        ProjectilePool::RegisterObject(context);
+        context->RegisterSubsystem(new CollisionShapeCache(context));
+        SharedCollisionShape::RegisterObject(context);
+    }
+    virtual void Setup()
+    {
+        // Called before engine initialization. engineParameters_ member variable can be modified here. No window is needed
+        engineParameters_[Urho3D::EP_WINDOW_TITLE] = "17 physics benchmark";
+        engineParameters_[Urho3D::EP_HEADLESS]     = true;
+    }
+    virtual void Start()
+    {
+        // Write the results to the file given with -output, or next to the executable. The other options override the defaults
+        String outputName = GetSubsystem<FileSystem>()->GetProgramDir() + "PhysicsBenchmark.json";
+        const Vector<String>& arguments = GetArguments();
+        for (unsigned i = 0; i < arguments.Size(); ++i)
+        {
+            const String argument = arguments[i].ToLower();
+            if (argument == "-sharedshapes")
+                sharedShapes_ = true;
+            else if (i + 1 >= arguments.Size())
+                continue;
+            else if (argument == "-output")
+                outputName = arguments[++i];
+            else if (argument == "-seed")
+                seed_ = ToUInt(arguments[++i]);
+            else if (argument == "-projectiles")
+                numProjectiles_ = ToUInt(arguments[++i]);
+            else if (argument == "-frames")
+                numFrames_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-rate")
+                fireRate_ = Max(ToUInt(arguments[++i]), 1U);
+            else if (argument == "-rows")
+                pyramidRows_ = ToUInt(arguments[++i]);
+            else if (argument == "-pool")
+                poolCapacity_ = ToUInt(arguments[++i]);
+        }
+
+        RunBenchmark(outputName);
+        engine_->Exit();
+    }
+
+    void RunBenchmark(const String& outputName)
+    {
+        const float memoryAtStart = GetResidentMemory();
+        HiresTimer timer;
+
+        CreateScene();
+        JSONValue setup;
+        setup.Set("sceneTime", timer.GetUSec(true) / 1000.0f);
+        setup.Set("memory", GetResidentMemory());
+
+        PhysicsWorld* physicsWorld = scene_->GetComponent<PhysicsWorld>();
+        SubscribeToEvent(physicsWorld, E_PHYSICSPRESTEP, URHO3D_HANDLER(MyApp, HandlePhysicsPreStep));
+        SubscribeToEvent(physicsWorld, E_PHYSICSPOSTSTEP, URHO3D_HANDLER(MyApp, HandlePhysicsPostStep));
+
+        // Fire the scripted projectiles and step the scene with a fixed time step. The step time is the Bullet simulation step
+        // alone, the update time adds the transform updates of the moved nodes
+        SetRandomSeed(seed_);
+        JSONValue frames;
+        PODVector<float> updateTimes;
+        PODVector<float> stepTimes;
+        PODVector<float> spawnTimes;
+        float peakMemory = 0.0f;
+        unsigned maxPairs = 0;
+        unsigned maxContacts = 0;
+        unsigned maxActiveBodies = 0;
+        for (unsigned frame = 0; frame < numFrames_; ++frame)
+        {
+            timer.Reset();
+            const unsigned numSpawned = Min(fireRate_, numProjectiles_ - numFired_);
+            for (unsigned i = 0; i < numSpawned; ++i)
+                FireProjectile();
+            const float spawnTime = timer.GetUSec(false) / 1000.0f;
+            if (numSpawned)
+                spawnTimes.Push(spawnTime);
+
+            stepTime_ = 0;
+            timer.Reset();
+            scene_->Update(FIXED_TIMESTEP);
+            const float updateTime = timer.GetUSec(false) / 1000.0f;
+            const float stepTime = stepTime_ / 1000.0f;
+            updateTimes.Push(updateTime);
+            stepTimes.Push(stepTime);
+
+            unsigned numPairs;
+            unsigned numManifolds;
+            unsigned numContacts;
+            unsigned numBodies;
+            unsigned numActiveBodies;
+            GetWorldStatistics(numPairs, numManifolds, numContacts, numBodies, numActiveBodies);
+            maxPairs = Max(maxPairs, numPairs);
+            maxContacts = Max(maxContacts, numContacts);
+            maxActiveBodies = Max(maxActiveBodies, numActiveBodies);
+
+            JSONValue frameResult;
+            frameResult.Set("update", updateTime);
+            frameResult.Set("step", stepTime);
+            frameResult.Set("spawn", spawnTime);
+            frameResult.Set("spawned", numSpawned);
+            frameResult.Set("pairs", numPairs);
+            frameResult.Set("manifolds", numManifolds);
+            frameResult.Set("contacts", numContacts);
+            frameResult.Set("bodies", numBodies);
+            frameResult.Set("activeBodies", numActiveBodies);
+            if (frame % MEMORY_SAMPLE_INTERVAL == 0 || frame + 1 == numFrames_)
+            {
+                const float memory = GetResidentMemory();
+                frameResult.Set("memory", memory);
+                peakMemory = Max(peakMemory, memory);
+            }
+            frames.Push(frameResult);
+        }
+
+        JSONFile file(context_);
+        JSONValue& root = file.GetRoot();
+        root.Set("timeStamp", Time::GetTimeStamp());
+        root.Set("seed", seed_);
+        root.Set("threads", GetSubsystem<WorkQueue>()->GetNumThreads());
+        root.Set("projectiles", numProjectiles_);
+        root.Set("fired", numFired_);
+        root.Set("frames", numFrames_);
+        root.Set("timeStep", FIXED_TIMESTEP);
+        root.Set("fireRate", fireRate_);
+        root.Set("pyramidRows", pyramidRows_);
+        root.Set("poolCapacity", poolCapacity_);
+        root.Set("sharedShapes", sharedShapes_);
+        if (sharedShapes_)
+            root.Set("sharedShapeCount", GetSubsystem<CollisionShapeCache>()->GetNumShapes());
+        root.Set("setup", setup);
+        root.Set("update", SummarizeTimes(updateTimes));
+        root.Set("physicsStep", SummarizeTimes(stepTimes));
+        root.Set("spawn", SummarizeTimes(spawnTimes));
+        root.Set("maxPairs", maxPairs);
+        root.Set("maxContacts", maxContacts);
+        root.Set("maxActiveBodies", maxActiveBodies);
+        root.Set("memoryAtStart", memoryAtStart);
+        // The sampled peak misses short spikes between the samples, the high water mark of the process does not
+        root.Set("peakMemory", Max(peakMemory, GetPeakResidentMemory()));
+        root.Set("frameResults", frames);
+        if (file.SaveFile(outputName))
+            URHO3D_LOGINFO("Wrote physics benchmark results to " + outputName);
+        else
+            URHO3D_LOGERROR("Could not write physics benchmark results to " + outputName);
+
+        URHO3D_LOGINFOF("%u projectiles, %u frames: physics step p50 %.2f ms p99 %.2f ms, max %u pairs, %u contacts",
+            numFired_, numFrames_, root.Get("physicsStep").Get("p50").GetFloat(), root.Get("physicsStep").Get("p99").GetFloat(),
+            maxPairs, maxContacts);
+    }
+
+    void CreateScene()
+    {
+        // Same scene as 08-physics without the rendering-only content: the floor and the box pyramid
+        ResourceCache* cache = GetSubsystem<ResourceCache>();
+        Model* boxModel = cache->GetResource<Model>("Models/Box.mdl");
+
+        scene_ = new Scene(context_);
+        scene_->CreateComponent<Octree>();
+        scene_->CreateComponent<PhysicsWorld>()->SetFps(60);
+
+        Node* floorNode = scene_->CreateChild("Floor");
+        floorNode->SetPosition(Vector3(0.0f, -0.5f, 0.0f));
+        floorNode->SetScale(Vector3(1000.0f, 1.0f, 1000.0f));
+        floorNode->CreateComponent<StaticModel>()->SetModel(boxModel);
+        floorNode->CreateComponent<RigidBody>();
+        floorNode->CreateComponent<CollisionShape>()->SetBox(Vector3::ONE);
+
+        for (int y = 0; y < (int)pyramidRows_; ++y)
+        {
+            for (int x = -y; x <= y; ++x)
+            {
+                Node* boxNode = scene_->CreateChild("Box");
+                boxNode->SetPosition(Vector3((float)x, -(float)y + (float)pyramidRows_, 0.0f));
+                boxNode->CreateComponent<StaticModel>()->SetModel(boxModel);
+                RigidBody* body = boxNode->CreateComponent<RigidBody>();
+                body->SetMass(1.0f);
+                body->SetFriction(0.75f);
+                CreateBoxShape(boxNode);
+            }
+        }
+
+        // With -pool, the projectiles come from a pool of the given capacity like in 08-physics
+        if (poolCapacity_)
+        {
+            Node* poolNode = scene_->CreateChild("Projectiles");
+            projectilePool_ = poolNode->CreateComponent<ProjectilePool>();
+            projectilePool_->SetBounds(BoundingBox(Vector3(-500.0f, -50.0f, -500.0f), Vector3(500.0f, 500.0f, 500.0f)));
+            projectilePool_->Allocate(CreateProjectile(poolNode), poolCapacity_);
+        }
+    }
+
+    Node* CreateProjectile(Node* parent)
+    {
+        // The smaller box of SpawnObject() in 08-physics
+        ResourceCache* cache = GetSubsystem<ResourceCache>();
+        Node* boxNode = parent->CreateChild("SmallBox");
+        boxNode->SetScale(0.25f);
+        boxNode->CreateComponent<StaticModel>()->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
+        RigidBody* body = boxNode->CreateComponent<RigidBody>();
+        body->SetMass(0.25f);
+        body->SetFriction(0.75f);
+        CreateBoxShape(boxNode);
+        return boxNode;
+    }
+
+    void CreateBoxShape(Node* node)
+    {
+        if (sharedShapes_)
+            node->CreateComponent<SharedCollisionShape>()->SetBox(Vector3::ONE);
+        else
+            node->CreateComponent<CollisionShape>()->SetBox(Vector3::ONE);
+    }
+
+    void FireProjectile()
+    {
+        // Shoot from a seeded point behind the camera position of 08-physics at a seeded point of the pyramid, with the same
+        // slight up component as SpawnObject()
+        const float height = (float)Max(pyramidRows_, 1U);
+        const Vector3 origin(Random(-20.0f, 20.0f), Random(2.0f, 10.0f), Random(-30.0f, -20.0f));
+        const Vector3 target(Random(-height, height), Random(0.0f, height), 0.0f);
+        Quaternion rotation;
+        rotation.FromLookRotation((target - origin).Normalized());
+        const Vector3 velocity = rotation * Vector3(0.0f, 0.25f, 1.0f) * OBJECT_VELOCITY;
+        ++numFired_;
+
+        if (projectilePool_)
+        {
+            projectilePool_->Spawn(origin, rotation, velocity);
+            return;
+        }
+
+        Node* boxNode = CreateProjectile(scene_);
+        boxNode->SetPosition(origin);
+        boxNode->SetRotation(rotation);
+        boxNode->GetComponent<RigidBody>()->SetLinearVelocity(velocity);
+    }
+
+    void GetWorldStatistics(unsigned& numPairs, unsigned& numManifolds, unsigned& numContacts, unsigned& numBodies,
+        unsigned& numActiveBodies)
+    {
+        // Broadphase pairs are the overlapping bounding boxes, contacts the points of the narrowphase manifolds
+        btDiscreteDynamicsWorld* world = scene_->GetComponent<PhysicsWorld>()->GetWorld();
+        numPairs = (unsigned)world->getPairCache()->getNumOverlappingPairs();
+
+        btDispatcher* dispatcher = world->getDispatcher();
+        numManifolds = (unsigned)dispatcher->getNumManifolds();
+        numContacts = 0;
+        for (unsigned i = 0; i < numManifolds; ++i)
+            numContacts += (unsigned)dispatcher->getManifoldByIndexInternal(i)->getNumContacts();
+
+        const btCollisionObjectArray& objects = world->getCollisionObjectArray();
+        numBodies = (unsigned)objects.size();
+        numActiveBodies = 0;
+        for (int i = 0; i < objects.size(); ++i)
+        {
+            if (!objects[i]->isStaticObject() && objects[i]->isActive())
+                ++numActiveBodies;
+        }
+    }
+
+    JSONValue SummarizeTimes(PODVector<float>& times)
+    {
+        // Times in milliseconds, percentiles by nearest rank
+        JSONValue summary;
+        summary.Set("count", times.Size());
+        if (times.Empty())
+            return summary;
+
+        Sort(times.Begin(), times.End());
+        float total = 0.0f;
+        for (unsigned i = 0; i < times.Size(); ++i)
+            total += times[i];
+
+        summary.Set("mean", total / times.Size());
+        summary.Set("min", times.Front());
+        summary.Set("p50", GetPercentile(times, 50.0f));
+        summary.Set("p90", GetPercentile(times, 90.0f));
+        summary.Set("p99", GetPercentile(times, 99.0f));
+        summary.Set("max", times.Back());
+        return summary;
+    }
+
+    float GetPercentile(const PODVector<float>& sortedTimes, float percent)
+    {
+        const unsigned rank = (unsigned)ceilf(percent / 100.0f * sortedTimes.Size());
+        return sortedTimes[Clamp(rank, 1U, sortedTimes.Size()) - 1];
+    }
+
+    void HandlePhysicsPreStep(StringHash eventType, VariantMap& eventData)
+    {
+        stepTimer_.Reset();
+    }
+
+    void HandlePhysicsPostStep(StringHash eventType, VariantMap& eventData)
+    {
+        stepTime_ += stepTimer_.GetUSec(false);
+    }
+
+private:
+    /// Scene.
+    SharedPtr<Scene> scene_;
+    /// Projectile pool, when the projectiles are pooled.
+    WeakPtr<ProjectilePool> projectilePool_;
+    /// Timer of the physics step.
+    HiresTimer stepTimer_;
+    /// Random seed.
+    unsigned seed_;
+    /// Number of projectiles to fire.
+    unsigned numProjectiles_;
+    /// Number of simulated frames.
+    unsigned numFrames_;
+    /// Number of projectiles fired per frame.
+    unsigned fireRate_;
+    /// Number of rows of the box pyramid.
+    unsigned pyramidRows_;
+    /// Projectile pool capacity, zero to create a new projectile per shot.
+    unsigned poolCapacity_;
+    /// Flag for sharing the box collision shapes.
+    bool sharedShapes_;
+    /// Number of projectiles fired.
+    unsigned numFired_;
+    /// Time spent in the physics step on the current frame in microseconds.
+    long long stepTime_;
+};
+URHO3D_DEFINE_APPLICATION_MAIN(MyApp)